@@ -5,7 +5,11 @@
 #include <cmath>
 #include <random>   
 #include <chrono>
-#include <thread>
+#include <cstring>
+#include <cstdlib>
+#include <cstdio>
+#include <string>
+#include <algorithm>
 
 #include <glad/glad.h>
 #include <GLFW/glfw3.h>
@@ -15,15 +19,37 @@
 
 #include "utility/ResourceManager.h"
 #include "utility/model-loading/Model.h"
+#include "utility/benchmark/Benchmarks.h"
+#include "utility/rendering/RenderTarget.h"
+#include "utility/profiling/Profiler.h"
+#include "utility/rendering/TextOverlay.h"
+#include "utility/rendering/RenderState.h"
+#include "utility/rendering/RenderQueue.h"
+#include "utility/rendering/GLExtensions.h"
+#include "utility/rendering/FrameUniforms.h"
+#include "utility/culling/DynamicBVH.h"
+#include "utility/culling/GpuCuller.h"
+#include "utility/culling/DepthPyramid.h"
+#include "utility/culling/SoftwareOcclusion.h"
+#include "utility/jobs/JobSystem.h"
+#include "utility/transform/TransformStore.h"
+#include "utility/timing/FixedTimestep.h"
+#include "utility/timing/FramePacer.h"
+#include "utility/shader/ProgramCache.h"
+#include "utility/io/PngWriter.h"
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
+void reportFrameTimes(const std::vector<double>& cpuTimes, const std::vector<double>& gpuTimes);
+std::vector<std::string> profilerOverlayLines(const Profiler& profiler);
 
 const float CAMERA_SPEED = 1.5;
 
 const int TARGET_FPS = 60;
-const std::chrono::duration<double, std::milli> FRAME_DURATION(1000.0 / TARGET_FPS);
+// the flock is simulated at a fixed rate and interpolated for every rendered frame
+const int SIMULATION_RATE = 60;
+const int MAX_SIMULATION_STEPS = 8;
 
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
@@ -34,30 +60,174 @@ float cameraElevation = glm::radians(45.0f);
 
 float rotationSpeed = 1.5f;
 float rotationAngle = 0.0f;
+// rotationAngle one simulation step earlier
+float previousRotationAngle = 0.0f;
+
+int viewportWidth = 0;
+int viewportHeight = 0;
+
+// profiler statistics overlay, toggled with F1
+bool showOverlay = true;
+bool overlayKeyDown = false;
+
+const int DEFAULT_DUCKLING_COUNT = 3;
+// ducklings trail the leader on rings, ring r holds DUCKLINGS_PER_RING * (r + 1) of them
+const int DUCKLINGS_PER_RING = 21;
+const float DUCKLING_SPACING = glm::radians(15.0f);
+const float RING_SPACING = 6.0f;
+const float LEADER_RADIUS = 30.0f;
+
+// ducks per job when moving the flock and per chunk when building its draw lists
+const size_t FLOCK_GRAIN = 256;
+
+const float FIELD_OF_VIEW = glm::radians(45.0f);
+const float FAR_PLANE = 1000.0f;
+
+// largest simplification error, in pixels, a duck may show before a finer level is drawn
+const float LOD_PIXEL_ERROR = 1.0f;
+// profiler counter names of the duck levels of detail
+const char* const DUCK_LOD_COUNTERS[MeshSimplifier::MAX_LODS] = {
+    "ducks at lod 0", "ducks at lod 1", "ducks at lod 2", "ducks at lod 3", "ducks at lod 4"
+};
+
+const int BENCHMARK_ITERATIONS = 20;
+// copies of duck.obj in the large file of the OBJ parsing benchmark, about 15 MB
+const int BENCHMARK_OBJ_COPIES = 400;
+
+// pixel bytes streamed into textures per frame while asynchronous loads are in flight
+const size_t TEXTURE_UPLOAD_BUDGET = 8 * 1024 * 1024;
+
+const int HEADLESS_WIDTH = 1280;
+const int HEADLESS_HEIGHT = 720;
+const int HEADLESS_DEFAULT_FRAMES = 600;
+const unsigned int HEADLESS_SEED = 1234;
+
+int main(int argc, char** argv) {
+    // --bench-model-loading       runs the model loading benchmark instead of the scene
+    // --bench-transforms          runs the instance transform benchmark instead of the scene
+    // --bench-obj                 runs the OBJ parsing benchmark instead of the scene
+    // --headless                  renders offscreen without a display (OSMesa or EGL on GLFW's null platform)
+    // --frames <n>                number of fixed-timestep frames replayed in headless mode
+    // --dump-frames <directory>   writes every headless frame as a PNG into an existing directory
+    // --overlay                   draws the profiler overlay in headless mode too
+    // --trace <file>              exports the profiled passes as a Chrome trace on exit
+    // --ducklings <n>             number of ducklings following the leader
+    // --cpu-culling               culls the ducks and picks their levels on the CPU even where compute shaders are available
+    // --no-occlusion              draws the ducks hidden behind the scene too
+    // --cpu-occlusion             tests the ducks culled on the CPU against a late depth readback, they may pop in late
+    // --software-occlusion        culls the ducks on the CPU against the ground and the leader rasterized in software
+    // --occluder-triangles <n>    triangles the software occluders may submit per frame
+    bool benchModelLoading = false;
+    bool benchTransforms = false;
+    bool benchObj = false;
+    bool headless = false;
+    int headlessFrames = HEADLESS_DEFAULT_FRAMES;
+    std::string dumpDirectory;
+    std::string tracePath;
+    bool headlessOverlay = false;
+    int ducklingCount = DEFAULT_DUCKLING_COUNT;
+    bool cpuCulling = false;
+    bool occlusionCulling = true;
+    bool cpuOcclusionCulling = false;
+    bool softwareOcclusionCulling = false;
+    size_t occluderTriangles = SoftwareOcclusion::DEFAULT_TRIANGLE_BUDGET;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--bench-model-loading") == 0)
+            benchModelLoading = true;
+        else if (std::strcmp(argv[i], "--bench-transforms") == 0)
+            benchTransforms = true;
+        else if (std::strcmp(argv[i], "--bench-obj") == 0)
+            benchObj = true;
+        else if (std::strcmp(argv[i], "--headless") == 0)
+            headless = true;
+        else if (std::strcmp(argv[i], "--frames") == 0 && i + 1 < argc)
+            headlessFrames = std::max(1, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--dump-frames") == 0 && i + 1 < argc)
+            dumpDirectory = argv[++i];
+        else if (std::strcmp(argv[i], "--overlay") == 0)
+            headlessOverlay = true;
+        else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc)
+            tracePath = argv[++i];
+        else if (std::strcmp(argv[i], "--ducklings") == 0 && i + 1 < argc)
+            ducklingCount = std::max(0, std::atoi(argv[++i]));
+        else if (std::strcmp(argv[i], "--cpu-culling") == 0)
+            cpuCulling = true;
+        else if (std::strcmp(argv[i], "--no-occlusion") == 0)
+            occlusionCulling = false;
+        else if (std::strcmp(argv[i], "--cpu-occlusion") == 0)
+            cpuOcclusionCulling = true;
+        else if (std::strcmp(argv[i], "--software-occlusion") == 0)
+            softwareOcclusionCulling = true;
+        else if (std::strcmp(argv[i], "--occluder-triangles") == 0 && i + 1 < argc)
+            occluderTriangles = static_cast<size_t>(std::max(0, std::atoi(argv[++i])));
+        else
+            std::cerr << "Ignoring unknown argument " << argv[i] << "\n";
+    }
+
+    // need no GL, so they run before a window is opened
+    if (benchTransforms) {
+        Benchmarks::Transforms(BENCHMARK_ITERATIONS);
+        return 0;
+    }
+    if (benchObj) {
+        Benchmarks::ObjParsing("resources/models/duck.obj", BENCHMARK_OBJ_COPIES, BENCHMARK_ITERATIONS);
+        return 0;
+    }
 
-int main() {
+    // headless runs are replays, so they always see the same flock
     std::random_device rd;
-    std::mt19937 gen(rd());
+    std::mt19937 gen(headless ? HEADLESS_SEED : rd());
     std::uniform_real_distribution<float> dist(0.3f, 0.7f);
-    float duckSizeMultipliers[3] = {
-        dist(gen),
-        dist(gen),
-        dist(gen)
-    };
+    // the flock turns around the lake center as a whole, so every duck's transform is fixed
+    // relative to a frame that rotates with rotationAngle. The leader comes first
+    TransformStore flockTransforms;
+    flockTransforms.Add(glm::vec3(LEADER_RADIUS, 0.0f, 0.0f), 0.0f, 1.0f);
+    for (int i = 0, ring = 0, slot = 0; i < ducklingCount; i++, slot++) {
+        if (slot == DUCKLINGS_PER_RING * (ring + 1)) {
+            ring++;
+            slot = 0;
+        }
+        // ducklings trail the leader by angle, facing along their ring
+        float angle = glm::radians(30.0f) + slot * DUCKLING_SPACING / (ring + 1);
+        float ringRadius = LEADER_RADIUS + ring * RING_SPACING;
+        flockTransforms.Add(glm::vec3(ringRadius * std::cos(angle), 0.0f, -ringRadius * std::sin(angle)), angle, dist(gen));
+    }
+
+    if (headless)
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
 
     if (!glfwInit()) {
         std::cerr << "Failed to initialize GLFW\n";
         return -1;
     }
 
-    GLFWmonitor* monitor = glfwGetPrimaryMonitor();
-    const GLFWvidmode* mode = glfwGetVideoMode(monitor);
-
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-    GLFWwindow* window = glfwCreateWindow(mode->width, mode->height, "Submarine3D", monitor, nullptr);
+    GLFWwindow* window = nullptr;
+    int refreshRate = 0;
+    if (headless) {
+        // the null platform has no surfaces, so ask for an OSMesa context (Mesa llvmpipe)
+        // and fall back to a surfaceless EGL one
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+        window = glfwCreateWindow(HEADLESS_WIDTH, HEADLESS_HEIGHT, "Ducks3D", nullptr, nullptr);
+        if (!window) {
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+            window = glfwCreateWindow(HEADLESS_WIDTH, HEADLESS_HEIGHT, "Ducks3D", nullptr, nullptr);
+        }
+        viewportWidth = HEADLESS_WIDTH;
+        viewportHeight = HEADLESS_HEIGHT;
+    }
+    else {
+        GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+        const GLFWvidmode* mode = glfwGetVideoMode(monitor);
+        window = glfwCreateWindow(mode->width, mode->height, "Submarine3D", monitor, nullptr);
+        viewportWidth = mode->width;
+        viewportHeight = mode->height;
+        refreshRate = mode->refreshRate;
+    }
     if (!window) {
         std::cerr << "Failed to create GLFW window\n";
         glfwTerminate();
@@ -70,11 +240,32 @@ int main() {
         std::cerr << "Failed to initialize GLAD\n";
         return -1;
     }
+    GLExtensions::Load((GLADloadproc)glfwGetProcAddress);
 
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetScrollCallback(window, scroll_callback);
 
-    glViewport(0, 0, mode->width, mode->height);
+    // headless frames go to an offscreen target that stays bound for the whole run
+    RenderTarget offscreen;
+    if (headless) {
+        if (!offscreen.Generate(viewportWidth, viewportHeight)) {
+            std::cerr << "Failed to create offscreen render target\n";
+            glfwTerminate();
+            return -1;
+        }
+        offscreen.Bind();
+        std::cout << "Headless: " << glGetString(GL_RENDERER) << " (" << glGetString(GL_VERSION) << ")" << std::endl;
+    }
+
+    glViewport(0, 0, viewportWidth, viewportHeight);
+
+    if (benchModelLoading) {
+        Benchmarks::ModelLoading("resources/models/duck.obj", BENCHMARK_ITERATIONS);
+        GeometryPool::Release();
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        return 0;
+    }
 
     float planeVertices[] = {
         -200.0f, 0.0f, -200.0f,    0.0f, 0.0f,   
@@ -93,7 +284,7 @@ int main() {
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
-    glBindVertexArray(VAO);
+    RenderState::BindVertexArray(VAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), planeVertices, GL_STATIC_DRAW);
@@ -107,7 +298,7 @@ int main() {
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
-    glBindVertexArray(0);
+    RenderState::BindVertexArray(0);
 
     std::vector<float> lakeVertices;
     const int segments = 50;
@@ -136,7 +327,7 @@ int main() {
     glGenVertexArrays(1, &lakeVAO);
     glGenBuffers(1, &lakeVBO);
 
-    glBindVertexArray(lakeVAO);
+    RenderState::BindVertexArray(lakeVAO);
     glBindBuffer(GL_ARRAY_BUFFER, lakeVBO);
     glBufferData(GL_ARRAY_BUFFER, lakeVertices.size() * sizeof(float), lakeVertices.data(), GL_STATIC_DRAW);
 
@@ -146,7 +337,7 @@ int main() {
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
-    glBindVertexArray(0);
+    RenderState::BindVertexArray(0);
 
     float signatureQuad[] = {
         -0.95f, -0.95f,    0.0f, 0.0f,  
@@ -165,7 +356,7 @@ int main() {
     glGenBuffers(1, &sigVBO);
     glGenBuffers(1, &sigEBO);
 
-    glBindVertexArray(sigVAO);
+    RenderState::BindVertexArray(sigVAO);
 
     glBindBuffer(GL_ARRAY_BUFFER, sigVBO);
     glBufferData(GL_ARRAY_BUFFER, sizeof(signatureQuad), signatureQuad, GL_STATIC_DRAW);
@@ -179,54 +370,211 @@ int main() {
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
     glEnableVertexAttribArray(1);
 
-    glBindVertexArray(0);
-
-    ResourceManager::loadShader("resources/shaders/basic.vert", "resources/shaders/basic.frag", nullptr, "shader");
-    ResourceManager::loadShader("resources/shaders/signature.vert", "resources/shaders/signature.frag", nullptr, "signatureShader");
-
-    ResourceManager::loadTexture("resources/textures/grass.jpg", false, "grass");
-    ResourceManager::loadTexture("resources/textures/water.jpg", false, "water");
-    ResourceManager::loadTexture("resources/textures/duck.png", true, "duck");
-    ResourceManager::loadTexture("resources/textures/signature.png", true, "signature");
-
-    Model duck("resources/models/duck.obj");
-
-    
-
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);        
-    glCullFace(GL_BACK);          
+    RenderState::BindVertexArray(0);
+
+    // programs come from the on-disk binary cache on a warm start, from source on a cold one.
+    // Compiling runs on driver threads while the textures and the model load
+    auto shadersStart = std::chrono::high_resolution_clock::now();
+    ShaderHandle basicShaderHandle = ResourceManager::loadShader("resources/shaders/basic.vert", "resources/shaders/basic.frag", nullptr, "shader");
+    ShaderHandle instancedShaderHandle = ResourceManager::loadShader("resources/shaders/basic_instanced.vert", "resources/shaders/basic_instanced.frag", nullptr, "instancedShader");
+    ShaderHandle signatureShaderHandle = ResourceManager::loadShader("resources/shaders/signature.vert", "resources/shaders/signature.frag", nullptr, "signatureShader");
+    ShaderHandle hizShaderHandle = ResourceManager::loadShader("resources/shaders/hiz.vert", "resources/shaders/hiz.frag", nullptr, "hizShader");
+    std::chrono::duration<double, std::milli> shadersSubmitTime = std::chrono::high_resolution_clock::now() - shadersStart;
+
+    // decoded on worker threads while the model loads, streamed in by the render loop
+    TextureHandle grassHandle = ResourceManager::loadTextureAsync("resources/textures/grass.jpg", false, "grass");
+    TextureHandle waterHandle = ResourceManager::loadTextureAsync("resources/textures/water.jpg", false, "water");
+    TextureHandle duckHandle = ResourceManager::loadTextureAsync("resources/textures/duck.png", true, "duck");
+    TextureHandle signatureHandle = ResourceManager::loadTextureAsync("resources/textures/signature.png", true, "signature");
+
+    // resolve shaders and uniform handles up front so the render loop does no string lookups
+    Shader& basicShader = ResourceManager::getShader(basicShaderHandle);
+    Shader& instancedShader = ResourceManager::getShader(instancedShaderHandle);
+    Shader& signatureShader = ResourceManager::getShader(signatureShaderHandle);
+    Texture2D& grassTexture = ResourceManager::getTexture(grassHandle);
+    Texture2D& waterTexture = ResourceManager::getTexture(waterHandle);
+    Texture2D& duckTexture = ResourceManager::getTexture(duckHandle);
+    Texture2D& signatureTexture = ResourceManager::getTexture(signatureHandle);
+
+    // camera data shared by every program through one uniform block
+    FrameUniforms frameUniforms;
+    frameUniforms.Generate();
+    FrameData frameData;
+
+    // parses the model on import, then moves the flock and builds its draw lists next to the GL thread
+    JobSystem jobs;
+    jobs.Start();
+    Model duck("resources/models/duck.obj", true, true, &jobs);
+
+    // whatever the driver hasn't compiled by now is waited for
+    size_t shadersCompiling = ResourceManager::pendingShaders();
+    auto shadersWaitStart = std::chrono::high_resolution_clock::now();
+    ResourceManager::finishShaders();
+    std::chrono::duration<double, std::milli> shadersWaitTime = std::chrono::high_resolution_clock::now() - shadersWaitStart;
+    // the first frames don't need the overlay, its program keeps compiling while they render
+    ShaderHandle textShaderHandle = ResourceManager::loadShader("resources/shaders/text.vert", "resources/shaders/text.frag", nullptr, "textShader");
+    std::cout << "Shaders: " << (ProgramCache::Misses() == 0 ? "warm" : "cold") << " start, "
+        << ProgramCache::Hits() << " of " << ProgramCache::Hits() + ProgramCache::Misses()
+        << " programs from the binary cache, " << shadersSubmitTime.count() << " ms to submit, "
+        << shadersWaitTime.count() << " ms waited for " << shadersCompiling << " compiling"
+        << (GLExtensions::ParallelShaderCompile() ? " (parallel)" : "") << std::endl;
+    UniformHandle basicModel = basicShader.GetUniform("model");
+
+    // the ducks are culled, given their levels and drawn without per-duck CPU work where compute shaders are available
+    bool gpuCulling = !cpuCulling && !softwareOcclusionCulling && GpuCuller::Supported();
+    GpuCuller duckCuller;
+    if (gpuCulling) {
+        ShaderHandle cullShaderHandle = ResourceManager::loadComputeShader("resources/shaders/cull.comp", "cullShader");
+        duckCuller.Generate(&ResourceManager::getShader(cullShaderHandle), &duck);
+    }
+    // ducks hidden behind what was drawn before them are tested against a depth pyramid, on the GPU
+    // this frame's after last frame's. The CPU only has one read back a frame or two ago and nothing to
+    // test the ducks it hid against again, so that is opt-in
+    if (!gpuCulling && !cpuOcclusionCulling)
+        occlusionCulling = false;
+    DepthPyramid depthPyramid;
+    if (occlusionCulling)
+        depthPyramid.Generate(&ResourceManager::getShader(hizShaderHandle));
+    // the software occluders are the ground, the lake and the leader duck, rasterized every frame before
+    // the ducks are tested against them
+    SoftwareOcclusion softwareOcclusion;
+    int groundOccluder = -1, lakeOccluder = -1;
+    std::vector<int> leaderOccluders;
+    if (softwareOcclusionCulling) {
+        softwareOcclusion.SetTriangleBudget(occluderTriangles);
+        std::vector<glm::vec3> positions;
+        for (int corner = 0; corner < 4; corner++)
+            positions.push_back(glm::vec3(planeVertices[corner * 5], planeVertices[corner * 5 + 1], planeVertices[corner * 5 + 2]));
+        groundOccluder = softwareOcclusion.AddMesh(positions, std::vector<unsigned int>(indices, indices + 6));
+        // the lake is drawn as a fan, its center is the first vertex
+        positions.clear();
+        std::vector<unsigned int> fan;
+        for (size_t vertex = 0; vertex < lakeVertices.size() / 5; vertex++) {
+            positions.push_back(glm::vec3(lakeVertices[vertex * 5], lakeVertices[vertex * 5 + 1], lakeVertices[vertex * 5 + 2]));
+            if (vertex >= 2) {
+                fan.push_back(0);
+                fan.push_back(static_cast<unsigned int>(vertex - 1));
+                fan.push_back(static_cast<unsigned int>(vertex));
+            }
+        }
+        lakeOccluder = softwareOcclusion.AddMesh(positions, fan);
+        // the leader at full detail, read back from the pool where the mesh came from the cache
+        for (const Mesh& mesh : duck.Meshes()) {
+            std::vector<Vertex> vertices = mesh.vertices;
+            std::vector<unsigned int> meshIndices = mesh.indices;
+            if (vertices.empty())
+                GeometryPool::Read(mesh.geometry, vertices, meshIndices);
+            unsigned int first = mesh.lods.empty() ? 0 : mesh.lods[0].firstIndex;
+            unsigned int count = mesh.lods.empty() ? mesh.indexCount : mesh.lods[0].indexCount;
+            positions.clear();
+            for (const Vertex& vertex : vertices)
+                positions.push_back(vertex.Position);
+            leaderOccluders.push_back(softwareOcclusion.AddMesh(positions,
+                std::vector<unsigned int>(meshIndices.begin() + first, meshIndices.begin() + first + count)));
+        }
+    }
+    std::cout << "Culling: ducks on the " << (gpuCulling ? "GPU" : "CPU")
+        << (occlusionCulling ? ", with occlusion" : "")
+        << (softwareOcclusionCulling ? std::string(", software occluders (") + SoftwareOcclusion::KernelName(softwareOcclusion.GetKernel()) + ")" : "")
+        << std::endl;
+
+    // ground primitives are untinted, the ducks carry their tint per instance
+    basicShader.Use().SetVector3f("color", glm::vec3(1.0f, 1.0f, 1.0f));
+    // leader duck followed by the ducklings, rebuilt every frame and drawn in one instanced call per mesh
+    std::vector<InstanceData> flock(flockTransforms.Size());
+    flock[0].Tint = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+    for (size_t i = 1; i < flock.size(); i++)
+        flock[i].Tint = glm::vec4(1.0f, 1.0f, 0.0f, 1.0f);
+
+    // world objects are leaves of a BVH, only those inside the view frustum are submitted.
+    // the ducks are objects OBJECT_DUCKS + their index in the flock
+    enum SceneObject { OBJECT_GRASS, OBJECT_LAKE, OBJECT_DUCKS };
+    DynamicBVH sceneTree;
+    sceneTree.Insert(AABB(glm::vec3(-200.0f, 0.0f, -200.0f), glm::vec3(200.0f, 0.0f, 200.0f)), OBJECT_GRASS);
+    sceneTree.Insert(AABB(glm::vec3(-radius, y, -radius), glm::vec3(radius, y, radius)), OBJECT_LAKE);
+    // the GPU culls its ducks itself, so they only go into the tree for CPU culling
+    std::vector<int> duckProxies(flock.size());
+    for (size_t i = 0; i < flock.size() && !gpuCulling; i++)
+        duckProxies[i] = sceneTree.Insert(duck.Bounds(), static_cast<unsigned int>(OBJECT_DUCKS + i));
+    Frustum frustum;
+    std::vector<unsigned int> visibleObjects;
+    std::vector<bool> objectVisible(OBJECT_DUCKS + flock.size());
+    std::vector<AABB> duckBounds(flock.size());
+    // level of detail of every duck, kept between frames for hysteresis
+    std::vector<unsigned int> duckLods(flock.size(), 0);
+    // visible ducks grouped by level, and per chunk of the flock where it writes into each group
+    std::vector<std::vector<InstanceData>> lodGroups(duck.LodCount());
+    std::vector<size_t> chunkOffsets;
+    // whether each duck was hidden in the CPU's pyramid, and per chunk of the flock how many ducks were
+    // outside the frustum, occluded and no longer occluded
+    std::vector<unsigned char> duckOccluded(flock.size(), 0);
+    std::vector<size_t> chunkCulls;
+    GpuCuller::Stats cullStats;
+
+    RenderState::SetDepthTest(true);
+    RenderState::SetCullFace(true);
+    RenderState::CullFace(GL_BACK);
  
     glm::vec3 cameraPos;
+    RenderQueue queue;
+    // every level of every duck mesh in one multi-draw, where the context supports it
+    DrawBatch duckBatch;
+
+    Profiler profiler;
+    // a headless run reports every frame, so it waits for late GPU results instead of dropping them
+    profiler.SetBlocking(headless);
+    Shader& textShader = ResourceManager::getShader(textShaderHandle);
+    TextOverlay overlay;
+    overlay.Generate(textShader);
+    if (headless) {
+        showOverlay = headlessOverlay;
+        // replays must not depend on how fast the textures decode and the programs compile
+        ResourceManager::finishTextures();
+        ResourceManager::finishShaders();
+    }
 
-    while (!glfwWindowShouldClose(window)) {
-        auto frameStart = std::chrono::high_resolution_clock::now();
+    FixedTimestep simulation(1.0 / SIMULATION_RATE, MAX_SIMULATION_STEPS);
+    FramePacer pacer;
+    if (!headless) {
+        pacer.SetTargetRate(TARGET_FPS);
+        pacer.SetVsync(true, refreshRate);
+    }
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    std::vector<double> cpuTimes, gpuTimes;
+    std::vector<unsigned char> framePixels;
+    int frame = 0;
 
-        float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+    while (headless ? frame < headlessFrames : !glfwWindowShouldClose(window)) {
+        auto frameStart = std::chrono::high_resolution_clock::now();
 
-        processInput(window);
+        profiler.BeginFrame();
 
-        
-        ResourceManager::getShader("signatureShader").Use();
-        glActiveTexture(GL_TEXTURE0);
-        ResourceManager::getTexture("signature").Bind();
+        if (ResourceManager::pendingTextures() > 0) {
+            ProfileScope pass(profiler, "textures");
+            ResourceManager::updateTextures(TEXTURE_UPLOAD_BUDGET);
+        }
+        if (ResourceManager::pendingShaders() > 0) {
+            ProfileScope pass(profiler, "shaders");
+            ResourceManager::updateShaders();
+        }
 
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        {
+            ProfileScope pass(profiler, "clear");
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        }
 
-        glBindVertexArray(sigVAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+        if (headless) {
+            // fixed timestep replay, independent of how fast the frames are rendered
+            deltaTime = 1.0f / TARGET_FPS;
+        }
+        else {
+            float currentFrame = glfwGetTime();
+            deltaTime = currentFrame - lastFrame;
+            lastFrame = currentFrame;
 
-        glDisable(GL_BLEND);
-        
+            processInput(window);
+        }
 
-        glm::mat4 model = glm::mat4(1.0f);
-        
         float x = sin(cameraElevation) * sin(cameraAngle) * cameraZoom;
         float y = cos(cameraElevation) * cameraZoom;
         float z = sin(cameraElevation) * cos(cameraAngle) * cameraZoom;
@@ -240,59 +588,321 @@ int main() {
         );
 
         glm::mat4 projection = glm::perspective(
-            glm::radians(45.0f),
+            FIELD_OF_VIEW,
             800.0f / 600.0f,
-            0.1f, 1000.0f
+            0.1f, FAR_PLANE
         );
 
-        ResourceManager::getShader("shader").Use().SetMatrix4("model", model);
-        ResourceManager::getShader("shader").SetMatrix4("view", view);
-        ResourceManager::getShader("shader").SetMatrix4("projection", projection);
-
-        glActiveTexture(GL_TEXTURE0);
-        ResourceManager::getTexture("grass").Bind();
-
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
-
-        glActiveTexture(GL_TEXTURE0);
-        ResourceManager::getTexture("water").Bind();
-
-        glBindVertexArray(lakeVAO);
-        glDrawArrays(GL_TRIANGLE_FAN, 0, segments + 2);
-        glBindVertexArray(0);
+        // a headless frame is exactly one step, so replays don't depend on the rendering speed
+        int steps = simulation.Advance(headless ? simulation.Step() : deltaTime);
+        for (int step = 0; step < steps; step++) {
+            previousRotationAngle = rotationAngle;
+            rotationAngle += rotationSpeed * static_cast<float>(simulation.Step());
+        }
+        float renderedRotation = previousRotationAngle + (rotationAngle - previousRotationAngle) * simulation.Alpha();
+
+        {
+            ProfileScope pass(profiler, "simulate");
+            JobCounter flockMoved;
+            glm::mat4 flockFrame = glm::rotate(glm::mat4(1.0f), -renderedRotation, glm::vec3(0.0f, 1.0f, 0.0f));
+            jobs.ParallelFor(flock.size(), FLOCK_GRAIN, [&, flockFrame](size_t begin, size_t end) {
+                flockTransforms.Compose(begin, end, flockFrame, &flock[0].Model, sizeof(InstanceData));
+                for (size_t i = begin; i < end && !gpuCulling; i++)
+                    duckBounds[i] = duck.Bounds().Transformed(flock[i].Model);
+            }, flockMoved);
+
+            // the camera goes to the GL while the workers move the flock
+            frameData.view = view;
+            frameData.projection = projection;
+            frameData.viewProjection = projection * view;
+            frameData.cameraPosition = glm::vec4(cameraPos, 1.0f);
+            frameData.viewport = glm::vec4(viewportWidth, viewportHeight, 1.0f / viewportWidth, 1.0f / viewportHeight);
+            frameUniforms.Update(frameData);
+            frustum.Extract(frameData.viewProjection);
+            jobs.Wait(flockMoved);
+        }
 
-        glActiveTexture(GL_TEXTURE0);
-        ResourceManager::getTexture("duck").Bind();
-        rotationAngle += rotationSpeed * deltaTime;
+        {
+            ProfileScope pass(profiler, "cull");
+            for (size_t i = 0; i < flock.size() && !gpuCulling; i++)
+                sceneTree.Move(duckProxies[i], duckBounds[i]);
+            visibleObjects.clear();
+            size_t culled = sceneTree.Cull(frustum, visibleObjects);
+            std::fill(objectVisible.begin(), objectVisible.end(), false);
+            for (unsigned int object : visibleObjects)
+                objectVisible[object] = true;
+            profiler.SetCounter("objects visible", static_cast<double>(visibleObjects.size()));
+            profiler.SetCounter("objects culled", static_cast<double>(culled));
+        }
 
-        model = glm::mat4(1.0f);
-        model = glm::rotate(model, -rotationAngle, glm::vec3(0.0f, 1.0f, 0.0f));
-        model = glm::translate(model, glm::vec3(30.0f, 0.0f, 0.0f));
-        ResourceManager::getShader("shader").SetMatrix4("model", model);
-        duck.Draw();
+        // pixels covered by one world unit at distance 1 from the camera
+        float pixelsPerUnitAtOne = viewportHeight / (2.0f * std::tan(FIELD_OF_VIEW * 0.5f));
+        if (softwareOcclusionCulling) {
+            ProfileScope pass(profiler, "occluders");
+            softwareOcclusion.Begin(frameData.viewProjection);
+            if (objectVisible[OBJECT_GRASS])
+                softwareOcclusion.AddOccluder(groundOccluder, glm::mat4(1.0f));
+            if (objectVisible[OBJECT_LAKE])
+                softwareOcclusion.AddOccluder(lakeOccluder, glm::mat4(1.0f));
+            if (objectVisible[OBJECT_DUCKS]) {
+                for (int mesh : leaderOccluders)
+                    softwareOcclusion.AddOccluder(mesh, flock[0].Model);
+            }
+            softwareOcclusion.Render(jobs);
+            const SoftwareOcclusion::Stats& occluderStats = softwareOcclusion.GetStats();
+            profiler.SetCounter("occluder triangles", static_cast<double>(occluderStats.trianglesRasterized));
+            profiler.SetCounter("occluders skipped", static_cast<double>(occluderStats.occludersSkipped));
+            profiler.SetCounter("occluder setup ms", occluderStats.setupMs);
+            profiler.SetCounter("occluder bin ms", occluderStats.binMs);
+            profiler.SetCounter("occluder raster ms", occluderStats.rasterMs);
+        }
+        if (gpuCulling) {
+            ProfileScope pass(profiler, "gpu cull");
+            duckCuller.Cull(flock, frustum, pixelsPerUnitAtOne, LOD_PIXEL_ERROR, occlusionCulling ? &depthPyramid : nullptr);
+        }
+        else if (!lodGroups.empty()) {
+            ProfileScope pass(profiler, "lod");
+            size_t levels = lodGroups.size();
+            size_t chunks = (flock.size() + FLOCK_GRAIN - 1) / FLOCK_GRAIN;
+            chunkOffsets.assign(chunks * levels, 0);
+            chunkCulls.assign(chunks * 3, 0);
+            if (occlusionCulling)
+                depthPyramid.UpdateReadback();
+
+            // pick a level for every visible duck that isn't occluded and count them per chunk and level
+            jobs.ParallelFor(chunks, 1, [&](size_t begin, size_t end) {
+                for (size_t chunk = begin; chunk < end; chunk++) {
+                    size_t* counts = &chunkOffsets[chunk * levels];
+                    size_t* culls = &chunkCulls[chunk * 3];
+                    for (size_t i = chunk * FLOCK_GRAIN; i < std::min(flock.size(), (chunk + 1) * FLOCK_GRAIN); i++) {
+                        bool wasOccluded = duckOccluded[i] != 0;
+                        duckOccluded[i] = 0;
+                        if (!objectVisible[OBJECT_DUCKS + i]) {
+                            culls[0]++;
+                            continue;
+                        }
+                        glm::vec3 center = duckBounds[i].Center();
+                        float scale = glm::length(glm::vec3(flock[i].Model[0]));
+                        float distance = std::max(glm::length(center - cameraPos), 0.1f);
+                        duckLods[i] = duck.SelectLod(scale * pixelsPerUnitAtOne / distance, duckLods[i], LOD_PIXEL_ERROR);
+                        if ((occlusionCulling && depthPyramid.IsOccluded(duckBounds[i]))
+                            || (softwareOcclusionCulling && softwareOcclusion.IsOccluded(duckBounds[i]))) {
+                            duckOccluded[i] = 1;
+                            culls[1]++;
+                            continue;
+                        }
+                        if (wasOccluded)
+                            culls[2]++;
+                        counts[duckLods[i]]++;
+                    }
+                }
+            });
+
+            // counts to write offsets, in flock order so the lists don't depend on the thread count
+            for (size_t level = 0; level < levels; level++) {
+                size_t offset = 0;
+                for (size_t chunk = 0; chunk < chunks; chunk++) {
+                    size_t count = chunkOffsets[chunk * levels + level];
+                    chunkOffsets[chunk * levels + level] = offset;
+                    offset += count;
+                }
+                lodGroups[level].resize(offset);
+            }
+
+            jobs.ParallelFor(chunks, 1, [&](size_t begin, size_t end) {
+                for (size_t chunk = begin; chunk < end; chunk++) {
+                    size_t* offsets = &chunkOffsets[chunk * levels];
+                    for (size_t i = chunk * FLOCK_GRAIN; i < std::min(flock.size(), (chunk + 1) * FLOCK_GRAIN); i++) {
+                        if (objectVisible[OBJECT_DUCKS + i] && !duckOccluded[i])
+                            lodGroups[duckLods[i]][offsets[duckLods[i]]++] = flock[i];
+                    }
+                }
+            });
+
+            size_t culls[3] = { 0, 0, 0 };
+            for (size_t chunk = 0; chunk < chunks; chunk++) {
+                for (int kind = 0; kind < 3; kind++)
+                    culls[kind] += chunkCulls[chunk * 3 + kind];
+            }
+            profiler.SetCounter("ducks frustum culled", static_cast<double>(culls[0]));
+            profiler.SetCounter("ducks occluded", static_cast<double>(culls[1]));
+            profiler.SetCounter("ducks disoccluded", static_cast<double>(culls[2]));
+        }
 
-        ResourceManager::getShader("shader").SetVector3f("color", glm::vec3(1.0f, 1.0f, 0.0f));
+        // the queue decides the draw order, so the scene is described here rather than sequenced.
+        // With occlusion culling the ducks that come out from behind the first round are drawn in a second
+        DrawItem ducks;
+        DrawItem signature;
+        size_t queuedDraws = 0;
+        {
+            ProfileScope pass(profiler, "submit");
+            queue.Begin(cameraPos, FAR_PLANE);
+
+            DrawItem ground;
+            ground.shader = &basicShader;
+            ground.modelUniform = basicModel;
+            ground.pass = "grass";
+            ground.texture = &grassTexture;
+            ground.vao = VAO;
+            ground.count = 6;
+            if (objectVisible[OBJECT_GRASS])
+                queue.Submit(ground);
+
+            ground.pass = "lake";
+            ground.texture = &waterTexture;
+            ground.vao = lakeVAO;
+            ground.primitive = GL_TRIANGLE_FAN;
+            ground.count = segments + 2;
+            ground.indexed = false;
+            if (objectVisible[OBJECT_LAKE])
+                queue.Submit(ground);
+
+            ducks.shader = &instancedShader;
+            ducks.texture = &duckTexture;
+            ducks.pass = "ducks";
+            for (const std::vector<InstanceData>& group : lodGroups) {
+                if (!group.empty()) {
+                    ducks.center = glm::vec3(group[0].Model[3]);
+                    break;
+                }
+            }
+            // called with empty groups too, so the level counts below reset
+            if (gpuCulling) {
+                // the level counts come with the culling stats, a few frames late
+                ducks.center = glm::vec3(flock[0].Model[3]);
+                duckCuller.Submit(queue, ducks);
+            }
+            else if (DrawBatch::Supported()) {
+                duckBatch.Begin();
+                duck.AddLodGroups(duckBatch, lodGroups);
+                duckBatch.Submit(queue, ducks);
+            }
+            else {
+                duck.SubmitLodGroups(queue, ducks, lodGroups);
+            }
+            for (unsigned int level = 0; level < MeshSimplifier::MAX_LODS && !gpuCulling; level++)
+                profiler.SetCounter(DUCK_LOD_COUNTERS[level], static_cast<double>(duck.SubmittedAtLod(level)));
+
+            signature.shader = &signatureShader;
+            signature.texture = &signatureTexture;
+            signature.vao = sigVAO;
+            signature.count = 6;
+            signature.layer = RenderQueue::LAYER_HUD;
+            signature.translucent = true;
+            signature.pass = "signature";
+            if (!occlusionCulling)
+                queue.Submit(signature);
+
+            queue.Sort();
+            queuedDraws += queue.Size();
+        }
+        queue.Execute(&profiler);
+
+        if (occlusionCulling) {
+            {
+                ProfileScope pass(profiler, "hi-z");
+                depthPyramid.Build(headless ? offscreen.id : 0, viewportWidth, viewportHeight, frameData.viewProjection);
+                if (gpuCulling)
+                    duckCuller.Retest(depthPyramid);
+                else
+                    depthPyramid.RequestReadback();
+            }
+            {
+                ProfileScope pass(profiler, "submit");
+                queue.Begin(cameraPos, FAR_PLANE);
+                if (gpuCulling)
+                    duckCuller.SubmitLate(queue, ducks);
+                queue.Submit(signature);
+                queue.Sort();
+                queuedDraws += queue.Size();
+            }
+            queue.Execute(&profiler);
+        }
 
-        for (int i = 0; i < 3; ++i) {
-            float offset = glm::radians(30.0f + i * 15.0f);
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::rotate(model, -rotationAngle + offset, glm::vec3(0.0f, 1.0f, 0.0f));
-            model = glm::translate(model, glm::vec3(30.0f, 0.0f, 0.0f));
-            model = glm::scale(model, glm::vec3(duckSizeMultipliers[i]));
-            ResourceManager::getShader("shader").SetMatrix4("model", model);
-            duck.Draw();
+        // drawn from the frame updateShaders has completed its program in
+        if (showOverlay && !textShader.IsCompiling()) {
+            ProfileScope pass(profiler, "overlay");
+            overlay.Draw(profilerOverlayLines(profiler), 16, 16, viewportWidth, viewportHeight);
+        }
+        frameUniforms.EndFrame();
+
+        // state calls of this frame, shown on the overlay from the next one on
+        RenderState::Counters stateCalls = RenderState::GetCounters();
+        profiler.SetCounter("state calls issued", static_cast<double>(stateCalls.issued));
+        profiler.SetCounter("state calls skipped", static_cast<double>(stateCalls.skipped));
+        profiler.SetCounter("queued draws", static_cast<double>(queuedDraws));
+        profiler.SetCounter("indirect draws", static_cast<double>(duckBatch.Draws()));
+        profiler.SetCounter("textures pending", static_cast<double>(ResourceManager::pendingTextures()));
+        profiler.SetCounter("jobs run", static_cast<double>(jobs.ExecutedJobs()));
+        profiler.SetCounter("jobs stolen", static_cast<double>(jobs.StolenJobs()));
+        profiler.SetCounter("uniform ring stalls", static_cast<double>(frameUniforms.Stalls()));
+        profiler.SetCounter("simulation steps", static_cast<double>(steps));
+        if (gpuCulling && duckCuller.ReadStats(cullStats)) {
+            profiler.SetCounter("ducks frustum culled", static_cast<double>(cullStats.frustumCulled));
+            profiler.SetCounter("ducks occluded", static_cast<double>(cullStats.occluded));
+            profiler.SetCounter("ducks disoccluded", static_cast<double>(cullStats.disoccluded));
+            for (unsigned int level = 0; level < MeshSimplifier::MAX_LODS; level++)
+                profiler.SetCounter(DUCK_LOD_COUNTERS[level], static_cast<double>(cullStats.drawn[level]));
+        }
+        if (!headless) {
+            // pacing of the presents up to the last one
+            profiler.SetCounter("frame interval ms", pacer.MeanInterval());
+            profiler.SetCounter("frame jitter ms", pacer.IntervalDeviation());
+            profiler.SetCounter("frame interval max ms", pacer.MaxInterval());
+            profiler.SetCounter("swap block ms", pacer.SwapBlock());
+            profiler.SetCounter("pacing wait ms", pacer.LastWait());
+        }
+        jobs.ResetCounters();
+        frameUniforms.ResetStalls();
+        RenderState::ResetCounters();
+
+        profiler.EndFrame();
+
+        if (headless) {
+            std::chrono::duration<double, std::milli> cpuTime = std::chrono::high_resolution_clock::now() - frameStart;
+            cpuTimes.push_back(cpuTime.count());
+            Profiler::FrameTiming timing;
+            while (profiler.PopFrameTiming(timing))
+                gpuTimes.push_back(timing.gpu);
+
+            if (!dumpDirectory.empty()) {
+                char fileName[32];
+                std::snprintf(fileName, sizeof(fileName), "/frame_%05d.png", frame);
+                offscreen.ReadPixels(framePixels);
+                if (!PngWriter::WriteRGBA(dumpDirectory + fileName, offscreen.width, offscreen.height, framePixels.data(), true))
+                    std::cerr << "Failed to write " << dumpDirectory << fileName << "\n";
+            }
+            frame++;
+            continue;
         }
-        ResourceManager::getShader("shader").SetVector3f("color", glm::vec3(1.0f, 1.0f, 1.0f));
 
-        glfwSwapBuffers(window);
+        pacer.Present(window);
         glfwPollEvents();
+    }
 
-        auto frameEnd = std::chrono::high_resolution_clock::now();
-        auto elapsed = frameEnd - frameStart;
-        if (elapsed < FRAME_DURATION) 
-            std::this_thread::sleep_for(FRAME_DURATION - elapsed);
+    profiler.Flush();
+    if (headless) {
+        Profiler::FrameTiming timing;
+        while (profiler.PopFrameTiming(timing))
+            gpuTimes.push_back(timing.gpu);
+        reportFrameTimes(cpuTimes, gpuTimes);
+        offscreen.Release();
     }
+    if (!tracePath.empty()) {
+        if (profiler.ExportChromeTrace(tracePath))
+            std::cout << "Profiler: wrote Chrome trace to " << tracePath << std::endl;
+        else
+            std::cerr << "Failed to write " << tracePath << "\n";
+    }
+    profiler.Release();
+    overlay.Release();
+    frameUniforms.Release();
+    jobs.Release();
+    duckBatch.Release();
+    duckCuller.Release();
+    depthPyramid.Release();
+    duck.Release();
+    GeometryPool::Release();
 
     glfwDestroyWindow(window);
     glfwTerminate();
@@ -300,6 +910,8 @@ int main() {
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height) {
+    viewportWidth = width;
+    viewportHeight = height;
     glViewport(0, 0, width, height);
 }
 
@@ -307,6 +919,11 @@ void processInput(GLFWwindow* window) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
+    bool overlayKey = glfwGetKey(window, GLFW_KEY_F1) == GLFW_PRESS;
+    if (overlayKey && !overlayKeyDown)
+        showOverlay = !showOverlay;
+    overlayKeyDown = overlayKey;
+
     float cameraSpeed = CAMERA_SPEED * deltaTime;
     
     if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS)
@@ -333,4 +950,43 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
         cameraZoom = 1.0f;
     if (cameraZoom > 150.0f)
         cameraZoom = 150.0f;
+}
+
+void reportFrameTimes(const std::vector<double>& cpuTimes, const std::vector<double>& gpuTimes) {
+    std::printf("frame,cpu_ms,gpu_ms\n");
+    for (size_t i = 0; i < cpuTimes.size(); i++)
+        std::printf("%zu,%.4f,%.4f\n", i, cpuTimes[i], i < gpuTimes.size() ? gpuTimes[i] : 0.0);
+
+    auto summarize = [](const char* label, const std::vector<double>& times) {
+        if (times.empty())
+            return;
+        double sum = 0.0;
+        for (double time : times)
+            sum += time;
+        std::printf("%s: avg %.4f ms, min %.4f ms, max %.4f ms\n", label,
+            sum / times.size(), *std::min_element(times.begin(), times.end()), *std::max_element(times.begin(), times.end()));
+    };
+    std::printf("Headless: %zu frames\n", cpuTimes.size());
+    summarize("cpu", cpuTimes);
+    summarize("gpu", gpuTimes);
+}
+
+std::vector<std::string> profilerOverlayLines(const Profiler& profiler) {
+    std::vector<std::string> lines;
+    char line[128];
+    std::snprintf(line, sizeof(line), "%-10s %-23s %-23s", "pass", "cpu min/avg/p99 ms", "gpu min/avg/p99 ms");
+    lines.push_back(line);
+    for (const Profiler::PassStats& pass : profiler.Stats()) {
+        std::snprintf(line, sizeof(line), "%-10s %6.3f/%6.3f/%6.3f   %6.3f/%6.3f/%6.3f", pass.name.c_str(),
+            pass.cpuMin, pass.cpuAvg, pass.cpuP99, pass.gpuMin, pass.gpuAvg, pass.gpuP99);
+        lines.push_back(line);
+    }
+    for (const Profiler::Counter& counter : profiler.Counters()) {
+        // counts are whole, timings in ms keep their sub-millisecond part
+        size_t length = std::strlen(counter.name);
+        bool milliseconds = length >= 3 && std::strcmp(counter.name + length - 3, " ms") == 0;
+        std::snprintf(line, sizeof(line), milliseconds ? "%-24s %10.3f" : "%-24s %10.0f", counter.name, counter.value);
+        lines.push_back(line);
+    }
+    return lines;
 }
\ No newline at end of file
@@ -0,0 +1,12 @@
+#version 330 core
+
+in vec2 TexCoord;
+in vec4 Tint;
+
+out vec4 FragColor;
+
+uniform sampler2D _texture;
+
+void main() {
+    FragColor = texture(_texture, TexCoord) * Tint;
+}
\ No newline at end of file
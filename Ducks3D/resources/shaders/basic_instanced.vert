@@ -0,0 +1,22 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec2 aTexCoord;
+layout (location = 2) in mat4 aInstanceModel;
+layout (location = 6) in vec4 aInstanceTint;
+
+out vec2 TexCoord;
+out vec4 Tint;
+
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 viewport;
+};
+
+void main() {
+    gl_Position = viewProjection * aInstanceModel * vec4(aPos, 1.0);
+    TexCoord = aTexCoord;
+    Tint = aInstanceTint;
+}
\ No newline at end of file
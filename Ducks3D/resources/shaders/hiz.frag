@@ -0,0 +1,22 @@
+#version 330 core
+// one texel of a depth pyramid level: the farthest depth of the 2x2 texels below it. On an odd
+// sized level below, the last column and row also take in the texels the halving leaves over
+
+out float Depth;
+
+// the level below, with base and max level set to it
+uniform sampler2D source;
+
+void main() {
+    ivec2 texel = ivec2(gl_FragCoord.xy);
+    ivec2 sourceSize = textureSize(source, 0);
+    ivec2 size = max(sourceSize / 2, ivec2(1));
+    ivec2 first = texel * 2;
+    ivec2 last = min(first + 1 + ivec2(equal(texel, size - 1)) * (sourceSize & 1), sourceSize - 1);
+    float depth = 0.0;
+    for (int y = first.y; y <= last.y; y++) {
+        for (int x = first.x; x <= last.x; x++)
+            depth = max(depth, texelFetch(source, ivec2(x, y), 0).r);
+    }
+    Depth = depth;
+}
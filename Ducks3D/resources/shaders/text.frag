@@ -0,0 +1,12 @@
+#version 330 core
+
+in vec2 TexCoord;
+in vec4 Color;
+
+out vec4 FragColor;
+
+uniform sampler2D _texture;
+
+void main() {
+	FragColor = vec4(Color.rgb, Color.a * texture(_texture, TexCoord).r);
+}
\ No newline at end of file
@@ -0,0 +1,98 @@
+#ifndef RESOURCE_HANDLE_H
+#define RESOURCE_HANDLE_H
+
+#include <deque>
+#include <vector>
+#include <string>
+#include <unordered_map>
+
+// A generational handle into a SlotArray. The index picks the slot, the
+// generation has to match the slot's current one, so a handle to a released
+// resource stays invalid even after its slot has been reused. The type
+// parameter only keeps shader and texture handles apart.
+template <typename T>
+struct ResourceHandle {
+    unsigned int index = ~0u;
+    unsigned int generation = 0;
+
+    bool IsValid() const { return index != ~0u; }
+    bool operator==(const ResourceHandle& other) const { return index == other.index && generation == other.generation; }
+    bool operator!=(const ResourceHandle& other) const { return !(*this == other); }
+};
+
+// Dense storage behind generational handles. Names are only resolved when
+// resources are stored or looked up up front, Get is a bounds and generation
+// check followed by an index. Resources live in a deque, so references handed
+// out stay valid while more resources are stored.
+template <typename T>
+class SlotArray {
+public:
+    typedef ResourceHandle<T> Handle;
+
+    // stores resource under name, replacing (and keeping the handle of) a resource already stored under it
+    Handle Store(const std::string& name, const T& resource) {
+        auto found = names.find(name);
+        if (found != names.end()) {
+            items[found->second.index] = resource;
+            return found->second;
+        }
+        Handle handle;
+        if (!freeSlots.empty()) {
+            handle.index = freeSlots.back();
+            freeSlots.pop_back();
+            items[handle.index] = resource;
+        }
+        else {
+            handle.index = static_cast<unsigned int>(items.size());
+            items.push_back(resource);
+            generations.push_back(0);
+        }
+        handle.generation = generations[handle.index];
+        alive.resize(items.size(), false);
+        alive[handle.index] = true;
+        names[name] = handle;
+        return handle;
+    }
+
+    // resolves a name, unknown names give an invalid handle
+    Handle Find(const std::string& name) const {
+        auto found = names.find(name);
+        return found != names.end() ? found->second : Handle();
+    }
+
+    // null for invalid and stale handles
+    T* Get(Handle handle) {
+        if (handle.index >= items.size() || generations[handle.index] != handle.generation || !alive[handle.index])
+            return nullptr;
+        return &items[handle.index];
+    }
+
+    // calls function on every stored resource
+    template <typename Function>
+    void ForEach(Function function) {
+        for (size_t i = 0; i < items.size(); i++) {
+            if (alive[i])
+                function(items[i]);
+        }
+    }
+
+    // releases every slot, all handles handed out so far go stale
+    void Clear() {
+        for (unsigned int i = 0; i < items.size(); i++) {
+            if (!alive[i])
+                continue;
+            alive[i] = false;
+            generations[i]++;
+            freeSlots.push_back(i);
+        }
+        names.clear();
+    }
+private:
+    std::deque<T> items;
+    std::vector<unsigned int> generations;
+    std::vector<bool> alive;
+    std::vector<unsigned int> freeSlots;
+    std::unordered_map<std::string, Handle> names;
+};
+
+#endif
@@ -6,38 +6,151 @@
 
 #include <stb_image.h>
 
+#include "rendering/RenderState.h"
+#include "rendering/GLExtensions.h"
+#include "texture/CompressedImage.h"
+#include "shader/ProgramCache.h"
+
 // Instantiate static variables
-std::map<std::string, Texture2D> ResourceManager::textures;
-std::map<std::string, Shader> ResourceManager::shaders;
+SlotArray<Texture2D> ResourceManager::textures;
+SlotArray<Shader> ResourceManager::shaders;
+Shader ResourceManager::missingShader;
+TextureLoader ResourceManager::textureLoader;
+std::vector<ResourceManager::CompilingShader> ResourceManager::compilingShaders;
+
+ShaderHandle ResourceManager::loadShader(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile, const std::string& name) {
+    CompilingShader compiling;
+    Shader shader = loadShaderFromFile(vShaderFile, fShaderFile, gShaderFile, compiling);
+    compiling.handle = shaders.Store(name, shader);
+    if (shader.IsCompiling())
+        compilingShaders.push_back(compiling);
+    return compiling.handle;
+}
+
+ShaderHandle ResourceManager::loadComputeShader(const char* cShaderFile, const std::string& name) {
+    std::ifstream computeShaderFile(cShaderFile);
+    if (!computeShaderFile)
+        std::cout << "ERROR::SHADER: Failed to read shader file " << cShaderFile << std::endl;
+    std::stringstream cShaderStream;
+    cShaderStream << computeShaderFile.rdbuf();
+    std::string computeCode = cShaderStream.str();
+    Shader shader;
+    shader.CompileCompute(computeCode.c_str());
+    return shaders.Store(name, shader);
+}
+
+void ResourceManager::updateShaders() {
+    size_t kept = 0;
+    for (size_t i = 0; i < compilingShaders.size(); i++) {
+        Shader* shader = shaders.Get(compilingShaders[i].handle);
+        if (shader && !shader->IsCompiled())
+            compilingShaders[kept++] = compilingShaders[i];
+        else
+            finishShader(compilingShaders[i]);
+    }
+    compilingShaders.resize(kept);
+}
+
+void ResourceManager::finishShaders() {
+    // the driver keeps compiling the rest while the first ones are waited for,
+    // so this takes as long as the slowest program rather than all of them
+    for (const CompilingShader& compiling : compilingShaders)
+        finishShader(compiling);
+    compilingShaders.clear();
+}
 
-Shader ResourceManager::loadShader(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile, std::string name) {
-    shaders[name] = loadShaderFromFile(vShaderFile, fShaderFile, gShaderFile);
-    return shaders[name];
+size_t ResourceManager::pendingShaders() {
+    return compilingShaders.size();
 }
 
-Shader& ResourceManager::getShader(std::string name) {
-    return shaders[name];
+ShaderHandle ResourceManager::findShader(const std::string& name) {
+    return shaders.Find(name);
 }
 
-Texture2D ResourceManager::loadTexture(const char* file, bool alpha, std::string name) {
-    textures[name] = loadTextureFromFile(file, alpha);
-    return textures[name];
+Shader& ResourceManager::getShader(ShaderHandle handle) {
+    Shader* shader = shaders.Get(handle);
+    return shader ? *shader : missingShader;
 }
 
-Texture2D& ResourceManager::getTexture(std::string name) {
-    return textures[name];
+Shader& ResourceManager::getShader(const std::string& name) {
+    ShaderHandle handle = shaders.Find(name);
+    if (!handle.IsValid())
+        std::cerr << "ResourceManager: no shader named " << name << std::endl;
+    return getShader(handle);
+}
+
+TextureHandle ResourceManager::loadTexture(const char* file, bool alpha, const std::string& name) {
+    return textures.Store(name, loadTextureFromFile(file, alpha));
+}
+
+TextureHandle ResourceManager::loadTextureAsync(const char* file, bool alpha, const std::string& name) {
+    Texture2D texture;
+    if (alpha) {
+        texture.internalFormat = GL_RGBA;
+        texture.imageFormat = GL_RGBA;
+    }
+    // mid grey, so surfaces don't flash a loud color while their textures stream in
+    unsigned char placeholder[4] = { 128, 128, 128, 255 };
+    texture.Generate(1, 1, placeholder);
+    TextureHandle handle = textures.Store(name, texture);
+    textureLoader.Request(handle, file, alpha ? 4 : 3);
+    return handle;
+}
+
+void ResourceManager::updateTextures(size_t byteBudget) {
+    textureLoader.Upload(textures, byteBudget);
+}
+
+void ResourceManager::finishTextures() {
+    textureLoader.Finish(textures);
+}
+
+bool ResourceManager::isTextureReady(TextureHandle handle) {
+    return textures.Get(handle) != nullptr && !textureLoader.IsPending(handle);
+}
+
+size_t ResourceManager::pendingTextures() {
+    return textureLoader.PendingCount();
+}
+
+TextureHandle ResourceManager::findTexture(const std::string& name) {
+    return textures.Find(name);
+}
+
+Texture2D& ResourceManager::getTexture(TextureHandle handle) {
+    Texture2D* texture = textures.Get(handle);
+    return texture ? *texture : missingTexture();
+}
+
+Texture2D& ResourceManager::getTexture(const std::string& name) {
+    TextureHandle handle = textures.Find(name);
+    if (!handle.IsValid())
+        std::cerr << "ResourceManager: no texture named " << name << std::endl;
+    return getTexture(handle);
 }
 
 void ResourceManager::clear() {
+    // stop streaming into textures that are about to be deleted
+    textureLoader.Release();
+    // compiles in flight still own their shader objects
+    finishShaders();
     // (properly) delete all shaders
-    for (auto iter : shaders)
-        glDeleteProgram(iter.second.id);
+    shaders.ForEach([](Shader& shader) { glDeleteProgram(shader.id); });
     // (properly) delete all textures
-    for (auto iter : textures)
-        glDeleteTextures(1, &iter.second.id);
+    textures.ForEach([](Texture2D& texture) { glDeleteTextures(1, &texture.id); });
+    shaders.Clear();
+    textures.Clear();
+    // deleted objects may still be cached as bound
+    RenderState::Invalidate();
+}
+
+Texture2D& ResourceManager::missingTexture() {
+    // Texture2D generates a GL name on construction, so this one is only made once a context exists
+    static Texture2D texture;
+    return texture;
 }
 
-Shader ResourceManager::loadShaderFromFile(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile) {
+Shader ResourceManager::loadShaderFromFile(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile, CompilingShader& compiling) {
     // 1. retrieve the vertex/fragment source code from filePath
     std::string vertexCode;
     std::string fragmentCode;
@@ -71,22 +184,50 @@ Shader ResourceManager::loadShaderFromFile(const char* vShaderFile, const char*
     const char* vShaderCode = vertexCode.c_str();
     const char* fShaderCode = fragmentCode.c_str();
     const char* gShaderCode = geometryCode.c_str();
-    // 2. now create shader object from source code
+    // 2. reuse the driver's binary from an earlier run if the sources and the driver are unchanged
+    compiling.cachePath = ProgramCache::PathFor(vShaderFile, fShaderFile, gShaderFile);
+    compiling.cacheKey = ProgramCache::Key(vertexCode, fragmentCode, geometryCode);
     Shader shader;
-    shader.Compile(vShaderCode, fShaderCode, gShaderFile != nullptr ? gShaderCode : nullptr);
+    if (ProgramCache::Load(compiling.cachePath, compiling.cacheKey, shader))
+        return shader;
+    // 3. otherwise start creating the shader object from source code, finishShader completes it
+    shader.StartCompile(vShaderCode, fShaderCode, gShaderFile != nullptr ? gShaderCode : nullptr);
     return shader;
 }
 
+void ResourceManager::finishShader(const CompilingShader& compiling) {
+    Shader* shader = shaders.Get(compiling.handle);
+    if (!shader)
+        return;
+    shader->FinishCompile();
+    ProgramCache::Write(compiling.cachePath, compiling.cacheKey, *shader);
+}
+
 Texture2D ResourceManager::loadTextureFromFile(const char* file, bool alpha) {
     // create texture object
     Texture2D texture;
+    if (CompressedImage::IsContainer(file)) {
+        // pre-compressed blocks go to the GPU as they are, alpha is decided by the container's format
+        CompressedImage image;
+        if (!CompressedImage::Load(file, image))
+            std::cout << "ERROR::TEXTURE: Failed to load " << file << std::endl;
+        else if (!GLExtensions::SupportsCompressedFormat(image.format))
+            std::cout << "ERROR::TEXTURE: " << file << " uses a compressed format the driver doesn't support" << std::endl;
+        else
+            texture.GenerateCompressed(image);
+        return texture;
+    }
     if (alpha) {
         texture.internalFormat = GL_RGBA;
         texture.imageFormat = GL_RGBA;
     }
-    // load image
+    // load image, converted to the channel count the format expects
     int width, height, nrChannels;
-    unsigned char* data = stbi_load(file, &width, &height, &nrChannels, 0);
+    unsigned char* data = stbi_load(file, &width, &height, &nrChannels, alpha ? 4 : 3);
+    if (!data) {
+        std::cout << "ERROR::TEXTURE: Failed to load " << file << std::endl;
+        return texture;
+    }
     // now generate texture
     texture.Generate(width, height, data);
     // and finally free image data
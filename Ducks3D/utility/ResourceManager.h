@@ -1,39 +1,92 @@
 #ifndef RESOURCE_MANAGER_H
 #define RESOURCE_MANAGER_H
 
-#include <map>
 #include <string>
+#include <vector>
+#include <cstdint>
 
 #include <glad/glad.h>
 
 #include "texture/Texture2D.h"
+#include "texture/TextureLoader.h"
 #include "shader/Shader.h"
+#include "ResourceHandle.h"
+
+typedef ResourceHandle<Shader> ShaderHandle;
+typedef ResourceHandle<Texture2D> TextureHandle;
 
 // A static singleton ResourceManager class that hosts several
 // functions to load Textures and Shaders. Each loaded texture
-// and/or shader is also stored for future reference by string
-// handles. All functions and resources are static and no 
-// public constructor is defined.
+// and/or shader is stored in a dense slot array and referred to
+// by a generational handle. Names are resolved to handles once,
+// when loading or during setup, so lookups in the render loop
+// are an array index. Textures can also be loaded asynchronously:
+// the handle is valid right away and shows a placeholder until
+// updateTextures has streamed the decoded image in. Shader programs
+// are compiled by the driver in the background in the same way, and are
+// usable once updateShaders or finishShaders has completed them. All functions
+// and resources are static and no public constructor is defined.
 class ResourceManager {
 public:
-    // resource storage
-    static std::map<std::string, Shader>    shaders;
-    static std::map<std::string, Texture2D> textures;
-    // loads (and generates) a shader program from file loading vertex, fragment (and geometry) shader's source code. If gShaderFile is not nullptr, it also loads a geometry shader
-    static Shader loadShader(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile, std::string name);
-    // retrieves a stored sader
-    static Shader& getShader(std::string name);
-    // loads (and generates) a texture from file
-    static Texture2D loadTexture(const char* file, bool alpha, std::string name);
-    // retrieves a stored texture
-    static Texture2D& getTexture(std::string name);
+    // loads (and generates) a shader program from file loading vertex, fragment (and geometry) shader's source code. If gShaderFile is not nullptr, it also loads a geometry shader.
+    // Unless it comes from the program cache it is still compiling on return and can't be used before updateShaders or finishShaders completed it
+    static ShaderHandle loadShader(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile, const std::string& name);
+    // loads a compute program from file, compiled and linked before it returns. Needs GLExtensions::ComputeShaders
+    static ShaderHandle loadComputeShader(const char* cShaderFile, const std::string& name);
+    // completes the programs the driver has finished compiling, without waiting for the others
+    static void updateShaders();
+    // blocks until every program has been compiled and completes them
+    static void finishShaders();
+    // number of programs that haven't been completed yet
+    static size_t pendingShaders();
+    // resolves the handle of a stored shader, unknown names give an invalid handle
+    static ShaderHandle findShader(const std::string& name);
+    // retrieves a stored shader, invalid or stale handles give an empty shader (program 0)
+    static Shader& getShader(ShaderHandle handle);
+    // retrieves a stored shader by name, meant for setup code rather than the render loop
+    static Shader& getShader(const std::string& name);
+    // loads (and generates) a texture from file, .dds and .ktx2 files are uploaded block compressed
+    static TextureHandle loadTexture(const char* file, bool alpha, const std::string& name);
+    // queues a texture for decoding on the loader's worker threads and returns its handle right away,
+    // the texture is a 1x1 placeholder until updateTextures has uploaded the image
+    static TextureHandle loadTextureAsync(const char* file, bool alpha, const std::string& name);
+    // uploads decoded textures, at most byteBudget bytes of pixels (but always at least one texture). Call once per frame
+    static void updateTextures(size_t byteBudget);
+    // blocks until every asynchronous texture load has been uploaded
+    static void finishTextures();
+    // false while an asynchronous load of the texture is still in flight, a failed load keeps the placeholder
+    static bool isTextureReady(TextureHandle handle);
+    // number of asynchronous texture loads that haven't been uploaded yet
+    static size_t pendingTextures();
+    // resolves the handle of a stored texture, unknown names give an invalid handle
+    static TextureHandle findTexture(const std::string& name);
+    // retrieves a stored texture, invalid or stale handles give an empty texture
+    static Texture2D& getTexture(TextureHandle handle);
+    // retrieves a stored texture by name, meant for setup code rather than the render loop
+    static Texture2D& getTexture(const std::string& name);
     // properly de-allocates all loaded resources
     static void clear();
 private:
     // private constructor, that is we do not want any actual resource manager objects. Its members and functions should be publicly available (static).
     ResourceManager() {}
-    // loads and generates a shader from file
-    static Shader loadShaderFromFile(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile = nullptr);
+    // resource storage
+    static SlotArray<Shader>    shaders;
+    static SlotArray<Texture2D> textures;
+    // returned for handles that don't resolve, so a miss never stores anything
+    static Shader missingShader;
+    static Texture2D& missingTexture();
+    static TextureLoader textureLoader;
+    // a program still compiling and where its binary is cached once it is done
+    struct CompilingShader {
+        ShaderHandle handle;
+        std::string cachePath;
+        uint64_t cacheKey;
+    };
+    static std::vector<CompilingShader> compilingShaders;
+    // loads a shader from the program cache, or starts compiling it from file and records where to cache it
+    static Shader loadShaderFromFile(const char* vShaderFile, const char* fShaderFile, const char* gShaderFile, CompilingShader& compiling);
+    // checks the results of a compiled program and writes its binary to the cache
+    static void finishShader(const CompilingShader& compiling);
     // loads a single texture from file
     static Texture2D loadTextureFromFile(const char* file, bool alpha);
 };
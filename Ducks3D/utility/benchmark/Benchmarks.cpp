@@ -0,0 +1,228 @@
+#include "Benchmarks.h"
+
+#include <iostream>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../model-loading/Model.h"
+#include "../model-loading/ObjReader.h"
+#include "../transform/TransformStore.h"
+
+namespace {
+    typedef std::chrono::duration<double, std::milli> Milliseconds;
+
+    // runs load iterations times and prints the first (cold, in-process) and the average of the remaining (warm) runs
+    template <typename Load>
+    void timeLoads(const char* label, int iterations, Load load) {
+        double first = 0.0, rest = 0.0;
+        for (int i = 0; i < iterations; i++) {
+            auto start = std::chrono::steady_clock::now();
+            load();
+            // make sure the uploads are part of the measurement
+            glFinish();
+            double elapsed = Milliseconds(std::chrono::steady_clock::now() - start).count();
+            if (i == 0)
+                first = elapsed;
+            else
+                rest += elapsed;
+        }
+        std::printf("%-12s cold %9.3f ms   warm avg %9.3f ms\n", label, first, iterations > 1 ? rest / (iterations - 1) : first);
+    }
+
+    // runs compose iterations times and prints the fastest run, in total and per entity
+    template <typename Compose>
+    void timeTransforms(const char* label, size_t count, int iterations, Compose compose) {
+        double best = 0.0;
+        for (int i = 0; i < iterations; i++) {
+            auto start = std::chrono::steady_clock::now();
+            compose();
+            double elapsed = Milliseconds(std::chrono::steady_clock::now() - start).count();
+            if (i == 0 || elapsed < best)
+                best = elapsed;
+        }
+        std::printf("%-8s %7zu entities %9.3f ms %8.2f ns/entity\n", label, count, best, best * 1e6 / count);
+    }
+
+    // runs parse iterations times and prints the fastest run as throughput over bytes
+    template <typename Parse>
+    void timeParsing(const char* label, size_t bytes, int iterations, Parse parse) {
+        double best = 0.0;
+        for (int i = 0; i < iterations; i++) {
+            auto start = std::chrono::steady_clock::now();
+            parse();
+            double elapsed = Milliseconds(std::chrono::steady_clock::now() - start).count();
+            if (i == 0 || elapsed < best)
+                best = elapsed;
+        }
+        std::printf("%-22s %9.3f ms %9.1f MB/s\n", label, best, bytes / (best * 1e3));
+    }
+
+    // writes copies copies of the OBJ at source to target, each moved along x and with its
+    // face indices shifted past the copies before it. Returns the size written, 0 on failure
+    size_t writeObjCopies(const std::string& source, const std::string& target, int copies) {
+        std::ifstream in(source);
+        std::vector<std::string> lines;
+        size_t positions = 0, texCoords = 0, normals = 0;
+        for (std::string line; std::getline(in, line);) {
+            if (!line.empty() && line.back() == '\r')
+                line.pop_back();
+            positions += line.compare(0, 2, "v ") == 0;
+            texCoords += line.compare(0, 3, "vt ") == 0;
+            normals += line.compare(0, 3, "vn ") == 0;
+            lines.push_back(line);
+        }
+        std::ofstream out(target, std::ios::binary | std::ios::trunc);
+        if (lines.empty() || !out)
+            return 0;
+        char number[32];
+        for (int copy = 0; copy < copies; copy++) {
+            for (const std::string& line : lines) {
+                if (line.compare(0, 2, "v ") == 0) {
+                    std::istringstream fields(line.substr(2));
+                    double x = 0.0, y = 0.0, z = 0.0;
+                    fields >> x >> y >> z;
+                    out << "v";
+                    for (double value : { x + copy * 20.0, y, z }) {
+                        std::snprintf(number, sizeof(number), " %.17g", value);
+                        out << number;
+                    }
+                    out << "\n";
+                }
+                else if (line.compare(0, 2, "f ") == 0) {
+                    // v, v/vt, v//vn or v/vt/vn, relative (negative) indices stay as they are
+                    const size_t offsets[] = { positions * copy, texCoords * copy, normals * copy };
+                    std::istringstream corners(line.substr(2));
+                    out << "f";
+                    for (std::string corner; corners >> corner;) {
+                        out << " ";
+                        size_t field = 0, begin = 0;
+                        while (begin <= corner.size()) {
+                            size_t end = std::min(corner.find('/', begin), corner.size());
+                            if (end > begin) {
+                                long long index = std::atoll(corner.substr(begin, end - begin).c_str());
+                                out << (index > 0 ? index + static_cast<long long>(offsets[std::min<size_t>(field, 2)]) : index);
+                            }
+                            if (end < corner.size())
+                                out << "/";
+                            begin = end + 1;
+                            field++;
+                        }
+                    }
+                    out << "\n";
+                }
+                else {
+                    out << line << "\n";
+                }
+            }
+        }
+        return static_cast<size_t>(out.tellp());
+    }
+}
+
+void Benchmarks::ModelLoading(const std::string& modelPath, int iterations) {
+    std::cout << "Benchmark: model loading of " << modelPath << " (" << iterations << " iterations)" << std::endl;
+    timeLoads("assimp", iterations, [&]() {
+        Model model(modelPath, false, false);
+        model.Release();
+    });
+    if (ObjReader::CanRead(modelPath)) {
+        JobSystem jobs;
+        jobs.Start();
+        timeLoads("obj reader", iterations, [&]() {
+            Model model(modelPath, false, true, &jobs);
+            model.Release();
+        });
+        jobs.Release();
+    }
+    // start the cache path from a freshly written cache
+    std::remove(MeshCache::PathFor(modelPath).c_str());
+    Model writer(modelPath);
+    writer.Release();
+    timeLoads("mesh cache", iterations, [&]() {
+        Model model(modelPath);
+        model.Release();
+    });
+}
+
+void Benchmarks::ObjParsing(const std::string& objPath, int copies, int iterations) {
+    JobSystem jobs;
+    jobs.Start();
+    std::cout << "Benchmark: OBJ parsing, best of " << iterations << " runs, "
+        << jobs.ThreadCount() << " job threads" << std::endl;
+    std::string copiesPath = objPath.substr(0, objPath.find_last_of('.')) + "_bench.obj";
+    size_t copiesSize = writeObjCopies(objPath, copiesPath, copies);
+    if (copiesSize == 0) {
+        std::cerr << "Benchmark: failed to write " << copiesPath << std::endl;
+        return;
+    }
+    std::ifstream source(objPath, std::ios::binary | std::ios::ate);
+    const std::pair<std::string, size_t> files[] = {
+        { objPath, static_cast<size_t>(source.tellg()) },
+        { copiesPath, copiesSize }
+    };
+    for (const auto& file : files) {
+        std::printf("%s (%.2f MB)\n", file.first.c_str(), file.second / 1e6);
+        std::vector<ObjReader::Group> groups;
+        timeParsing("obj reader, 1 thread", file.second, iterations, [&]() {
+            ObjReader::Read(file.first, groups);
+        });
+        timeParsing("obj reader", file.second, iterations, [&]() {
+            ObjReader::Read(file.first, groups, &jobs);
+        });
+        // the same flags Model imports with
+        timeParsing("assimp", file.second, iterations, [&]() {
+            Assimp::Importer importer;
+            importer.ReadFile(file.first, aiProcess_Triangulate | aiProcess_FlipUVs);
+        });
+    }
+    std::remove(copiesPath.c_str());
+    jobs.Release();
+}
+
+void Benchmarks::Transforms(int iterations) {
+    std::cout << "Benchmark: instance transforms, best of " << iterations << " runs, kernel picked at runtime: "
+        << TransformStore::IsaName(TransformStore::BestIsa()) << std::endl;
+    const size_t counts[] = { 1000, 10000, 100000 };
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<float> coordinate(-200.0f, 200.0f);
+    std::uniform_real_distribution<float> angle(-3.14159265f, 3.14159265f);
+    std::uniform_real_distribution<float> size(0.3f, 0.7f);
+    glm::mat4 parent = glm::rotate(glm::mat4(1.0f), 0.5f, glm::vec3(0.0f, 1.0f, 0.0f));
+
+    for (size_t count : counts) {
+        std::vector<glm::vec3> positions(count);
+        std::vector<float> yaws(count), scales(count);
+        TransformStore store;
+        for (size_t i = 0; i < count; i++) {
+            positions[i] = glm::vec3(coordinate(gen), 0.0f, coordinate(gen));
+            yaws[i] = angle(gen);
+            scales[i] = size(gen);
+            store.Add(positions[i], yaws[i], scales[i]);
+        }
+        std::vector<InstanceData> instances(count);
+
+        // the per entity matrix chain the flock was built with before
+        timeTransforms("glm", count, iterations, [&]() {
+            for (size_t i = 0; i < count; i++) {
+                glm::mat4 model = glm::translate(parent, positions[i]);
+                model = glm::rotate(model, yaws[i], glm::vec3(0.0f, 1.0f, 0.0f));
+                model = glm::scale(model, glm::vec3(scales[i]));
+                instances[i].Model = model;
+            }
+        });
+        const TransformStore::Isa isas[] = { TransformStore::ISA_SCALAR, TransformStore::ISA_SSE2, TransformStore::ISA_AVX2 };
+        for (TransformStore::Isa isa : isas) {
+            if (isa > TransformStore::BestIsa())
+                continue;
+            timeTransforms(TransformStore::IsaName(isa), count, iterations, [&]() {
+                store.ComposeWith(isa, 0, count, parent, &instances[0].Model, sizeof(InstanceData));
+            });
+        }
+    }
+}
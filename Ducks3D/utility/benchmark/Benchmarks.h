@@ -0,0 +1,23 @@
+#ifndef BENCHMARKS_H
+#define BENCHMARKS_H
+
+#include <string>
+
+// Startup and throughput benchmarks that run in place of the scene when
+// requested on the command line. Results are printed to stdout.
+class Benchmarks {
+public:
+    // compares cold and warm loads of modelPath through Assimp against its binary mesh cache,
+    // expects a current GL context
+    static void ModelLoading(const std::string& modelPath, int iterations);
+    // parsing throughput of ObjReader (one thread and one per core) against Assimp's importer, on objPath
+    // and on a file of copies copies of it, best of iterations runs each. Needs no GL context
+    static void ObjParsing(const std::string& objPath, int copies, int iterations);
+    // composes instance matrices for 1k, 10k and 100k entities through glm and every TransformStore
+    // kernel the CPU supports, best of iterations runs each
+    static void Transforms(int iterations);
+private:
+    Benchmarks() {}
+};
+
+#endif
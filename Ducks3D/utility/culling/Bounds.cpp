@@ -0,0 +1,66 @@
+#include "Bounds.h"
+
+#include <limits>
+
+const float AABB::MIN_CLIP_W = 1e-4f;
+
+AABB::AABB()
+    : min(std::numeric_limits<float>::max()), max(-std::numeric_limits<float>::max()) {
+}
+
+AABB::AABB(const glm::vec3& min, const glm::vec3& max)
+    : min(min), max(max) {
+}
+
+void AABB::Expand(const glm::vec3& point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+void AABB::Expand(const AABB& other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+}
+
+float AABB::SurfaceArea() const {
+    if (IsEmpty())
+        return 0.0f;
+    glm::vec3 size = max - min;
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+bool AABB::Contains(const AABB& other) const {
+    return glm::all(glm::lessThanEqual(min, other.min)) && glm::all(glm::greaterThanEqual(max, other.max));
+}
+
+AABB AABB::Transformed(const glm::mat4& matrix) const {
+    if (IsEmpty())
+        return *this;
+    // transform the center and grow the extents by the absolute rotation/scale (Arvo)
+    glm::vec3 center = glm::vec3(matrix * glm::vec4(Center(), 1.0f));
+    glm::vec3 extents = Extents();
+    glm::mat3 absolute = glm::mat3(glm::abs(glm::vec3(matrix[0])), glm::abs(glm::vec3(matrix[1])), glm::abs(glm::vec3(matrix[2])));
+    glm::vec3 transformedExtents = absolute * extents;
+    return AABB(center - transformedExtents, center + transformedExtents);
+}
+
+bool AABB::Project(const glm::mat4& viewProjection, glm::vec3& ndcMin, glm::vec3& ndcMax) const {
+    ndcMin = glm::vec3(1e30f);
+    ndcMax = glm::vec3(-1e30f);
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec4 position((corner & 1) ? max.x : min.x, (corner & 2) ? max.y : min.y, (corner & 4) ? max.z : min.z, 1.0f);
+        glm::vec4 clip = viewProjection * position;
+        if (clip.w <= MIN_CLIP_W)
+            return false;
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        ndcMin = glm::min(ndcMin, ndc);
+        ndcMax = glm::max(ndcMax, ndc);
+    }
+    return true;
+}
+
+AABB AABB::Union(const AABB& a, const AABB& b) {
+    AABB result = a;
+    result.Expand(b);
+    return result;
+}
@@ -0,0 +1,41 @@
+#ifndef BOUNDS_H
+#define BOUNDS_H
+
+#include <glm/glm.hpp>
+
+// Axis aligned bounding box. A default constructed box is empty, it
+// becomes valid with the first point it is expanded by.
+struct AABB {
+    glm::vec3 min;
+    glm::vec3 max;
+
+    AABB();
+    AABB(const glm::vec3& min, const glm::vec3& max);
+
+    void Expand(const glm::vec3& point);
+    void Expand(const AABB& other);
+    bool IsEmpty() const { return min.x > max.x; }
+    glm::vec3 Center() const { return (min + max) * 0.5f; }
+    glm::vec3 Extents() const { return (max - min) * 0.5f; }
+    float SurfaceArea() const;
+    bool Contains(const AABB& other) const;
+    // smallest box holding this box transformed by matrix
+    AABB Transformed(const glm::mat4& matrix) const;
+    // normalized device coordinates spanned by the corners seen through viewProjection. False if a corner
+    // reaches behind the eye (w <= MIN_CLIP_W), where the projection says nothing
+    bool Project(const glm::mat4& viewProjection, glm::vec3& ndcMin, glm::vec3& ndcMax) const;
+    static AABB Union(const AABB& a, const AABB& b);
+
+    // corners closer to the eye than this in clip space w count as crossing the near plane
+    static const float MIN_CLIP_W;
+};
+
+struct BoundingSphere {
+    glm::vec3 center;
+    float radius;
+
+    BoundingSphere() : center(0.0f), radius(0.0f) {}
+    BoundingSphere(const glm::vec3& center, float radius) : center(center), radius(radius) {}
+};
+
+#endif
@@ -0,0 +1,329 @@
+#include "DepthPyramid.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "../rendering/RenderState.h"
+
+namespace {
+    // the same reduction as hiz.frag, from a level of sourceSize into one of size
+    void reduce(const std::vector<float>& source, glm::ivec2 sourceSize, std::vector<float>& target, glm::ivec2 size) {
+        target.assign(static_cast<size_t>(size.x) * size.y, 0.0f);
+        for (int y = 0; y < size.y; y++) {
+            int firstY = y * 2;
+            int lastY = std::min(firstY + 1 + (y == size.y - 1 ? (sourceSize.y & 1) : 0), sourceSize.y - 1);
+            for (int x = 0; x < size.x; x++) {
+                int firstX = x * 2;
+                int lastX = std::min(firstX + 1 + (x == size.x - 1 ? (sourceSize.x & 1) : 0), sourceSize.x - 1);
+                float depth = 0.0f;
+                for (int sy = firstY; sy <= lastY; sy++) {
+                    for (int sx = firstX; sx <= lastX; sx++)
+                        depth = std::max(depth, source[static_cast<size_t>(sy) * sourceSize.x + sx]);
+                }
+                target[static_cast<size_t>(y) * size.x + x] = depth;
+            }
+        }
+    }
+
+    // depth and stencil bits of an attachment of the bound read framebuffer, 0 if there is none
+    GLint attachmentBits(GLenum attachment, GLenum size) {
+        GLint type = GL_NONE;
+        glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, attachment, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &type);
+        if (type == GL_NONE)
+            return 0;
+        GLint bits = 0;
+        glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, attachment, size, &bits);
+        return bits;
+    }
+}
+
+DepthPyramid::DepthPyramid()
+    : program(nullptr), depthTexture(0), copyFramebuffer(0), pyramid(0), levelFramebuffer(0), depthFormat(GL_NONE),
+    emptyVertexArray(0), width(0), height(0), viewProjection(1.0f), built(false), nextReadback(0),
+    cpuBaseLevel(0), cpuWidth(0), cpuHeight(0), cpuViewProjection(1.0f) {
+    for (Readback& readback : readbacks) {
+        readback.buffer = 0;
+        readback.fence = nullptr;
+    }
+}
+
+void DepthPyramid::Generate(Shader* program) {
+    this->program = program;
+    glGenFramebuffers(1, &copyFramebuffer);
+    glGenFramebuffers(1, &levelFramebuffer);
+    glGenVertexArrays(1, &emptyVertexArray);
+    program->Use();
+    program->SetInteger("source", 0);
+}
+
+void DepthPyramid::Build(unsigned int framebuffer, int width, int height, const glm::mat4& viewProjection) {
+    if (width <= 0 || height <= 0)
+        return;
+    if (width != this->width || height != this->height || pyramid == 0)
+        resize(framebuffer, width, height);
+
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, copyFramebuffer);
+    glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, levelFramebuffer);
+    RenderState::SetDepthTest(false);
+    RenderState::SetCullFace(false);
+    program->Use();
+    RenderState::BindVertexArray(emptyVertexArray);
+    int levels = Levels();
+    for (int level = 0; level < levels; level++) {
+        if (level == 0) {
+            RenderState::BindTexture2D(0, depthTexture);
+        }
+        else {
+            // only the level below is visible to the shader, the one being written is not
+            RenderState::BindTexture2D(0, pyramid);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+        }
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramid, level);
+        glViewport(0, 0, levelSizes[level].x, levelSizes[level].y);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+    }
+    RenderState::BindTexture2D(0, pyramid);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+    RenderState::BindTexture2D(0, 0);
+
+    RenderState::SetCullFace(true);
+    RenderState::SetDepthTest(true);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glViewport(0, 0, width, height);
+    this->viewProjection = viewProjection;
+    built = true;
+}
+
+void DepthPyramid::RequestReadback() {
+    if (!built)
+        return;
+    Readback& readback = readbacks[nextReadback];
+    nextReadback = (nextReadback + 1) % READBACK_RING;
+    // a readback that never got picked up is stale by now
+    if (readback.fence)
+        glDeleteSync(readback.fence);
+    if (readback.buffer == 0)
+        glGenBuffers(1, &readback.buffer);
+
+    int level = readbackLevel();
+    glm::ivec2 size = levelSizes[level];
+    GLint framebuffer = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &framebuffer);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    glBufferData(GL_PIXEL_PACK_BUFFER, static_cast<size_t>(size.x) * size.y * sizeof(float), nullptr, GL_STREAM_READ);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, levelFramebuffer);
+    glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pyramid, level);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    // into the buffer, so this only queues the copy
+    glReadPixels(0, 0, size.x, size.y, GL_RED, GL_FLOAT, nullptr);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+
+    readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    readback.viewProjection = viewProjection;
+    readback.width = width;
+    readback.height = height;
+}
+
+bool DepthPyramid::UpdateReadback() {
+    // newest first, anything older than a finished readback is dropped
+    int found = -1;
+    for (int i = 1; i <= READBACK_RING; i++) {
+        int slot = (nextReadback - i + READBACK_RING) % READBACK_RING;
+        Readback& readback = readbacks[slot];
+        if (!readback.fence)
+            continue;
+        if (found >= 0) {
+            glDeleteSync(readback.fence);
+            readback.fence = nullptr;
+            continue;
+        }
+        GLenum result = glClientWaitSync(readback.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED)
+            found = slot;
+    }
+    if (found < 0)
+        return false;
+
+    Readback& readback = readbacks[found];
+    glDeleteSync(readback.fence);
+    readback.fence = nullptr;
+
+    // the sizes follow from the framebuffer's, so a resize since the request is no problem
+    cpuWidth = readback.width;
+    cpuHeight = readback.height;
+    cpuViewProjection = readback.viewProjection;
+    cpuSizes.clear();
+    glm::ivec2 size(std::max(cpuWidth / 2, 1), std::max(cpuHeight / 2, 1));
+    // the same level readbackLevel picks
+    cpuBaseLevel = 0;
+    while (size.x > READBACK_WIDTH) {
+        size = glm::max(size / 2, glm::ivec2(1));
+        cpuBaseLevel++;
+    }
+    cpuSizes.push_back(size);
+    while (size.x > 1 || size.y > 1) {
+        size = glm::max(size / 2, glm::ivec2(1));
+        cpuSizes.push_back(size);
+    }
+
+    cpuLevels.resize(cpuSizes.size());
+    glm::ivec2 base = cpuSizes[0];
+    cpuLevels[0].resize(static_cast<size_t>(base.x) * base.y);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    void* data = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, cpuLevels[0].size() * sizeof(float), GL_MAP_READ_BIT);
+    if (data) {
+        std::memcpy(cpuLevels[0].data(), data, cpuLevels[0].size() * sizeof(float));
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    else {
+        // nothing hides behind a far plane
+        std::fill(cpuLevels[0].begin(), cpuLevels[0].end(), 1.0f);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    for (size_t i = 1; i < cpuSizes.size(); i++)
+        reduce(cpuLevels[i - 1], cpuSizes[i - 1], cpuLevels[i], cpuSizes[i]);
+    return true;
+}
+
+bool DepthPyramid::IsOccluded(const AABB& box) const {
+    if (cpuLevels.empty())
+        return false;
+
+    glm::vec3 ndcMin, ndcMax;
+    if (!box.Project(cpuViewProjection, ndcMin, ndcMax))
+        return false;
+    // off screen in that frame, so its depth tells nothing about the box
+    if (ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f)
+        return false;
+    float nearest = ndcMin.z * 0.5f + 0.5f;
+
+    int x0 = glm::clamp(static_cast<int>((ndcMin.x * 0.5f + 0.5f) * cpuWidth), 0, cpuWidth - 1);
+    int x1 = glm::clamp(static_cast<int>((ndcMax.x * 0.5f + 0.5f) * cpuWidth), 0, cpuWidth - 1);
+    int y0 = glm::clamp(static_cast<int>((ndcMin.y * 0.5f + 0.5f) * cpuHeight), 0, cpuHeight - 1);
+    int y1 = glm::clamp(static_cast<int>((ndcMax.y * 0.5f + 0.5f) * cpuHeight), 0, cpuHeight - 1);
+
+    // the finest level where the rectangle spans at most 2x2 texels
+    size_t level = 0;
+    int shift = cpuBaseLevel + 1;
+    while (level + 1 < cpuSizes.size() && ((x1 >> shift) - (x0 >> shift) > 1 || (y1 >> shift) - (y0 >> shift) > 1)) {
+        level++;
+        shift++;
+    }
+    glm::ivec2 size = cpuSizes[level];
+    int tx0 = std::min(x0 >> shift, size.x - 1), tx1 = std::min(x1 >> shift, size.x - 1);
+    int ty0 = std::min(y0 >> shift, size.y - 1), ty1 = std::min(y1 >> shift, size.y - 1);
+    const std::vector<float>& texels = cpuLevels[level];
+    float farthest = std::max(std::max(texels[ty0 * size.x + tx0], texels[ty0 * size.x + tx1]),
+        std::max(texels[ty1 * size.x + tx0], texels[ty1 * size.x + tx1]));
+    return nearest > farthest;
+}
+
+void DepthPyramid::Release() {
+    for (Readback& readback : readbacks) {
+        if (readback.fence)
+            glDeleteSync(readback.fence);
+        if (readback.buffer != 0)
+            glDeleteBuffers(1, &readback.buffer);
+        readback.fence = nullptr;
+        readback.buffer = 0;
+    }
+    if (depthTexture != 0)
+        RenderState::DeleteTexture(depthTexture);
+    if (pyramid != 0)
+        RenderState::DeleteTexture(pyramid);
+    if (copyFramebuffer != 0)
+        glDeleteFramebuffers(1, &copyFramebuffer);
+    if (levelFramebuffer != 0)
+        glDeleteFramebuffers(1, &levelFramebuffer);
+    if (emptyVertexArray != 0)
+        glDeleteVertexArrays(1, &emptyVertexArray);
+    depthTexture = pyramid = copyFramebuffer = levelFramebuffer = emptyVertexArray = 0;
+    width = height = 0;
+    levelSizes.clear();
+    cpuLevels.clear();
+    cpuSizes.clear();
+    built = false;
+}
+
+void DepthPyramid::resize(unsigned int framebuffer, int width, int height) {
+    this->width = width;
+    this->height = height;
+
+    // the blit wants the same depth format on both sides
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    GLint depthBits = attachmentBits(framebuffer == 0 ? GL_DEPTH : GL_DEPTH_ATTACHMENT, GL_FRAMEBUFFER_ATTACHMENT_DEPTH_SIZE);
+    GLint stencilBits = attachmentBits(framebuffer == 0 ? GL_STENCIL : GL_STENCIL_ATTACHMENT, GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE);
+    GLint componentType = GL_UNSIGNED_NORMALIZED;
+    if (depthBits > 0) {
+        glGetFramebufferAttachmentParameteriv(GL_READ_FRAMEBUFFER, framebuffer == 0 ? GL_DEPTH : GL_DEPTH_ATTACHMENT,
+            GL_FRAMEBUFFER_ATTACHMENT_COMPONENT_TYPE, &componentType);
+    }
+    bool floating = componentType == GL_FLOAT;
+    GLenum format = GL_DEPTH_COMPONENT;
+    GLenum type = GL_FLOAT;
+    if (stencilBits > 0) {
+        depthFormat = floating ? GL_DEPTH32F_STENCIL8 : GL_DEPTH24_STENCIL8;
+        format = GL_DEPTH_STENCIL;
+        type = floating ? GL_FLOAT_32_UNSIGNED_INT_24_8_REV : GL_UNSIGNED_INT_24_8;
+    }
+    else if (floating) {
+        depthFormat = GL_DEPTH_COMPONENT32F;
+    }
+    else if (depthBits == 16) {
+        depthFormat = GL_DEPTH_COMPONENT16;
+    }
+    else if (depthBits == 32) {
+        depthFormat = GL_DEPTH_COMPONENT32;
+    }
+    else {
+        depthFormat = GL_DEPTH_COMPONENT24;
+    }
+
+    if (depthTexture == 0)
+        glGenTextures(1, &depthTexture);
+    RenderState::BindTexture2D(0, depthTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, depthFormat, width, height, 0, format, type, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_NONE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, copyFramebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, stencilBits > 0 ? GL_DEPTH_STENCIL_ATTACHMENT : GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, depthTexture, 0);
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+
+    levelSizes.clear();
+    glm::ivec2 size(std::max(width / 2, 1), std::max(height / 2, 1));
+    levelSizes.push_back(size);
+    while (size.x > 1 || size.y > 1) {
+        size = glm::max(size / 2, glm::ivec2(1));
+        levelSizes.push_back(size);
+    }
+    if (pyramid != 0)
+        RenderState::DeleteTexture(pyramid);
+    glGenTextures(1, &pyramid);
+    RenderState::BindTexture2D(0, pyramid);
+    for (size_t level = 0; level < levelSizes.size(); level++)
+        glTexImage2D(GL_TEXTURE_2D, static_cast<GLint>(level), GL_R32F, levelSizes[level].x, levelSizes[level].y, 0, GL_RED, GL_FLOAT, nullptr);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(levelSizes.size()) - 1);
+    RenderState::BindTexture2D(0, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+}
+
+int DepthPyramid::readbackLevel() const {
+    int level = 0;
+    while (level + 1 < Levels() && levelSizes[level].x > READBACK_WIDTH)
+        level++;
+    return level;
+}
@@ -0,0 +1,94 @@
+#ifndef DEPTH_PYRAMID_H
+#define DEPTH_PYRAMID_H
+
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "../shader/Shader.h"
+
+// A hierarchical depth buffer for occlusion culling. Build copies the
+// depth of a framebuffer and reduces it into a mip chain whose texels
+// hold the farthest depth of the pixels they cover: level 0 is half
+// the framebuffer's size, every level above halves it again down to
+// 1x1. A box whose nearest depth lies behind the farthest depth under
+// its screen rectangle is hidden, and the level where the rectangle
+// spans at most 2x2 texels answers that with four reads.
+//
+// The pyramid remembers the view projection of the frame it was built
+// from, so later frames test against it by projecting their boxes with
+// those matrices. The GPU samples the texture directly; for the CPU a
+// small level is read back asynchronously and the levels above it are
+// reduced again on the CPU, so IsOccluded answers with the pyramid of
+// a frame or two ago and never waits for the GPU.
+class DepthPyramid {
+public:
+    // unit the pyramid is bound to while the culling shader runs
+    static const unsigned int TEXTURE_UNIT = 1;
+    // the level read back for CPU tests is the first at most this wide
+    static const int READBACK_WIDTH = 256;
+    static const int READBACK_RING = 3;
+
+    DepthPyramid();
+
+    // program is hiz.vert/hiz.frag
+    void Generate(Shader* program);
+    // copies the depth of framebuffer, width x height pixels, into the pyramid and reduces it,
+    // viewProjection being what it was rendered with. Leaves the viewport at width x height
+    // and framebuffer bound
+    void Build(unsigned int framebuffer, int width, int height, const glm::mat4& viewProjection);
+    // starts reading back the pyramid just built for IsOccluded
+    void RequestReadback();
+    // picks up the newest finished readback without waiting, returns true if there was one
+    bool UpdateReadback();
+
+    // true once Build has run
+    bool IsBuilt() const { return built; }
+    unsigned int Texture() const { return pyramid; }
+    // size of the depth buffer the pyramid was built from, level 0 is half of it
+    int Width() const { return width; }
+    int Height() const { return height; }
+    int Levels() const { return static_cast<int>(levelSizes.size()); }
+    const glm::mat4& ViewProjection() const { return viewProjection; }
+    // true if box is hidden in the read back pyramid, false while there is none yet
+    bool IsOccluded(const AABB& box) const;
+    // true once a readback has arrived
+    bool HasReadback() const { return !cpuLevels.empty(); }
+    void Release();
+private:
+    // a readback in flight
+    struct Readback {
+        unsigned int buffer;
+        GLsync fence;
+        glm::mat4 viewProjection;
+        int width, height;
+    };
+
+    Shader* program;
+    // depth copy and its framebuffer, the pyramid and the one its levels are rendered through
+    unsigned int depthTexture, copyFramebuffer, pyramid, levelFramebuffer;
+    // depth format of depthTexture, matching the framebuffer's so it can be blitted
+    GLenum depthFormat;
+    // drawn without attributes, but core profiles want a vertex array bound
+    unsigned int emptyVertexArray;
+    int width, height;
+    std::vector<glm::ivec2> levelSizes;
+    glm::mat4 viewProjection;
+    bool built;
+
+    Readback readbacks[READBACK_RING];
+    int nextReadback;
+    // levels readbackLevel and up of the last finished readback, with its size and matrices
+    std::vector<std::vector<float>> cpuLevels;
+    std::vector<glm::ivec2> cpuSizes;
+    int cpuBaseLevel, cpuWidth, cpuHeight;
+    glm::mat4 cpuViewProjection;
+
+    // (re)creates the textures for a width x height depth buffer with the depth format of framebuffer
+    void resize(unsigned int framebuffer, int width, int height);
+    int readbackLevel() const;
+};
+
+#endif
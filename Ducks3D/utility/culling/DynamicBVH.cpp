@@ -0,0 +1,164 @@
+#include "DynamicBVH.h"
+
+DynamicBVH::DynamicBVH()
+    : root(NULL_NODE), leafCount(0) {
+}
+
+int DynamicBVH::Insert(const AABB& box, unsigned int object) {
+    int leaf = allocateNode();
+    nodes[leaf].box = box;
+    nodes[leaf].object = object;
+    leafCount++;
+    if (root == NULL_NODE) {
+        root = leaf;
+        return leaf;
+    }
+
+    // walk down towards the sibling whose union with the leaf adds the least area,
+    // stop where pairing with the current node is cheaper than descending
+    int sibling = root;
+    while (!nodes[sibling].IsLeaf()) {
+        const Node& node = nodes[sibling];
+        float area = node.box.SurfaceArea();
+        float combinedArea = AABB::Union(node.box, box).SurfaceArea();
+        // cost of a new parent here, and the growth every descent pushes onto this node
+        float cost = 2.0f * combinedArea;
+        float inheritedCost = 2.0f * (combinedArea - area);
+
+        auto descendCost = [&](int child) {
+            float grown = AABB::Union(nodes[child].box, box).SurfaceArea();
+            if (nodes[child].IsLeaf())
+                return grown + inheritedCost;
+            return grown - nodes[child].box.SurfaceArea() + inheritedCost;
+        };
+        float leftCost = descendCost(node.left);
+        float rightCost = descendCost(node.right);
+        if (cost < leftCost && cost < rightCost)
+            break;
+        sibling = leftCost < rightCost ? node.left : node.right;
+    }
+
+    int oldParent = nodes[sibling].parent;
+    int parent = allocateNode();
+    nodes[parent].parent = oldParent;
+    nodes[parent].left = sibling;
+    nodes[parent].right = leaf;
+    nodes[sibling].parent = parent;
+    nodes[leaf].parent = parent;
+    if (oldParent == NULL_NODE)
+        root = parent;
+    else if (nodes[oldParent].left == sibling)
+        nodes[oldParent].left = parent;
+    else
+        nodes[oldParent].right = parent;
+    refit(parent);
+    return leaf;
+}
+
+void DynamicBVH::Remove(int proxy) {
+    leafCount--;
+    int parent = nodes[proxy].parent;
+    freeNode(proxy);
+    if (parent == NULL_NODE) {
+        root = NULL_NODE;
+        return;
+    }
+
+    // the sibling takes the parent's place
+    int sibling = nodes[parent].left == proxy ? nodes[parent].right : nodes[parent].left;
+    int grandParent = nodes[parent].parent;
+    nodes[sibling].parent = grandParent;
+    freeNode(parent);
+    if (grandParent == NULL_NODE) {
+        root = sibling;
+        return;
+    }
+    if (nodes[grandParent].left == parent)
+        nodes[grandParent].left = sibling;
+    else
+        nodes[grandParent].right = sibling;
+    refit(grandParent);
+}
+
+void DynamicBVH::Move(int proxy, const AABB& box) {
+    nodes[proxy].box = box;
+    if (nodes[proxy].parent != NULL_NODE)
+        refit(nodes[proxy].parent);
+}
+
+size_t DynamicBVH::Cull(const Frustum& frustum, std::vector<unsigned int>& visible) const {
+    if (root == NULL_NODE)
+        return 0;
+    size_t accepted = visible.size();
+    stack.clear();
+    stack.push_back(root);
+    while (!stack.empty()) {
+        int index = stack.back();
+        stack.pop_back();
+        const Node& node = nodes[index];
+        Frustum::Result result = frustum.Test(node.box);
+        if (result == Frustum::OUTSIDE)
+            continue;
+        if (node.IsLeaf())
+            visible.push_back(node.object);
+        else if (result == Frustum::INSIDE)
+            collectLeaves(index, visible);
+        else {
+            stack.push_back(node.left);
+            stack.push_back(node.right);
+        }
+    }
+    return leafCount - (visible.size() - accepted);
+}
+
+void DynamicBVH::Clear() {
+    nodes.clear();
+    freeNodes.clear();
+    root = NULL_NODE;
+    leafCount = 0;
+}
+
+int DynamicBVH::allocateNode() {
+    int index;
+    if (!freeNodes.empty()) {
+        index = freeNodes.back();
+        freeNodes.pop_back();
+    }
+    else {
+        index = static_cast<int>(nodes.size());
+        nodes.push_back(Node());
+    }
+    Node& node = nodes[index];
+    node.box = AABB();
+    node.parent = node.left = node.right = NULL_NODE;
+    node.object = 0;
+    return index;
+}
+
+void DynamicBVH::freeNode(int node) {
+    freeNodes.push_back(node);
+}
+
+void DynamicBVH::refit(int node) {
+    while (node != NULL_NODE) {
+        Node& current = nodes[node];
+        current.box = AABB::Union(nodes[current.left].box, nodes[current.right].box);
+        node = current.parent;
+    }
+}
+
+void DynamicBVH::collectLeaves(int node, std::vector<unsigned int>& visible) const {
+    // runs on its own stack segment above the one Cull is iterating
+    size_t base = stack.size();
+    stack.push_back(node);
+    while (stack.size() > base) {
+        int index = stack.back();
+        stack.pop_back();
+        if (nodes[index].IsLeaf()) {
+            visible.push_back(nodes[index].object);
+            continue;
+        }
+        stack.push_back(nodes[index].left);
+        stack.push_back(nodes[index].right);
+    }
+}
@@ -0,0 +1,57 @@
+#ifndef DYNAMIC_BVH_H
+#define DYNAMIC_BVH_H
+
+#include <vector>
+
+#include "Bounds.h"
+#include "Frustum.h"
+
+// Dynamic bounding volume hierarchy over scene objects. Every object is a
+// leaf (a proxy) holding its world space box and a user value. Leaves
+// are inserted next to the sibling that grows the tree's surface area
+// the least; a moved object only refits the boxes of its ancestors, so
+// per-frame motion costs O(depth) and never restructures the tree.
+class DynamicBVH {
+public:
+    static const int NULL_NODE = -1;
+
+    DynamicBVH();
+
+    // adds a leaf, returns its proxy id
+    int Insert(const AABB& box, unsigned int object);
+    void Remove(int proxy);
+    // sets the leaf's box and refits its ancestors
+    void Move(int proxy, const AABB& box);
+    const AABB& Bounds(int proxy) const { return nodes[proxy].box; }
+    unsigned int Object(int proxy) const { return nodes[proxy].object; }
+    // appends the objects whose leaves intersect frustum to visible, subtrees that are
+    // entirely inside are taken without testing their leaves. Returns the number of leaves rejected
+    size_t Cull(const Frustum& frustum, std::vector<unsigned int>& visible) const;
+    size_t LeafCount() const { return leafCount; }
+    void Clear();
+private:
+    struct Node {
+        AABB box;
+        int parent;
+        // both NULL_NODE for leaves
+        int left, right;
+        unsigned int object;
+
+        bool IsLeaf() const { return left == NULL_NODE; }
+    };
+
+    std::vector<Node> nodes;
+    std::vector<int> freeNodes;
+    int root;
+    size_t leafCount;
+    // traversal stack reused by Cull
+    mutable std::vector<int> stack;
+
+    int allocateNode();
+    void freeNode(int node);
+    // recomputes the boxes from node up to the root
+    void refit(int node);
+    void collectLeaves(int node, std::vector<unsigned int>& visible) const;
+};
+
+#endif
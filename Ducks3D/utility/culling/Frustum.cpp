@@ -0,0 +1,82 @@
+#include "Frustum.h"
+
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_SSE 1
+#include <emmintrin.h>
+#endif
+
+Frustum::Frustum() {
+    // padding planes (and an unextracted frustum) accept everything
+    for (int i = 0; i < PLANE_COUNT; i++) {
+        normalX[i] = normalY[i] = normalZ[i] = 0.0f;
+        absNormalX[i] = absNormalY[i] = absNormalZ[i] = 0.0f;
+        distance[i] = 1.0f;
+    }
+}
+
+void Frustum::Extract(const glm::mat4& viewProjection) {
+    // rows of the matrix, glm is column major
+    glm::vec4 row[4];
+    for (int i = 0; i < 4; i++)
+        row[i] = glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]);
+    // left, right, bottom, top, near, far
+    glm::vec4 planes[6] = {
+        row[3] + row[0], row[3] - row[0],
+        row[3] + row[1], row[3] - row[1],
+        row[3] + row[2], row[3] - row[2]
+    };
+    for (int i = 0; i < 6; i++) {
+        glm::vec4 plane = planes[i] / glm::length(glm::vec3(planes[i]));
+        normalX[i] = plane.x;
+        normalY[i] = plane.y;
+        normalZ[i] = plane.z;
+        distance[i] = plane.w;
+        absNormalX[i] = std::fabs(plane.x);
+        absNormalY[i] = std::fabs(plane.y);
+        absNormalZ[i] = std::fabs(plane.z);
+    }
+}
+
+Frustum::Result Frustum::Test(const AABB& box) const {
+    return test(box.Center(), box.Extents(), 0.0f);
+}
+
+Frustum::Result Frustum::Test(const BoundingSphere& sphere) const {
+    return test(sphere.center, glm::vec3(0.0f), sphere.radius);
+}
+
+Frustum::Result Frustum::test(const glm::vec3& center, const glm::vec3& extents, float radius) const {
+    // per plane: signed distance of the center and the radius of the volume along the normal.
+    // behind any plane by more than the radius is outside, in front of all by more than it is inside
+#ifdef FRUSTUM_SSE
+    __m128 cx = _mm_set1_ps(center.x), cy = _mm_set1_ps(center.y), cz = _mm_set1_ps(center.z);
+    __m128 ex = _mm_set1_ps(extents.x), ey = _mm_set1_ps(extents.y), ez = _mm_set1_ps(extents.z);
+    __m128 r = _mm_set1_ps(radius);
+    __m128 zero = _mm_setzero_ps();
+    int outside = 0, intersecting = 0;
+    for (int i = 0; i < PLANE_COUNT; i += 4) {
+        __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(normalX + i), cx), _mm_mul_ps(_mm_load_ps(normalY + i), cy)),
+            _mm_add_ps(_mm_mul_ps(_mm_load_ps(normalZ + i), cz), _mm_load_ps(distance + i)));
+        __m128 projected = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_load_ps(absNormalX + i), ex), _mm_mul_ps(_mm_load_ps(absNormalY + i), ey)),
+            _mm_add_ps(_mm_mul_ps(_mm_load_ps(absNormalZ + i), ez), r));
+        outside |= _mm_movemask_ps(_mm_cmplt_ps(_mm_add_ps(d, projected), zero));
+        intersecting |= _mm_movemask_ps(_mm_cmplt_ps(_mm_sub_ps(d, projected), zero));
+    }
+    if (outside)
+        return OUTSIDE;
+    return intersecting ? INTERSECTING : INSIDE;
+#else
+    bool intersecting = false;
+    for (int i = 0; i < PLANE_COUNT; i++) {
+        float d = normalX[i] * center.x + normalY[i] * center.y + normalZ[i] * center.z + distance[i];
+        float projected = absNormalX[i] * extents.x + absNormalY[i] * extents.y + absNormalZ[i] * extents.z + radius;
+        if (d + projected < 0.0f)
+            return OUTSIDE;
+        if (d - projected < 0.0f)
+            intersecting = true;
+    }
+    return intersecting ? INTERSECTING : INSIDE;
+#endif
+}
@@ -0,0 +1,44 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+
+// The six planes of a view frustum, extracted from a combined
+// projection * view matrix (Gribb/Hartmann) and stored as structure of
+// arrays, padded to eight planes that never reject. A box is tested
+// against all planes at once, four per SSE register where available.
+class Frustum {
+public:
+    enum Result {
+        OUTSIDE,
+        INTERSECTING,
+        INSIDE
+    };
+
+    Frustum();
+
+    // extracts normalized planes with normals pointing into the frustum
+    void Extract(const glm::mat4& viewProjection);
+    Result Test(const AABB& box) const;
+    Result Test(const BoundingSphere& sphere) const;
+    // plane index in the order left, right, bottom, top, near, far as normal and distance,
+    // a point p is inside where dot(normal, p) + distance >= 0
+    glm::vec4 Plane(int index) const { return glm::vec4(normalX[index], normalY[index], normalZ[index], distance[index]); }
+private:
+    static const int PLANE_COUNT = 8;
+
+    alignas(16) float normalX[PLANE_COUNT];
+    alignas(16) float normalY[PLANE_COUNT];
+    alignas(16) float normalZ[PLANE_COUNT];
+    alignas(16) float distance[PLANE_COUNT];
+    // absolute normals, so a box's projected radius is a dot product with its extents
+    alignas(16) float absNormalX[PLANE_COUNT];
+    alignas(16) float absNormalY[PLANE_COUNT];
+    alignas(16) float absNormalZ[PLANE_COUNT];
+
+    Result test(const glm::vec3& center, const glm::vec3& extents, float radius) const;
+};
+
+#endif
@@ -0,0 +1,232 @@
+#include "GpuCuller.h"
+
+#include <algorithm>
+
+#include "../model-loading/GeometryPool.h"
+#include "../rendering/RenderState.h"
+
+GpuCuller::GpuCuller()
+    : program(nullptr), model(nullptr), instanceBuffer(0), visibleBuffer(0), commandBuffer(0), levelBuffer(0), cullDataBuffer(0),
+    retestBuffer(0), statsSlot(0), vao(0), capacity(0), instanceCount(0), occlusionTested(false) {
+    for (int slot = 0; slot < STATS_RING; slot++) {
+        statsBuffers[slot] = 0;
+        statsFences[slot] = nullptr;
+    }
+}
+
+void GpuCuller::Generate(Shader* program, const Model* model) {
+    this->program = program;
+    this->model = model;
+    phaseUniform = program->GetUniform("phase");
+    occlusionViewProjectionUniform = program->GetUniform("occlusionViewProjection");
+    pyramidUniform = program->GetUniform("pyramid");
+    glGenBuffers(1, &instanceBuffer);
+    glGenBuffers(1, &visibleBuffer);
+    glGenBuffers(1, &commandBuffer);
+    glGenBuffers(1, &levelBuffer);
+    glGenBuffers(1, &cullDataBuffer);
+    glGenBuffers(1, &retestBuffer);
+    glGenBuffers(STATS_RING, statsBuffers);
+    // resizing keeps the buffer names, so the vertex array stays valid
+    vao = GeometryPool::CreateInstancedVertexArray(visibleBuffer);
+}
+
+void GpuCuller::Cull(const std::vector<InstanceData>& instances, const Frustum& frustum, float pixelsPerUnitAtOne, float threshold,
+    const DepthPyramid* occluders) {
+    instanceCount = instances.size();
+    if (instanceCount > capacity)
+        reserve(std::max(instanceCount, capacity * 2));
+    unsigned int lodCount = std::max(model->LodCount(), 1u);
+    const std::vector<Mesh>& meshes = model->Meshes();
+
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, instanceBuffer);
+    // respecifying the storage orphans it, so we never wait on a dispatch still reading last frame's data
+    glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(InstanceData), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, instanceCount * sizeof(InstanceData), instances.data());
+
+    // one empty command per phase, level and mesh, the pool may have moved the meshes since the last frame
+    commands.clear();
+    for (unsigned int level = 0; level < lodCount * 2; level++) {
+        for (const Mesh& mesh : meshes) {
+            const GeometryRange& range = mesh.Range();
+            const MeshLod& lod = mesh.Lod(level % lodCount);
+            DrawElementsIndirectCommand command;
+            command.count = lod.indexCount;
+            command.instanceCount = 0;
+            command.firstIndex = range.firstIndex + lod.firstIndex;
+            command.baseVertex = static_cast<int>(range.baseVertex);
+            command.baseInstance = static_cast<unsigned int>(level * capacity);
+            commands.push_back(command);
+        }
+    }
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+    unsigned int retestCount = 0;
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, retestBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, (capacity + 1) * sizeof(unsigned int), nullptr, GL_DYNAMIC_COPY);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(unsigned int), &retestCount);
+    // the slot's last frame was never read if its fence is still there
+    statsSlot = (statsSlot + 1) % STATS_RING;
+    if (statsFences[statsSlot]) {
+        glDeleteSync(statsFences[statsSlot]);
+        statsFences[statsSlot] = nullptr;
+    }
+    Stats stats = {};
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffers[statsSlot]);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(Stats), &stats, GL_STREAM_READ);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+    CullData data;
+    for (int i = 0; i < 6; i++)
+        data.planes[i] = frustum.Plane(i);
+    data.boundsCenter = glm::vec4(model->Bounds().Center(), 0.0f);
+    data.boundsExtents = glm::vec4(model->Bounds().Extents(), 0.0f);
+    for (unsigned int level = 0; level < MeshSimplifier::MAX_LODS; level++)
+        data.lodErrors[level] = glm::vec4(level < model->LodCount() ? model->LodError(level) : 0.0f);
+    data.instanceCount = static_cast<unsigned int>(instanceCount);
+    data.lodCount = lodCount;
+    data.meshCount = static_cast<unsigned int>(meshes.size());
+    data.capacity = static_cast<unsigned int>(capacity);
+    data.pixelsPerUnitAtOne = pixelsPerUnitAtOne;
+    data.threshold = threshold;
+    data.hysteresis = Model::LOD_HYSTERESIS;
+    data.padding = 0.0f;
+    glBindBuffer(GL_UNIFORM_BUFFER, cullDataBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(CullData), &data, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    occlusionTested = occluders != nullptr && occluders->IsBuilt();
+    if (instanceCount == 0 || meshes.empty()) {
+        occlusionTested = false;
+        fenceStats();
+        return;
+    }
+    bindBuffers();
+    bindOccluders(0, occlusionTested ? occluders : nullptr);
+    GLExtensions::DispatchCompute(static_cast<GLuint>((instanceCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE), 1, 1);
+    // the draws read the commands as indirect arguments and the lists as instanced attributes, Retest the retest
+    // list and ReadStats the stats through glGetBufferSubData
+    GLExtensions::MemoryBarriers(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT
+        | GL_BUFFER_UPDATE_BARRIER_BIT);
+    fenceStats();
+}
+
+void GpuCuller::Retest(const DepthPyramid& occluders) {
+    if (!occlusionTested || !occluders.IsBuilt())
+        return;
+    bindBuffers();
+    bindOccluders(1, &occluders);
+    // the retest count is only known on the GPU, so this covers every instance and the rest return at once
+    GLExtensions::DispatchCompute(static_cast<GLuint>((instanceCount + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE), 1, 1);
+    GLExtensions::MemoryBarriers(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+    fenceStats();
+}
+
+void GpuCuller::Submit(RenderQueue& queue, const DrawItem& material) {
+    if (instanceCount == 0 || commands.empty())
+        return;
+    DrawItem item = material;
+    item.vao = vao;
+    item.indexed = true;
+    item.drawCount = static_cast<GLsizei>(commands.size() / 2);
+    item.indirectBuffer = commandBuffer;
+    item.indirectOffset = 0;
+    queue.Submit(item);
+}
+
+void GpuCuller::SubmitLate(RenderQueue& queue, const DrawItem& material) {
+    if (instanceCount == 0 || commands.empty() || !occlusionTested)
+        return;
+    DrawItem item = material;
+    item.vao = vao;
+    item.indexed = true;
+    item.drawCount = static_cast<GLsizei>(commands.size() / 2);
+    item.indirectBuffer = commandBuffer;
+    item.indirectOffset = commands.size() / 2 * sizeof(DrawElementsIndirectCommand);
+    queue.Submit(item);
+}
+
+bool GpuCuller::ReadStats(Stats& stats) {
+    // newest first, older frames are dropped once a newer one has finished
+    bool found = false;
+    for (int i = 0; i < STATS_RING; i++) {
+        int slot = (statsSlot - i + STATS_RING) % STATS_RING;
+        if (!statsFences[slot])
+            continue;
+        if (!found) {
+            GLenum result = glClientWaitSync(statsFences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED)
+                continue;
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, statsBuffers[slot]);
+            glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(Stats), &stats);
+            glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+            found = true;
+        }
+        glDeleteSync(statsFences[slot]);
+        statsFences[slot] = nullptr;
+    }
+    return found;
+}
+
+void GpuCuller::Release() {
+    if (vao != 0)
+        GeometryPool::DeleteVertexArray(vao);
+    unsigned int buffers[] = { instanceBuffer, visibleBuffer, commandBuffer, levelBuffer, cullDataBuffer, retestBuffer };
+    if (instanceBuffer != 0) {
+        glDeleteBuffers(6, buffers);
+        glDeleteBuffers(STATS_RING, statsBuffers);
+    }
+    for (int slot = 0; slot < STATS_RING; slot++) {
+        if (statsFences[slot])
+            glDeleteSync(statsFences[slot]);
+        statsFences[slot] = nullptr;
+        statsBuffers[slot] = 0;
+    }
+    instanceBuffer = visibleBuffer = commandBuffer = levelBuffer = cullDataBuffer = retestBuffer = 0;
+    vao = 0;
+    capacity = instanceCount = 0;
+    occlusionTested = false;
+    commands.clear();
+}
+
+void GpuCuller::reserve(size_t count) {
+    capacity = count;
+    unsigned int lodCount = std::max(model->LodCount(), 1u);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, visibleBuffer);
+    // early and late lists
+    glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * lodCount * 2 * sizeof(InstanceData), nullptr, GL_DYNAMIC_COPY);
+    std::vector<unsigned int> levels(capacity, 0);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, levelBuffer);
+    glBufferData(GL_SHADER_STORAGE_BUFFER, capacity * sizeof(unsigned int), levels.data(), GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void GpuCuller::bindBuffers() {
+    glBindBufferBase(GL_UNIFORM_BUFFER, CULL_DATA_BINDING, cullDataBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, instanceBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, visibleBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, commandBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, levelBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, retestBuffer);
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, statsBuffers[statsSlot]);
+}
+
+void GpuCuller::bindOccluders(int phase, const DepthPyramid* occluders) {
+    program->Use();
+    program->SetInteger(phaseUniform, phase);
+    if (occluders) {
+        program->SetMatrix4(occlusionViewProjectionUniform, occluders->ViewProjection());
+        program->SetVector4f(pyramidUniform, glm::vec4(static_cast<float>(occluders->Width()), static_cast<float>(occluders->Height()),
+            static_cast<float>(occluders->Levels()), 1.0f));
+        RenderState::BindTexture2D(DepthPyramid::TEXTURE_UNIT, occluders->Texture());
+    }
+    else {
+        program->SetVector4f(pyramidUniform, glm::vec4(0.0f));
+    }
+}
+
+void GpuCuller::fenceStats() {
+    if (statsFences[statsSlot])
+        glDeleteSync(statsFences[statsSlot]);
+    statsFences[statsSlot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,114 @@
+#ifndef GPU_CULLER_H
+#define GPU_CULLER_H
+
+#include <vector>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "Frustum.h"
+#include "DepthPyramid.h"
+#include "../shader/Shader.h"
+#include "../model-loading/Model.h"
+#include "../rendering/DrawBatch.h"
+#include "../rendering/RenderQueue.h"
+
+// Culls and draws the instances of one model on the GPU. Cull uploads
+// the instances to a storage buffer and dispatches cull.comp, which runs
+// one invocation per instance: it tests the instance's box against the
+// frustum, picks its level of detail with the same hysteresis as
+// Model::SelectLod and appends it to the level's list, counting it with
+// an atomic add into the level's indirect draw commands. Submit then
+// draws every mesh and level in one glMultiDrawElementsIndirect, so the
+// CPU does no per-instance work besides the upload.
+//
+// Given a depth pyramid of the last frame, Cull also drops the instances
+// it hides, reprojected through that frame's matrices. They are not lost
+// yet: once the early lists are drawn and a new pyramid is built from
+// them, Retest tests them again and SubmitLate draws the ones that came
+// out from behind something. The counts of each frame are read back a
+// few frames later without waiting, through ReadStats.
+class GpuCuller {
+public:
+    // binding of the CullData block, FrameUniforms has 0
+    static const unsigned int CULL_DATA_BINDING = 1;
+    // local size of cull.comp
+    static const unsigned int WORKGROUP_SIZE = 64;
+    static const int STATS_RING = 3;
+
+    // the std430 Stats buffer of cull.comp
+    struct Stats {
+        unsigned int frustumCulled;
+        // hidden in both pyramids
+        unsigned int occluded;
+        // hidden in last frame's pyramid but not in this frame's
+        unsigned int disoccluded;
+        unsigned int drawn[MeshSimplifier::MAX_LODS];
+    };
+
+    GpuCuller();
+
+    // compute shaders and multi-draw indirect
+    static bool Supported() { return GLExtensions::ComputeShaders() && GLExtensions::MultiDrawIndirect(); }
+    // program is the linked cull.comp, model the instanced model whose meshes and levels are drawn
+    void Generate(Shader* program, const Model* model);
+    // uploads the instances and dispatches the culling against the frustum and, if given and built, the
+    // occluders of last frame. A model unit at distance 1 covers pixelsPerUnitAtOne pixels, and levels
+    // are picked to show at most threshold pixels of error
+    void Cull(const std::vector<InstanceData>& instances, const Frustum& frustum, float pixelsPerUnitAtOne, float threshold,
+        const DepthPyramid* occluders = nullptr);
+    // tests the instances the last Cull found occluded against occluders, built this frame
+    void Retest(const DepthPyramid& occluders);
+    // queues the instances that survived the last Cull as one item, material supplies everything but the geometry
+    void Submit(RenderQueue& queue, const DrawItem& material);
+    // the same for the instances that survived Retest
+    void SubmitLate(RenderQueue& queue, const DrawItem& material);
+    // the counts of the newest frame whose culling has finished, false if none has since the last call
+    bool ReadStats(Stats& stats);
+    void Release();
+private:
+    // std140 layout of the CullData block
+    struct CullData {
+        glm::vec4 planes[6];
+        glm::vec4 boundsCenter;
+        glm::vec4 boundsExtents;
+        glm::vec4 lodErrors[MeshSimplifier::MAX_LODS];
+        unsigned int instanceCount;
+        unsigned int lodCount;
+        unsigned int meshCount;
+        unsigned int capacity;
+        float pixelsPerUnitAtOne;
+        float threshold;
+        float hysteresis;
+        float padding;
+    };
+
+    Shader* program;
+    // cull.comp's plain uniforms, resolved in Generate
+    UniformHandle phaseUniform, occlusionViewProjectionUniform, pyramidUniform;
+    const Model* model;
+    // instances in, per level lists out, indirect commands, kept levels, the CullData block and the retest list
+    unsigned int instanceBuffer, visibleBuffer, commandBuffer, levelBuffer, cullDataBuffer, retestBuffer;
+    // a Stats buffer per frame in flight, fenced once the frame's last dispatch is queued
+    unsigned int statsBuffers[STATS_RING];
+    GLsync statsFences[STATS_RING];
+    int statsSlot;
+    // pool geometry plus visibleBuffer
+    unsigned int vao;
+    // instances the buffers hold, per level and phase for visibleBuffer
+    size_t capacity;
+    size_t instanceCount;
+    // whether the last Cull tested occlusion, so Retest has something to do
+    bool occlusionTested;
+    std::vector<DrawElementsIndirectCommand> commands;
+
+    // resizes the per-instance buffers to hold count instances, the kept levels restart at 0
+    void reserve(size_t count);
+    void bindBuffers();
+    // sets the occlusion uniforms and binds the pyramid, occluders may be null
+    void bindOccluders(int phase, const DepthPyramid* occluders);
+    // replaces the fence of the current stats slot
+    void fenceStats();
+};
+
+#endif
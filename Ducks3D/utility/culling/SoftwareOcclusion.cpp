@@ -0,0 +1,413 @@
+#include "SoftwareOcclusion.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <utility>
+
+#include "../transform/TransformStore.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define OCCLUSION_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+// MSVC accepts intrinsics of any instruction set without a per-function target
+#define OCCLUSION_AVX2_TARGET
+#else
+#define OCCLUSION_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+    // screen coordinates are clamped to this far outside the buffer before they are turned into pixels
+    const float GUARD_BAND = 1.0f;
+
+    int pixelFloor(float value, int size) {
+        return static_cast<int>(std::floor(std::min(std::max(value, -GUARD_BAND), size + GUARD_BAND)));
+    }
+
+    int pixelCeil(float value, int size) {
+        return static_cast<int>(std::ceil(std::min(std::max(value, -GUARD_BAND), size + GUARD_BAND)));
+    }
+
+    double millisecondsSince(std::chrono::high_resolution_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+    }
+
+    // a triangle's pixels [x0, x1] x [y0, y1] of a buffer with the given row length, all three edges not negative
+    // at the pixel center. The operations are grouped like the AVX2 kernel's, so both give the same bits
+    void rasterizeScalar(float* depth, int stride, const float edgeA[3], const float edgeB[3], const float edgeC[3],
+        float depthA, float depthB, float depthC, int x0, int x1, int y0, int y1) {
+        for (int y = y0; y <= y1; y++) {
+            float py = y + 0.5f;
+            float* row = depth + static_cast<size_t>(y) * stride;
+            for (int x = x0; x <= x1; x++) {
+                float px = x + 0.5f;
+                float e0 = (edgeA[0] * px + edgeB[0] * py) + edgeC[0];
+                float e1 = (edgeA[1] * px + edgeB[1] * py) + edgeC[1];
+                float e2 = (edgeA[2] * px + edgeB[2] * py) + edgeC[2];
+                if (e0 < 0.0f || e1 < 0.0f || e2 < 0.0f)
+                    continue;
+                float z = (depthA * px + depthB * py) + depthC;
+                if (z < row[x])
+                    row[x] = z;
+            }
+        }
+    }
+
+    // true if any pixel of [x0, x1] x [y0, y1] is at least as far as nearest
+    bool anyBehindScalar(const float* depth, int stride, float nearest, int x0, int x1, int y0, int y1) {
+        for (int y = y0; y <= y1; y++) {
+            const float* row = depth + static_cast<size_t>(y) * stride;
+            for (int x = x0; x <= x1; x++) {
+                if (row[x] >= nearest)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    // pixels [x0, x1] x [y0, y1] of target take the farthest of the 3x3 source pixels around them. source has an
+    // empty border of one pixel around the buffer, nothing is known about what is drawn past the edges
+    void erodeScalar(const float* source, int sourceStride, float* target, int targetStride, int x0, int x1, int y0, int y1) {
+        for (int y = y0; y <= y1; y++) {
+            const float* above = source + static_cast<size_t>(y - 1) * sourceStride;
+            const float* row = above + sourceStride;
+            const float* below = row + sourceStride;
+            float* out = target + static_cast<size_t>(y) * targetStride;
+            for (int x = x0; x <= x1; x++) {
+                float farthest = std::max(std::max(above[x - 1], above[x]), above[x + 1]);
+                farthest = std::max(farthest, std::max(std::max(row[x - 1], row[x]), row[x + 1]));
+                farthest = std::max(farthest, std::max(std::max(below[x - 1], below[x]), below[x + 1]));
+                out[x] = farthest;
+            }
+        }
+    }
+
+#ifdef OCCLUSION_X86
+    // eight pixels per step, starting at the group of eight holding x0. Lanes outside [x0, x1] are masked off
+    OCCLUSION_AVX2_TARGET
+    void rasterizeAvx2(float* depth, int stride, const float edgeA[3], const float edgeB[3], const float edgeC[3],
+        float depthA, float depthB, float depthC, int x0, int x1, int y0, int y1) {
+        const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        const __m256 half = _mm256_set1_ps(0.5f);
+        const __m256 zero = _mm256_setzero_ps();
+        __m256 a[3], b[3], c[3];
+        for (int i = 0; i < 3; i++) {
+            a[i] = _mm256_set1_ps(edgeA[i]);
+            b[i] = _mm256_set1_ps(edgeB[i]);
+            c[i] = _mm256_set1_ps(edgeC[i]);
+        }
+        __m256 za = _mm256_set1_ps(depthA), zb = _mm256_set1_ps(depthB), zc = _mm256_set1_ps(depthC);
+        __m256i first = _mm256_set1_epi32(x0 - 1), last = _mm256_set1_epi32(x1 + 1);
+        int groupStart = x0 & ~7;
+        for (int y = y0; y <= y1; y++) {
+            __m256 py = _mm256_set1_ps(y + 0.5f);
+            __m256 byRow[3], zRow = _mm256_mul_ps(zb, py);
+            for (int i = 0; i < 3; i++)
+                byRow[i] = _mm256_mul_ps(b[i], py);
+            float* row = depth + static_cast<size_t>(y) * stride;
+            for (int x = groupStart; x <= x1; x += 8) {
+                __m256i lanes = _mm256_add_epi32(_mm256_set1_epi32(x), laneOffsets);
+                __m256 px = _mm256_add_ps(_mm256_cvtepi32_ps(lanes), half);
+                __m256 inRange = _mm256_castsi256_ps(_mm256_and_si256(_mm256_cmpgt_epi32(lanes, first), _mm256_cmpgt_epi32(last, lanes)));
+                __m256 e0 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[0], px), byRow[0]), c[0]);
+                __m256 e1 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[1], px), byRow[1]), c[1]);
+                __m256 e2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a[2], px), byRow[2]), c[2]);
+                __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ), _mm256_cmp_ps(e1, zero, _CMP_GE_OQ)),
+                    _mm256_and_ps(_mm256_cmp_ps(e2, zero, _CMP_GE_OQ), inRange));
+                if (_mm256_movemask_ps(inside) == 0)
+                    continue;
+                __m256 z = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(za, px), zRow), zc);
+                __m256 current = _mm256_loadu_ps(row + x);
+                __m256 nearer = _mm256_and_ps(inside, _mm256_cmp_ps(z, current, _CMP_LT_OQ));
+                _mm256_storeu_ps(row + x, _mm256_blendv_ps(current, z, nearer));
+            }
+        }
+    }
+
+    OCCLUSION_AVX2_TARGET
+    bool anyBehindAvx2(const float* depth, int stride, float nearest, int x0, int x1, int y0, int y1) {
+        const __m256i laneOffsets = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+        __m256 near8 = _mm256_set1_ps(nearest);
+        __m256i first = _mm256_set1_epi32(x0 - 1), last = _mm256_set1_epi32(x1 + 1);
+        int groupStart = x0 & ~7;
+        for (int y = y0; y <= y1; y++) {
+            const float* row = depth + static_cast<size_t>(y) * stride;
+            for (int x = groupStart; x <= x1; x += 8) {
+                __m256i lanes = _mm256_add_epi32(_mm256_set1_epi32(x), laneOffsets);
+                __m256 inRange = _mm256_castsi256_ps(_mm256_and_si256(_mm256_cmpgt_epi32(lanes, first), _mm256_cmpgt_epi32(last, lanes)));
+                __m256 behind = _mm256_and_ps(_mm256_cmp_ps(_mm256_loadu_ps(row + x), near8, _CMP_GE_OQ), inRange);
+                if (_mm256_movemask_ps(behind) != 0)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    // x0 and the width of [x0, x1] are multiples of eight
+    OCCLUSION_AVX2_TARGET
+    void erodeAvx2(const float* source, int sourceStride, float* target, int targetStride, int x0, int x1, int y0, int y1) {
+        for (int y = y0; y <= y1; y++) {
+            const float* above = source + static_cast<size_t>(y - 1) * sourceStride;
+            const float* row = above + sourceStride;
+            const float* below = row + sourceStride;
+            float* out = target + static_cast<size_t>(y) * targetStride;
+            for (int x = x0; x <= x1; x += 8) {
+                __m256 farthest = _mm256_max_ps(_mm256_max_ps(_mm256_loadu_ps(above + x - 1), _mm256_loadu_ps(above + x)), _mm256_loadu_ps(above + x + 1));
+                farthest = _mm256_max_ps(farthest, _mm256_max_ps(_mm256_max_ps(_mm256_loadu_ps(row + x - 1), _mm256_loadu_ps(row + x)), _mm256_loadu_ps(row + x + 1)));
+                farthest = _mm256_max_ps(farthest, _mm256_max_ps(_mm256_max_ps(_mm256_loadu_ps(below + x - 1), _mm256_loadu_ps(below + x)), _mm256_loadu_ps(below + x + 1)));
+                _mm256_storeu_ps(out + x, farthest);
+            }
+        }
+    }
+#endif
+}
+
+SoftwareOcclusion::SoftwareOcclusion(int width, int height)
+    : kernel(TransformStore::BestIsa() == TransformStore::ISA_AVX2 ? KERNEL_AVX2 : KERNEL_SCALAR),
+    triangleBudget(DEFAULT_TRIANGLE_BUDGET), viewProjection(1.0f), budgetUsed(0), stats() {
+    tilesX = std::max(1, (width + TILE_WIDTH - 1) / TILE_WIDTH);
+    tilesY = std::max(1, (height + TILE_HEIGHT - 1) / TILE_HEIGHT);
+    this->width = tilesX * TILE_WIDTH;
+    this->height = tilesY * TILE_HEIGHT;
+    bins.resize(static_cast<size_t>(tilesX) * tilesY);
+    // nothing is occluded before the first Render
+    depth.assign(static_cast<size_t>(this->width) * this->height, 1.0f);
+    rasterStride = this->width + 2;
+    rasterDepth.assign(static_cast<size_t>(rasterStride) * (this->height + 2), 1.0f);
+    tileFarthest.assign(bins.size(), 1.0f);
+}
+
+int SoftwareOcclusion::AddMesh(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices) {
+    OccluderMesh mesh;
+    mesh.positions = positions;
+    mesh.indices = indices;
+    meshes.push_back(std::move(mesh));
+    return static_cast<int>(meshes.size()) - 1;
+}
+
+void SoftwareOcclusion::Begin(const glm::mat4& viewProjection) {
+    this->viewProjection = viewProjection;
+    occluders.clear();
+    budgetUsed = 0;
+    stats = Stats();
+}
+
+bool SoftwareOcclusion::AddOccluder(int mesh, const glm::mat4& model) {
+    size_t count = meshes[mesh].indices.size() / 3;
+    if (budgetUsed + count > triangleBudget) {
+        stats.occludersSkipped++;
+        return false;
+    }
+    Occluder occluder;
+    occluder.mesh = mesh;
+    occluder.model = model;
+    occluder.firstTriangle = budgetUsed * 2;
+    occluders.push_back(occluder);
+    budgetUsed += count;
+    stats.occluders++;
+    stats.triangles += count;
+    return true;
+}
+
+void SoftwareOcclusion::Render(JobSystem& jobs) {
+    auto setupStart = std::chrono::high_resolution_clock::now();
+    triangles.resize(budgetUsed * 2);
+    triangleCounts.assign(occluders.size(), 0);
+    jobs.ParallelFor(occluders.size(), 1, [this](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+            triangleCounts[i] = setupOccluder(occluders[i], &triangles[occluders[i].firstTriangle]);
+    });
+    stats.setupMs = millisecondsSince(setupStart);
+
+    // in submission order, so every tile sees its triangles in the same order on any thread count
+    auto binStart = std::chrono::high_resolution_clock::now();
+    for (std::vector<unsigned int>& bin : bins)
+        bin.clear();
+    for (size_t i = 0; i < occluders.size(); i++) {
+        for (size_t t = 0; t < triangleCounts[i]; t++) {
+            unsigned int index = static_cast<unsigned int>(occluders[i].firstTriangle + t);
+            const Triangle& triangle = triangles[index];
+            for (int ty = triangle.minY / TILE_HEIGHT; ty <= triangle.maxY / TILE_HEIGHT; ty++) {
+                for (int tx = triangle.minX / TILE_WIDTH; tx <= triangle.maxX / TILE_WIDTH; tx++)
+                    bins[ty * tilesX + tx].push_back(index);
+            }
+            stats.binnedTriangles += (triangle.maxY / TILE_HEIGHT - triangle.minY / TILE_HEIGHT + 1)
+                * (triangle.maxX / TILE_WIDTH - triangle.minX / TILE_WIDTH + 1);
+        }
+        stats.trianglesRasterized += triangleCounts[i];
+    }
+    stats.binMs = millisecondsSince(binStart);
+
+    auto rasterStart = std::chrono::high_resolution_clock::now();
+    jobs.ParallelFor(bins.size(), 1, [this](size_t begin, size_t end) {
+        for (size_t tile = begin; tile < end; tile++)
+            rasterizeTile(static_cast<int>(tile));
+    });
+    // reads the neighbouring tiles, so only once all of them are rasterized
+    jobs.ParallelFor(bins.size(), 1, [this](size_t begin, size_t end) {
+        for (size_t tile = begin; tile < end; tile++)
+            erodeTile(static_cast<int>(tile));
+    });
+    stats.rasterMs = millisecondsSince(rasterStart);
+}
+
+bool SoftwareOcclusion::IsOccluded(const AABB& box) const {
+    glm::vec3 ndcMin, ndcMax;
+    if (!box.Project(viewProjection, ndcMin, ndcMax))
+        return false;
+    if (ndcMax.x < -1.0f || ndcMin.x > 1.0f || ndcMax.y < -1.0f || ndcMin.y > 1.0f)
+        return false;
+    float nearest = ndcMin.z * 0.5f + 0.5f;
+
+    // every pixel the rectangle touches, not only those whose centers it covers
+    int x0 = std::max(pixelFloor((ndcMin.x * 0.5f + 0.5f) * width, width), 0);
+    int x1 = std::min(pixelFloor((ndcMax.x * 0.5f + 0.5f) * width, width), width - 1);
+    int y0 = std::max(pixelFloor((ndcMin.y * 0.5f + 0.5f) * height, height), 0);
+    int y1 = std::min(pixelFloor((ndcMax.y * 0.5f + 0.5f) * height, height), height - 1);
+    for (int ty = y0 / TILE_HEIGHT; ty <= y1 / TILE_HEIGHT; ty++) {
+        for (int tx = x0 / TILE_WIDTH; tx <= x1 / TILE_WIDTH; tx++) {
+            // the whole tile is nearer than the box
+            if (nearest > tileFarthest[ty * tilesX + tx])
+                continue;
+            int px0 = std::max(x0, tx * TILE_WIDTH), px1 = std::min(x1, (tx + 1) * TILE_WIDTH - 1);
+            int py0 = std::max(y0, ty * TILE_HEIGHT), py1 = std::min(y1, (ty + 1) * TILE_HEIGHT - 1);
+#ifdef OCCLUSION_X86
+            if (kernel == KERNEL_AVX2 ? anyBehindAvx2(depth.data(), width, nearest, px0, px1, py0, py1)
+                : anyBehindScalar(depth.data(), width, nearest, px0, px1, py0, py1))
+                return false;
+#else
+            if (anyBehindScalar(depth.data(), width, nearest, px0, px1, py0, py1))
+                return false;
+#endif
+        }
+    }
+    return true;
+}
+
+const char* SoftwareOcclusion::KernelName(Kernel kernel) {
+    return kernel == KERNEL_AVX2 ? "avx2" : "scalar";
+}
+
+size_t SoftwareOcclusion::setupOccluder(const Occluder& occluder, Triangle* out) const {
+    const OccluderMesh& mesh = meshes[occluder.mesh];
+    glm::mat4 modelViewProjection = viewProjection * occluder.model;
+    std::vector<glm::vec4> clip(mesh.positions.size());
+    for (size_t i = 0; i < mesh.positions.size(); i++)
+        clip[i] = modelViewProjection * glm::vec4(mesh.positions[i], 1.0f);
+
+    size_t count = 0;
+    for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+        glm::vec4 corners[3] = { clip[mesh.indices[i]], clip[mesh.indices[i + 1]], clip[mesh.indices[i + 2]] };
+        // signed distances to the near plane, z = -w
+        float distances[3];
+        int inside = 0;
+        for (int k = 0; k < 3; k++) {
+            distances[k] = corners[k].z + corners[k].w;
+            inside += distances[k] >= 0.0f ? 1 : 0;
+        }
+        if (inside == 0)
+            continue;
+        if (inside == 3) {
+            count += setupTriangle(corners[0], corners[1], corners[2], out[count]) ? 1 : 0;
+            continue;
+        }
+        // clipped at the near plane into a triangle or a quad, fanned into at most two triangles
+        glm::vec4 polygon[4];
+        int size = 0;
+        for (int k = 0; k < 3; k++) {
+            int next = (k + 1) % 3;
+            if (distances[k] >= 0.0f)
+                polygon[size++] = corners[k];
+            if ((distances[k] >= 0.0f) != (distances[next] >= 0.0f)) {
+                float t = distances[k] / (distances[k] - distances[next]);
+                polygon[size++] = corners[k] + (corners[next] - corners[k]) * t;
+            }
+        }
+        for (int k = 1; k + 1 < size; k++)
+            count += setupTriangle(polygon[0], polygon[k], polygon[k + 1], out[count]) ? 1 : 0;
+    }
+    return count;
+}
+
+bool SoftwareOcclusion::setupTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, Triangle& triangle) const {
+    const glm::vec4* corners[3] = { &a, &b, &c };
+    float x[3], y[3], z[3];
+    for (int k = 0; k < 3; k++) {
+        const glm::vec4& corner = *corners[k];
+        if (corner.w <= AABB::MIN_CLIP_W)
+            return false;
+        x[k] = (corner.x / corner.w * 0.5f + 0.5f) * width;
+        y[k] = (corner.y / corner.w * 0.5f + 0.5f) * height;
+        z[k] = corner.z / corner.w * 0.5f + 0.5f;
+    }
+    // counter-clockwise on screen is front facing, as for GL
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (!(area > 0.0f))
+        return false;
+
+    // pixels whose centers lie within the bounds
+    triangle.minX = std::max(pixelCeil(std::min(std::min(x[0], x[1]), x[2]) - 0.5f, width), 0);
+    triangle.maxX = std::min(pixelFloor(std::max(std::max(x[0], x[1]), x[2]) - 0.5f, width), width - 1);
+    triangle.minY = std::max(pixelCeil(std::min(std::min(y[0], y[1]), y[2]) - 0.5f, height), 0);
+    triangle.maxY = std::min(pixelFloor(std::max(std::max(y[0], y[1]), y[2]) - 0.5f, height), height - 1);
+    if (triangle.minX > triangle.maxX || triangle.minY > triangle.maxY)
+        return false;
+
+    for (int k = 0; k < 3; k++) {
+        int next = (k + 1) % 3;
+        triangle.edgeA[k] = y[k] - y[next];
+        triangle.edgeB[k] = x[next] - x[k];
+        triangle.edgeC[k] = -(triangle.edgeA[k] * x[k] + triangle.edgeB[k] * y[k]);
+    }
+    triangle.depthA = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+    triangle.depthB = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+    triangle.depthC = z[0] - triangle.depthA * x[0] - triangle.depthB * y[0];
+    return true;
+}
+
+void SoftwareOcclusion::rasterizeTile(int tile) {
+    int tx = tile % tilesX, ty = tile / tilesX;
+    int tileX0 = tx * TILE_WIDTH, tileX1 = tileX0 + TILE_WIDTH - 1;
+    int tileY0 = ty * TILE_HEIGHT, tileY1 = tileY0 + TILE_HEIGHT - 1;
+    float* raster = rasterOrigin();
+    for (int y = tileY0; y <= tileY1; y++)
+        std::fill(raster + static_cast<size_t>(y) * rasterStride + tileX0, raster + static_cast<size_t>(y) * rasterStride + tileX1 + 1, 1.0f);
+
+    for (unsigned int index : bins[tile]) {
+        const Triangle& triangle = triangles[index];
+        int x0 = std::max(triangle.minX, tileX0), x1 = std::min(triangle.maxX, tileX1);
+        int y0 = std::max(triangle.minY, tileY0), y1 = std::min(triangle.maxY, tileY1);
+#ifdef OCCLUSION_X86
+        if (kernel == KERNEL_AVX2) {
+            rasterizeAvx2(raster, rasterStride, triangle.edgeA, triangle.edgeB, triangle.edgeC,
+                triangle.depthA, triangle.depthB, triangle.depthC, x0, x1, y0, y1);
+            continue;
+        }
+#endif
+        rasterizeScalar(raster, rasterStride, triangle.edgeA, triangle.edgeB, triangle.edgeC,
+            triangle.depthA, triangle.depthB, triangle.depthC, x0, x1, y0, y1);
+    }
+}
+
+void SoftwareOcclusion::erodeTile(int tile) {
+    int tx = tile % tilesX, ty = tile / tilesX;
+    int tileX0 = tx * TILE_WIDTH, tileX1 = tileX0 + TILE_WIDTH - 1;
+    int tileY0 = ty * TILE_HEIGHT, tileY1 = tileY0 + TILE_HEIGHT - 1;
+#ifdef OCCLUSION_X86
+    if (kernel == KERNEL_AVX2)
+        erodeAvx2(rasterOrigin(), rasterStride, depth.data(), width, tileX0, tileX1, tileY0, tileY1);
+    else
+        erodeScalar(rasterOrigin(), rasterStride, depth.data(), width, tileX0, tileX1, tileY0, tileY1);
+#else
+    erodeScalar(rasterOrigin(), rasterStride, depth.data(), width, tileX0, tileX1, tileY0, tileY1);
+#endif
+
+    float farthest = 0.0f;
+    for (int y = tileY0; y <= tileY1; y++) {
+        const float* row = depth.data() + static_cast<size_t>(y) * width;
+        farthest = std::max(farthest, *std::max_element(row + tileX0, row + tileX1 + 1));
+    }
+    tileFarthest[tile] = farthest;
+}
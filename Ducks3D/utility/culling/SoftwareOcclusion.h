@@ -0,0 +1,143 @@
+#ifndef SOFTWARE_OCCLUSION_H
+#define SOFTWARE_OCCLUSION_H
+
+#include <vector>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+#include "Bounds.h"
+#include "../jobs/JobSystem.h"
+
+// Occlusion culling without the GPU: a few designated occluder meshes
+// (terrain, large props) are rasterized on the CPU into a small depth
+// buffer of the current frame, and boxes are tested against it before
+// anything is submitted to GL. Render transforms and sets up the
+// occluder triangles on the job system, clipping them at the near plane
+// and dropping the back facing ones, bins them into screen tiles and
+// then rasterizes every tile as a job of its own, so no two threads
+// write the same pixels. The rasterizer and the box test cover eight
+// pixels at a time with AVX2 where the CPU has it and fall back to
+// scalar code that gives the same results otherwise.
+//
+// Triangles are rasterized at pixel centers, which says nothing about
+// the rest of the pixel, so the depth buffer keeps per pixel the
+// farthest of the 3x3 rasterized pixels around it: a pixel only counts
+// as covered if its neighbours are covered too. This gives up the
+// partly covered pixels at the occluder edges, so boxes peeking out
+// past them are not culled; only gaps and corners narrower than a
+// pixel can still hide a visible box. Every tile also keeps the
+// farthest of its pixels. A box is occluded if its nearest depth lies
+// behind every pixel its screen rectangle touches; most tiles answer
+// that with their farthest depth alone. Occluders are only rasterized
+// within a triangle budget, the ones submitted after it is spent are
+// skipped and counted.
+class SoftwareOcclusion {
+public:
+    enum Kernel {
+        KERNEL_SCALAR,
+        KERNEL_AVX2
+    };
+
+    // tiles are rasterized as one job each, TILE_WIDTH is a multiple of the eight AVX2 lanes
+    static const int TILE_WIDTH = 32;
+    static const int TILE_HEIGHT = 16;
+    static const int DEFAULT_WIDTH = 256;
+    static const int DEFAULT_HEIGHT = 192;
+    static const size_t DEFAULT_TRIANGLE_BUDGET = 4096;
+
+    // the work of the last Render
+    struct Stats {
+        // occluder instances rasterized and skipped for the budget
+        size_t occluders;
+        size_t occludersSkipped;
+        // triangles submitted, left after culling and clipping, and their entries in the tile bins
+        size_t triangles;
+        size_t trianglesRasterized;
+        size_t binnedTriangles;
+        // milliseconds spent in transform and setup, binning, and rasterization
+        double setupMs;
+        double binMs;
+        double rasterMs;
+    };
+
+    // the size is rounded up to whole tiles
+    explicit SoftwareOcclusion(int width = DEFAULT_WIDTH, int height = DEFAULT_HEIGHT);
+
+    // registers occluder geometry, a triangle list in model space. Returns its id for AddOccluder
+    int AddMesh(const std::vector<glm::vec3>& positions, const std::vector<unsigned int>& indices);
+    // triangles that may be submitted per frame, counted before culling
+    void SetTriangleBudget(size_t triangles) { triangleBudget = triangles; }
+    size_t TriangleBudget() const { return triangleBudget; }
+
+    // starts a frame seen through viewProjection, dropping the last frame's occluders
+    void Begin(const glm::mat4& viewProjection);
+    // queues an instance of mesh, false if it doesn't fit in what is left of the budget and is skipped
+    bool AddOccluder(int mesh, const glm::mat4& model);
+    // rasterizes the queued occluders on the jobs
+    void Render(JobSystem& jobs);
+    // true if box is hidden behind the occluders of the last Render. Safe to call from several threads
+    bool IsOccluded(const AABB& box) const;
+
+    const Stats& GetStats() const { return stats; }
+    // the kernel is picked from the CPU at construction, scalar can be forced for comparisons
+    void SetKernel(Kernel kernel) { this->kernel = kernel; }
+    Kernel GetKernel() const { return kernel; }
+    static const char* KernelName(Kernel kernel);
+    int Width() const { return width; }
+    int Height() const { return height; }
+    // depth per pixel the occluders cover all of, rows bottom up, 1 where they don't
+    const std::vector<float>& Depth() const { return depth; }
+private:
+    struct OccluderMesh {
+        std::vector<glm::vec3> positions;
+        std::vector<unsigned int> indices;
+    };
+
+    struct Occluder {
+        int mesh;
+        glm::mat4 model;
+        // where its triangles go in triangles, two slots per submitted triangle since clipping can split one
+        size_t firstTriangle;
+    };
+
+    // a screen space triangle ready for rasterization: three edge functions A * x + B * y + C that are
+    // not negative inside, its depth plane and the pixels its bounds cover
+    struct Triangle {
+        float edgeA[3], edgeB[3], edgeC[3];
+        float depthA, depthB, depthC;
+        int minX, minY, maxX, maxY;
+    };
+
+    int width, height;
+    int tilesX, tilesY;
+    Kernel kernel;
+    size_t triangleBudget;
+    glm::mat4 viewProjection;
+
+    std::vector<OccluderMesh> meshes;
+    std::vector<Occluder> occluders;
+    size_t budgetUsed;
+    // setup output, with the number of triangles each occluder produced
+    std::vector<Triangle> triangles;
+    std::vector<size_t> triangleCounts;
+    // triangles overlapping each tile, in submission order
+    std::vector<std::vector<unsigned int>> bins;
+    // rasterized depth with a border of one pixel that stays 1, rows rasterStride apart
+    std::vector<float> rasterDepth;
+    int rasterStride;
+    std::vector<float> depth;
+    std::vector<float> tileFarthest;
+    Stats stats;
+
+    // clips, culls and sets up the triangles of one occluder, returns how many it wrote
+    size_t setupOccluder(const Occluder& occluder, Triangle* out) const;
+    // sets up one clip space triangle, false if it is back facing or covers no pixel center
+    bool setupTriangle(const glm::vec4& a, const glm::vec4& b, const glm::vec4& c, Triangle& triangle) const;
+    void rasterizeTile(int tile);
+    // fills the tile's pixels of depth from rasterDepth and its farthest depth
+    void erodeTile(int tile);
+    float* rasterOrigin() { return rasterDepth.data() + rasterStride + 1; }
+};
+
+#endif
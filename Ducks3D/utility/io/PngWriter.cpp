@@ -0,0 +1,99 @@
+#include "PngWriter.h"
+
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+namespace {
+    uint32_t crcTable[256];
+    bool crcTableReady = false;
+
+    uint32_t crc32(const unsigned char* data, size_t length, uint32_t crc = 0) {
+        if (!crcTableReady) {
+            for (uint32_t n = 0; n < 256; n++) {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                crcTable[n] = c;
+            }
+            crcTableReady = true;
+        }
+        crc = ~crc;
+        for (size_t i = 0; i < length; i++)
+            crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    void putU32(std::vector<unsigned char>& out, uint32_t value) {
+        out.push_back(static_cast<unsigned char>(value >> 24));
+        out.push_back(static_cast<unsigned char>(value >> 16));
+        out.push_back(static_cast<unsigned char>(value >> 8));
+        out.push_back(static_cast<unsigned char>(value));
+    }
+
+    void writeChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data) {
+        std::vector<unsigned char> chunk;
+        chunk.reserve(data.size() + 12);
+        putU32(chunk, static_cast<uint32_t>(data.size()));
+        chunk.insert(chunk.end(), type, type + 4);
+        chunk.insert(chunk.end(), data.begin(), data.end());
+        putU32(chunk, crc32(chunk.data() + 4, data.size() + 4));
+        file.write(reinterpret_cast<const char*>(chunk.data()), chunk.size());
+    }
+}
+
+bool PngWriter::WriteRGBA(const std::string& path, unsigned int width, unsigned int height, const unsigned char* pixels, bool flipRows) {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+
+    // scanlines, each prefixed with filter type 0 (none)
+    size_t stride = static_cast<size_t>(width) * 4;
+    std::vector<unsigned char> raw;
+    raw.reserve((stride + 1) * height);
+    for (unsigned int y = 0; y < height; y++) {
+        const unsigned char* row = pixels + (flipRows ? height - 1 - y : y) * stride;
+        raw.push_back(0);
+        raw.insert(raw.end(), row, row + stride);
+    }
+
+    // zlib stream made of stored deflate blocks of at most 65535 bytes
+    std::vector<unsigned char> idat;
+    idat.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    idat.push_back(0x78);
+    idat.push_back(0x01);
+    uint32_t adlerA = 1, adlerB = 0;
+    size_t offset = 0;
+    do {
+        size_t length = raw.size() - offset < 65535 ? raw.size() - offset : 65535;
+        bool last = offset + length == raw.size();
+        idat.push_back(last ? 1 : 0);
+        idat.push_back(static_cast<unsigned char>(length));
+        idat.push_back(static_cast<unsigned char>(length >> 8));
+        idat.push_back(static_cast<unsigned char>(~length));
+        idat.push_back(static_cast<unsigned char>(~length >> 8));
+        for (size_t i = offset; i < offset + length; i++) {
+            adlerA = (adlerA + raw[i]) % 65521;
+            adlerB = (adlerB + adlerA) % 65521;
+        }
+        idat.insert(idat.end(), raw.begin() + offset, raw.begin() + offset + length);
+        offset += length;
+    } while (offset < raw.size());
+    putU32(idat, (adlerB << 16) | adlerA);
+
+    std::vector<unsigned char> header;
+    putU32(header, width);
+    putU32(header, height);
+    header.push_back(8);    // bit depth
+    header.push_back(6);    // color type RGBA
+    header.push_back(0);    // compression
+    header.push_back(0);    // filter
+    header.push_back(0);    // interlace
+
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    file.write(reinterpret_cast<const char*>(signature), sizeof(signature));
+    writeChunk(file, "IHDR", header);
+    writeChunk(file, "IDAT", idat);
+    writeChunk(file, "IEND", std::vector<unsigned char>());
+    return static_cast<bool>(file);
+}
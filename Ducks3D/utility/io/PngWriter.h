@@ -0,0 +1,17 @@
+#ifndef PNG_WRITER_H
+#define PNG_WRITER_H
+
+#include <string>
+
+// Minimal PNG encoder for frame dumps. Pixel data is stored in
+// uncompressed deflate blocks, which keeps the encoder tiny at the cost
+// of file size.
+class PngWriter {
+public:
+    // writes 8-bit RGBA pixels, rows are read bottom-up when flipRows is set (the glReadPixels order)
+    static bool WriteRGBA(const std::string& path, unsigned int width, unsigned int height, const unsigned char* pixels, bool flipRows);
+private:
+    PngWriter() {}
+};
+
+#endif
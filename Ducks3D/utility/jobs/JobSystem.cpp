@@ -0,0 +1,201 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+namespace {
+    // index of the calling thread in the system it works for, threads
+    // outside of it queue their jobs on worker 0
+    thread_local const JobSystem* workerOwner = nullptr;
+    thread_local unsigned int workerIndex = 0;
+
+    // ranges per thread ParallelFor aims for, so a thread that falls behind can be helped out
+    const size_t RANGES_PER_THREAD = 4;
+}
+
+JobSystem::JobSystem()
+    : queued(0), sleeping(0), executed(0), stolen(0), stopping(false) {
+}
+
+JobSystem::~JobSystem() {
+    Release();
+}
+
+void JobSystem::Start(unsigned int threadCount) {
+    if (!queues.empty())
+        return;
+    if (threadCount == 0)
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned int i = 0; i < threadCount; i++)
+        queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue()));
+    workerOwner = this;
+    workerIndex = 0;
+    stopping = false;
+    for (unsigned int i = 1; i < threadCount; i++)
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+}
+
+void JobSystem::Run(std::function<void()> task, JobCounter* counter) {
+    if (counter)
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+    push({ std::move(task), counter });
+}
+
+void JobSystem::RunAfter(JobCounter& dependency, std::function<void()> task, JobCounter* counter) {
+    if (counter)
+        counter->pending.fetch_add(1, std::memory_order_relaxed);
+    {
+        // finish only decrements under this lock, so a continuation added while pending
+        // is still above zero is always picked up
+        std::lock_guard<std::mutex> lock(dependency.mutex);
+        if (dependency.pending.load(std::memory_order_acquire) > 0) {
+            dependency.continuations.push_back({ std::move(task), counter });
+            return;
+        }
+    }
+    push({ std::move(task), counter });
+}
+
+void JobSystem::ParallelFor(size_t count, size_t grain, std::function<void(size_t begin, size_t end)> body, JobCounter& counter) {
+    if (count == 0)
+        return;
+    size_t ranges = std::max<size_t>(1, std::min((count + grain - 1) / std::max<size_t>(grain, 1), ThreadCount() * RANGES_PER_THREAD));
+    size_t size = (count + ranges - 1) / ranges;
+    auto shared = std::make_shared<std::function<void(size_t, size_t)>>(std::move(body));
+    for (size_t begin = 0; begin < count; begin += size) {
+        size_t end = std::min(count, begin + size);
+        Run([shared, begin, end]() { (*shared)(begin, end); }, &counter);
+    }
+}
+
+void JobSystem::ParallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body) {
+    if (queues.size() <= 1 || count <= grain) {
+        body(0, count);
+        return;
+    }
+    JobCounter counter;
+    // body outlives the jobs here, so they can refer to it instead of sharing a copy
+    ParallelFor(count, grain, [&body](size_t begin, size_t end) { body(begin, end); }, counter);
+    Wait(counter);
+}
+
+void JobSystem::Wait(JobCounter& counter) {
+    unsigned int worker = currentWorker();
+    while (!counter.Done()) {
+        Job job;
+        if (pop(worker, job))
+            execute(job);
+        else
+            std::this_thread::yield();
+    }
+    // the last job may still hold the lock it drained the counter under, let it go before
+    // the caller gets to destroy the counter
+    std::lock_guard<std::mutex> lock(counter.mutex);
+}
+
+void JobSystem::ResetCounters() {
+    executed.store(0, std::memory_order_relaxed);
+    stolen.store(0, std::memory_order_relaxed);
+}
+
+void JobSystem::Release() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+    workers.clear();
+    queues.clear();
+    queued.store(0);
+    if (workerOwner == this)
+        workerOwner = nullptr;
+}
+
+void JobSystem::push(Job job) {
+    if (queues.empty()) {
+        // not started, run inline so the system still works single threaded
+        execute(job);
+        return;
+    }
+    WorkQueue& queue = *queues[currentWorker()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back(std::move(job));
+    }
+    // pairs with the sleeping/queued check in workerLoop, one of the two sides always sees the other
+    queued.fetch_add(1);
+    if (sleeping.load() > 0) {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        jobReady.notify_one();
+    }
+}
+
+bool JobSystem::pop(unsigned int worker, Job& job) {
+    {
+        WorkQueue& own = *queues[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.jobs.empty()) {
+            job = std::move(own.jobs.back());
+            own.jobs.pop_back();
+            queued.fetch_sub(1);
+            return true;
+        }
+    }
+    // steal the oldest job of the next thread that has one
+    for (size_t i = 1; i < queues.size(); i++) {
+        WorkQueue& victim = *queues[(worker + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty()) {
+            job = std::move(victim.jobs.front());
+            victim.jobs.pop_front();
+            queued.fetch_sub(1);
+            stolen.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::execute(Job& job) {
+    job.task();
+    executed.fetch_add(1, std::memory_order_relaxed);
+    finish(job.counter);
+}
+
+void JobSystem::finish(JobCounter* counter) {
+    if (!counter)
+        return;
+    std::vector<JobCounter::Continuation> continuations;
+    {
+        std::lock_guard<std::mutex> lock(counter->mutex);
+        if (counter->pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            continuations.swap(counter->continuations);
+    }
+    // counter may be gone from here on
+    for (JobCounter::Continuation& continuation : continuations)
+        push({ std::move(continuation.task), continuation.counter });
+}
+
+void JobSystem::workerLoop(unsigned int worker) {
+    workerOwner = this;
+    workerIndex = worker;
+    while (true) {
+        Job job;
+        if (pop(worker, job)) {
+            execute(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        sleeping.fetch_add(1);
+        jobReady.wait(lock, [this]() { return stopping || queued.load() > 0; });
+        sleeping.fetch_sub(1);
+        if (stopping)
+            return;
+    }
+}
+
+unsigned int JobSystem::currentWorker() const {
+    return workerOwner == this ? workerIndex : 0;
+}
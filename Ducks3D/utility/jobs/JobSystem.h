@@ -0,0 +1,106 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+
+// Counts the unfinished jobs that were run with it. Jobs can be run
+// after a counter drains, which is how dependencies between jobs (and
+// whole task graphs) are expressed. Counters can be reused once they
+// are back at zero, and destroyed once JobSystem::Wait returned on them.
+class JobCounter {
+public:
+    JobCounter() : pending(0) {}
+    bool Done() const { return pending.load(std::memory_order_acquire) == 0; }
+private:
+    friend class JobSystem;
+    struct Continuation {
+        std::function<void()> task;
+        JobCounter* counter;
+    };
+
+    std::atomic<int> pending;
+    std::mutex mutex;
+    // jobs waiting for this counter to drain
+    std::vector<Continuation> continuations;
+
+    JobCounter(const JobCounter&) = delete;
+    JobCounter& operator=(const JobCounter&) = delete;
+};
+
+// Work-stealing job system. Every thread has a deque of its own: it
+// pushes and pops jobs at the back, so the work it spawned last is still
+// hot in its cache, while idle threads steal from the front of the
+// others', which takes the oldest and usually largest pieces of work.
+// The thread that calls Start is worker 0 and only runs jobs while it
+// waits on a counter; the other workers sleep when every deque is empty.
+// Jobs must not block on anything but counters.
+class JobSystem {
+public:
+    JobSystem();
+    ~JobSystem();
+
+    // starts threadCount - 1 workers next to the calling thread, 0 uses the hardware concurrency
+    void Start(unsigned int threadCount = 0);
+    // threads that run jobs, the calling thread of Start included
+    unsigned int ThreadCount() const { return static_cast<unsigned int>(queues.size()); }
+
+    // queues task, counter (may be null) is incremented now and decremented once the task ran
+    void Run(std::function<void()> task, JobCounter* counter = nullptr);
+    // as Run, but task is only queued once dependency has drained
+    void RunAfter(JobCounter& dependency, std::function<void()> task, JobCounter* counter = nullptr);
+    // splits [0, count) into ranges of at least grain items and runs body on each range, returns right
+    // away. The ranges are done when counter drains, body is copied and may go out of scope
+    void ParallelFor(size_t count, size_t grain, std::function<void(size_t begin, size_t end)> body, JobCounter& counter);
+    // as above, but returns once every range is done. The calling thread works on the ranges too
+    void ParallelFor(size_t count, size_t grain, const std::function<void(size_t begin, size_t end)>& body);
+    // runs queued jobs on the calling thread until counter has drained
+    void Wait(JobCounter& counter);
+
+    // jobs run and jobs taken from another thread's deque since the last ResetCounters
+    size_t ExecutedJobs() const { return executed.load(std::memory_order_relaxed); }
+    size_t StolenJobs() const { return stolen.load(std::memory_order_relaxed); }
+    void ResetCounters();
+
+    // stops the workers, jobs still queued are dropped
+    void Release();
+private:
+    struct Job {
+        std::function<void()> task;
+        JobCounter* counter;
+    };
+    // padded by a cache line on both sides so workers don't false share each other's locks. Padding rather
+    // than alignas, which plain new ignores before C++17
+    static const size_t CACHE_LINE = 64;
+    struct WorkQueue {
+        char paddingBefore[CACHE_LINE];
+        std::mutex mutex;
+        std::deque<Job> jobs;
+        char paddingAfter[CACHE_LINE];
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+    // jobs sitting in any deque, lets workers go to sleep without scanning
+    std::atomic<int> queued;
+    std::atomic<int> sleeping;
+    std::atomic<size_t> executed, stolen;
+    std::mutex sleepMutex;
+    std::condition_variable jobReady;
+    bool stopping;
+
+    void push(Job job);
+    bool pop(unsigned int worker, Job& job);
+    void execute(Job& job);
+    void finish(JobCounter* counter);
+    void workerLoop(unsigned int worker);
+    unsigned int currentWorker() const;
+};
+
+#endif
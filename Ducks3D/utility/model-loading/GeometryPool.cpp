@@ -0,0 +1,321 @@
+#include "GeometryPool.h"
+
+#include <iostream>
+#include <algorithm>
+#include <iterator>
+
+#include "Mesh.h"
+#include "../rendering/RenderState.h"
+
+namespace {
+    // the pool starts out this large and at least doubles when it has to grow
+    const size_t INITIAL_VERTICES = 64 * 1024;
+    const size_t INITIAL_INDICES = 256 * 1024;
+}
+
+// Instantiate static variables
+unsigned int GeometryPool::vertexBuffer = 0;
+unsigned int GeometryPool::indexBuffer = 0;
+GeometryPool::RangeAllocator GeometryPool::vertexSpace;
+GeometryPool::RangeAllocator GeometryPool::indexSpace;
+std::vector<GeometryPool::Allocation> GeometryPool::allocations;
+std::vector<int> GeometryPool::freeAllocations;
+unsigned int GeometryPool::sharedVertexArray = 0;
+std::vector<unsigned int> GeometryPool::instancedVertexArrays;
+
+GeometryHandle GeometryPool::Allocate(const Vertex* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount) {
+    GeometryHandle handle;
+    size_t vertexOffset = RangeAllocator::FAILED, indexOffset = RangeAllocator::FAILED;
+    // a failed attempt compacts or grows the pool, which always makes the next one fit by the third
+    for (int attempt = 0; attempt < 3; attempt++) {
+        vertexOffset = vertexSpace.Allocate(vertexCount);
+        if (vertexOffset != RangeAllocator::FAILED) {
+            indexOffset = indexSpace.Allocate(indexCount);
+            if (indexOffset != RangeAllocator::FAILED)
+                break;
+            vertexSpace.Free(vertexOffset, vertexCount);
+            vertexOffset = RangeAllocator::FAILED;
+        }
+        if (attempt < 2)
+            reserve(vertexCount, indexCount);
+    }
+    if (vertexOffset == RangeAllocator::FAILED) {
+        std::cerr << "GeometryPool: failed to allocate " << vertexCount << " vertices and " << indexCount << " indices" << std::endl;
+        return handle;
+    }
+
+    if (vertexCount > 0) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vertexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, vertexOffset * sizeof(Vertex), vertexCount * sizeof(Vertex), vertexData);
+    }
+    if (indexCount > 0) {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, indexBuffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, indexOffset * sizeof(unsigned int), indexCount * sizeof(unsigned int), indexData);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    if (!freeAllocations.empty()) {
+        handle.index = freeAllocations.back();
+        freeAllocations.pop_back();
+    }
+    else {
+        handle.index = static_cast<int>(allocations.size());
+        allocations.push_back(Allocation());
+    }
+    Allocation& allocation = allocations[handle.index];
+    allocation.range.baseVertex = static_cast<unsigned int>(vertexOffset);
+    allocation.range.vertexCount = vertexCount;
+    allocation.range.firstIndex = static_cast<unsigned int>(indexOffset);
+    allocation.range.indexCount = indexCount;
+    allocation.live = true;
+    return handle;
+}
+
+void GeometryPool::Free(GeometryHandle handle) {
+    if (!handle.IsValid() || handle.index >= static_cast<int>(allocations.size()) || !allocations[handle.index].live)
+        return;
+    Allocation& allocation = allocations[handle.index];
+    vertexSpace.Free(allocation.range.baseVertex, allocation.range.vertexCount);
+    indexSpace.Free(allocation.range.firstIndex, allocation.range.indexCount);
+    allocation.live = false;
+    freeAllocations.push_back(handle.index);
+}
+
+void GeometryPool::Read(GeometryHandle handle, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    const GeometryRange& range = Get(handle);
+    vertices.resize(range.vertexCount);
+    indices.resize(range.indexCount);
+    glBindBuffer(GL_COPY_READ_BUFFER, vertexBuffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, range.baseVertex * sizeof(Vertex), range.vertexCount * sizeof(Vertex), vertices.data());
+    glBindBuffer(GL_COPY_READ_BUFFER, indexBuffer);
+    glGetBufferSubData(GL_COPY_READ_BUFFER, range.firstIndex * sizeof(unsigned int), range.indexCount * sizeof(unsigned int), indices.data());
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+}
+
+void GeometryPool::Compact() {
+    std::vector<Allocation*> live;
+    for (Allocation& allocation : allocations) {
+        if (allocation.live)
+            live.push_back(&allocation);
+    }
+
+    // vertices and indices are packed separately, each in the order they are in now
+    std::vector<std::pair<size_t, size_t>> ranges;
+    std::sort(live.begin(), live.end(), [](const Allocation* a, const Allocation* b) { return a->range.baseVertex < b->range.baseVertex; });
+    size_t packed = 0;
+    for (Allocation* allocation : live) {
+        ranges.push_back(std::make_pair(allocation->range.baseVertex * sizeof(Vertex), allocation->range.vertexCount * sizeof(Vertex)));
+        allocation->range.baseVertex = static_cast<unsigned int>(packed);
+        packed += allocation->range.vertexCount;
+    }
+    reallocate(vertexBuffer, vertexSpace.Capacity() * sizeof(Vertex), ranges);
+    vertexSpace.Reset(packed);
+
+    ranges.clear();
+    std::sort(live.begin(), live.end(), [](const Allocation* a, const Allocation* b) { return a->range.firstIndex < b->range.firstIndex; });
+    packed = 0;
+    for (Allocation* allocation : live) {
+        ranges.push_back(std::make_pair(allocation->range.firstIndex * sizeof(unsigned int), allocation->range.indexCount * sizeof(unsigned int)));
+        allocation->range.firstIndex = static_cast<unsigned int>(packed);
+        packed += allocation->range.indexCount;
+    }
+    reallocate(indexBuffer, indexSpace.Capacity() * sizeof(unsigned int), ranges);
+    indexSpace.Reset(packed);
+
+    bindVertexArrays();
+}
+
+unsigned int GeometryPool::VertexArray() {
+    if (sharedVertexArray == 0) {
+        glGenVertexArrays(1, &sharedVertexArray);
+        bindGeometry(sharedVertexArray);
+        RenderState::BindVertexArray(0);
+    }
+    return sharedVertexArray;
+}
+
+unsigned int GeometryPool::CreateInstancedVertexArray(unsigned int instanceBuffer) {
+    unsigned int vao;
+    glGenVertexArrays(1, &vao);
+    bindGeometry(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+
+    // a mat4 attribute takes up four consecutive vec4 locations
+    for (unsigned int i = 0; i < 4; i++) {
+        glVertexAttribPointer(2 + i, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)(offsetof(InstanceData, Model) + i * sizeof(glm::vec4)));
+        glEnableVertexAttribArray(2 + i);
+        glVertexAttribDivisor(2 + i, 1);
+    }
+
+    glVertexAttribPointer(6, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), (void*)offsetof(InstanceData, Tint));
+    glEnableVertexAttribArray(6);
+    glVertexAttribDivisor(6, 1);
+
+    RenderState::BindVertexArray(0);
+    instancedVertexArrays.push_back(vao);
+    return vao;
+}
+
+void GeometryPool::DeleteVertexArray(unsigned int vao) {
+    instancedVertexArrays.erase(std::remove(instancedVertexArrays.begin(), instancedVertexArrays.end(), vao), instancedVertexArrays.end());
+    // deleting a bound VAO silently unbinds it, keep the state cache in step
+    RenderState::BindVertexArray(0);
+    glDeleteVertexArrays(1, &vao);
+}
+
+void GeometryPool::Release() {
+    RenderState::BindVertexArray(0);
+    if (!instancedVertexArrays.empty())
+        glDeleteVertexArrays(static_cast<GLsizei>(instancedVertexArrays.size()), instancedVertexArrays.data());
+    instancedVertexArrays.clear();
+    if (sharedVertexArray != 0)
+        glDeleteVertexArrays(1, &sharedVertexArray);
+    sharedVertexArray = 0;
+    if (vertexBuffer != 0)
+        glDeleteBuffers(1, &vertexBuffer);
+    if (indexBuffer != 0)
+        glDeleteBuffers(1, &indexBuffer);
+    vertexBuffer = indexBuffer = 0;
+    vertexSpace = RangeAllocator();
+    indexSpace = RangeAllocator();
+    allocations.clear();
+    freeAllocations.clear();
+}
+
+void GeometryPool::reserve(size_t vertexCount, size_t indexCount) {
+    size_t freeVertices = vertexSpace.Capacity() - vertexSpace.Used();
+    size_t freeIndices = indexSpace.Capacity() - indexSpace.Used();
+    if (vertexBuffer != 0 && freeVertices >= vertexCount && freeIndices >= indexCount) {
+        // enough room, just not in one piece
+        Compact();
+        return;
+    }
+    if (freeVertices < vertexCount || vertexBuffer == 0) {
+        size_t capacity = std::max(std::max(vertexSpace.Capacity() * 2, INITIAL_VERTICES), vertexSpace.Used() + vertexCount);
+        std::vector<std::pair<size_t, size_t>> whole(1, std::make_pair(size_t(0), vertexSpace.Capacity() * sizeof(Vertex)));
+        reallocate(vertexBuffer, capacity * sizeof(Vertex), whole);
+        vertexSpace.Grow(capacity);
+    }
+    if (freeIndices < indexCount || indexBuffer == 0) {
+        size_t capacity = std::max(std::max(indexSpace.Capacity() * 2, INITIAL_INDICES), indexSpace.Used() + indexCount);
+        std::vector<std::pair<size_t, size_t>> whole(1, std::make_pair(size_t(0), indexSpace.Capacity() * sizeof(unsigned int)));
+        reallocate(indexBuffer, capacity * sizeof(unsigned int), whole);
+        indexSpace.Grow(capacity);
+    }
+    bindVertexArrays();
+}
+
+void GeometryPool::reallocate(unsigned int& buffer, size_t capacity, const std::vector<std::pair<size_t, size_t>>& ranges) {
+    // the copy targets leave the array and element bindings (and so the bound VAO) alone
+    unsigned int target;
+    glGenBuffers(1, &target);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, target);
+    glBufferData(GL_COPY_WRITE_BUFFER, capacity, nullptr, GL_STATIC_DRAW);
+    if (buffer != 0) {
+        glBindBuffer(GL_COPY_READ_BUFFER, buffer);
+        size_t packed = 0;
+        for (const std::pair<size_t, size_t>& range : ranges) {
+            if (range.second > 0)
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, range.first, packed, range.second);
+            packed += range.second;
+        }
+        glBindBuffer(GL_COPY_READ_BUFFER, 0);
+        glDeleteBuffers(1, &buffer);
+    }
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    buffer = target;
+}
+
+void GeometryPool::bindVertexArrays() {
+    if (sharedVertexArray != 0)
+        bindGeometry(sharedVertexArray);
+    for (unsigned int vao : instancedVertexArrays)
+        bindGeometry(vao);
+    RenderState::BindVertexArray(0);
+}
+
+void GeometryPool::bindGeometry(unsigned int vao) {
+    RenderState::BindVertexArray(vao);
+    if (vertexBuffer == 0)
+        return;
+    glBindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+    glEnableVertexAttribArray(1);
+}
+
+size_t GeometryPool::RangeAllocator::Allocate(size_t size) {
+    if (size == 0)
+        return 0;
+    auto fit = bySize.lower_bound(size);
+    if (fit == bySize.end())
+        return FAILED;
+    size_t offset = fit->second;
+    size_t blockSize = fit->first;
+    erase(byOffset.find(offset));
+    if (blockSize > size)
+        insert(offset + size, blockSize - size);
+    used += size;
+    return offset;
+}
+
+void GeometryPool::RangeAllocator::Free(size_t offset, size_t size) {
+    if (size == 0)
+        return;
+    used -= size;
+    // merge with the free blocks right after and right before
+    auto next = byOffset.lower_bound(offset);
+    if (next != byOffset.end() && next->first == offset + size) {
+        size += next->second;
+        erase(next);
+        next = byOffset.lower_bound(offset);
+    }
+    if (next != byOffset.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            offset = previous->first;
+            size += previous->second;
+            erase(previous);
+        }
+    }
+    insert(offset, size);
+}
+
+void GeometryPool::RangeAllocator::Grow(size_t capacity) {
+    if (capacity <= this->capacity)
+        return;
+    size_t added = capacity - this->capacity;
+    size_t offset = this->capacity;
+    this->capacity = capacity;
+    // freeing the new part merges it with a free block at the old end
+    used += added;
+    Free(offset, added);
+}
+
+void GeometryPool::RangeAllocator::Reset(size_t used) {
+    byOffset.clear();
+    bySize.clear();
+    this->used = used;
+    if (capacity > used)
+        insert(used, capacity - used);
+}
+
+void GeometryPool::RangeAllocator::insert(size_t offset, size_t size) {
+    byOffset[offset] = size;
+    bySize.insert(std::make_pair(size, offset));
+}
+
+void GeometryPool::RangeAllocator::erase(std::map<size_t, size_t>::iterator block) {
+    auto sizes = bySize.equal_range(block->second);
+    for (auto entry = sizes.first; entry != sizes.second; ++entry) {
+        if (entry->second == block->first) {
+            bySize.erase(entry);
+            break;
+        }
+    }
+    byOffset.erase(block);
+}
@@ -0,0 +1,110 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include <vector>
+#include <map>
+#include <cstddef>
+
+struct Vertex;
+
+// a mesh's ranges in the geometry pool, resolved through GeometryPool::Get
+struct GeometryHandle {
+    int index = -1;
+    bool IsValid() const { return index >= 0; }
+};
+
+// vertex and index range of one allocation, in elements. Indices are relative to baseVertex
+struct GeometryRange {
+    unsigned int baseVertex;
+    unsigned int vertexCount;
+    unsigned int firstIndex;
+    unsigned int indexCount;
+};
+
+// A static pool that holds the geometry of every Mesh in one vertex
+// buffer and one index buffer. Meshes are ranges in it and are drawn
+// with the base vertex variants of glDrawElements through one vertex
+// array shared by all of them, so switching meshes switches no state.
+// Both buffers are suballocated with a best fit free list that merges
+// neighbouring free blocks. When an allocation doesn't fit, the pool
+// compacts the live ranges if that frees enough room in one piece and
+// otherwise grows the buffer, copying it on the GPU. Ranges can move
+// either way, so meshes keep handles and look their range up when they
+// draw.
+class GeometryPool {
+public:
+    // copies the arrays into the pool, indices relative to the first vertex
+    static GeometryHandle Allocate(const Vertex* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount);
+    static void Free(GeometryHandle handle);
+    static const GeometryRange& Get(GeometryHandle handle) { return allocations[handle.index].range; }
+    // copies an allocation back from the GPU, for the meshes that keep no CPU copy. Stalls on pending writes
+    static void Read(GeometryHandle handle, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+    // moves all live ranges to the start of the buffers, leaving the free space in one block at the end
+    static void Compact();
+
+    // vertex array with the pool's buffers on locations 0 and 1
+    static unsigned int VertexArray();
+    // a vertex array of the pool's buffers plus InstanceData read from instanceBuffer, the model matrix on
+    // locations 2-5 and the tint on 6. The pool keeps it pointing at its buffers until DeleteVertexArray
+    static unsigned int CreateInstancedVertexArray(unsigned int instanceBuffer);
+    static void DeleteVertexArray(unsigned int vao);
+
+    // elements in use and allocated
+    static size_t VerticesUsed() { return vertexSpace.Used(); }
+    static size_t VertexCapacity() { return vertexSpace.Capacity(); }
+    static size_t IndicesUsed() { return indexSpace.Used(); }
+    static size_t IndexCapacity() { return indexSpace.Capacity(); }
+
+    // deletes the buffers and vertex arrays, every handle becomes invalid
+    static void Release();
+private:
+    GeometryPool() {}
+
+    // best fit free list over [0, capacity)
+    class RangeAllocator {
+    public:
+        static const size_t FAILED = ~static_cast<size_t>(0);
+
+        RangeAllocator() : capacity(0), used(0) {}
+        // FAILED if no free block is large enough
+        size_t Allocate(size_t size);
+        void Free(size_t offset, size_t size);
+        // extends the range to capacity, the new part is free
+        void Grow(size_t capacity);
+        // everything free but the first used elements
+        void Reset(size_t used);
+        size_t Capacity() const { return capacity; }
+        size_t Used() const { return used; }
+    private:
+        size_t capacity;
+        size_t used;
+        // free blocks by offset for merging and by size for best fit
+        std::map<size_t, size_t> byOffset;
+        std::multimap<size_t, size_t> bySize;
+
+        void insert(size_t offset, size_t size);
+        void erase(std::map<size_t, size_t>::iterator block);
+    };
+
+    struct Allocation {
+        GeometryRange range;
+        bool live;
+    };
+
+    static unsigned int vertexBuffer, indexBuffer;
+    static RangeAllocator vertexSpace, indexSpace;
+    static std::vector<Allocation> allocations;
+    static std::vector<int> freeAllocations;
+    static unsigned int sharedVertexArray;
+    static std::vector<unsigned int> instancedVertexArrays;
+
+    // makes room for the given element counts, by compacting or growing
+    static void reserve(size_t vertexCount, size_t indexCount);
+    // replaces buffer with one of capacity bytes holding the copies of the given byte ranges, packed in order
+    static void reallocate(unsigned int& buffer, size_t capacity, const std::vector<std::pair<size_t, size_t>>& ranges);
+    // points the pool's vertex arrays at the current buffers
+    static void bindVertexArrays();
+    static void bindGeometry(unsigned int vao);
+};
+
+#endif
@@ -1,34 +1,60 @@
 #include "Mesh.h"
 
-Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices)
-    : vertices(vertices), indices(indices) {
-    setupMesh();
-}
-
-void Mesh::setupMesh() {
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
+#include <utility>
+#include <algorithm>
+#include <cmath>
 
-    glBindVertexArray(VAO);
+#include "../rendering/RenderState.h"
 
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+Mesh::Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<MeshLod> lods)
+    : vertices(std::move(vertices)), indices(std::move(indices)), lods(std::move(lods)) {
+    setupMesh(this->vertices.data(), static_cast<unsigned int>(this->vertices.size()), this->indices.data(), static_cast<unsigned int>(this->indices.size()));
+}
 
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+Mesh::Mesh(const Vertex* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount, std::vector<MeshLod> lods)
+    : lods(std::move(lods)) {
+    setupMesh(vertexData, vertexCount, indexData, indexCount);
+}
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-    glEnableVertexAttribArray(0);
+void Mesh::setupMesh(const Vertex* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int totalIndexCount) {
+    if (lods.empty())
+        lods.push_back({ 0, totalIndexCount, 0.0f });
+    indexCount = lods[0].indexCount;
+    computeBounds(vertexData, vertexCount);
 
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-    glEnableVertexAttribArray(1);
+    geometry = GeometryPool::Allocate(vertexData, vertexCount, indexData, totalIndexCount);
+}
 
-    glBindVertexArray(0);
+void Mesh::computeBounds(const Vertex* vertexData, unsigned int vertexCount) {
+    bounds = AABB();
+    for (unsigned int i = 0; i < vertexCount; i++)
+        bounds.Expand(vertexData[i].Position);
+    // centered on the box, which is tight enough for culling and cheaper than a minimal sphere
+    sphere.center = vertexCount > 0 ? bounds.Center() : glm::vec3(0.0f);
+    float radiusSquared = 0.0f;
+    for (unsigned int i = 0; i < vertexCount; i++) {
+        glm::vec3 offset = vertexData[i].Position - sphere.center;
+        radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+    }
+    sphere.radius = std::sqrt(radiusSquared);
 }
 
 void Mesh::Draw() {
-    glBindVertexArray(VAO);
-    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(indices.size()), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);
+    const GeometryRange& range = Range();
+    RenderState::BindVertexArray(GeometryPool::VertexArray());
+    glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(indexCount), GL_UNSIGNED_INT,
+        (void*)(range.firstIndex * sizeof(unsigned int)), static_cast<GLint>(range.baseVertex));
+}
+
+void Mesh::DrawInstanced(unsigned int instanceCount, unsigned int vao, unsigned int level) {
+    const MeshLod& lod = Lod(level);
+    const GeometryRange& range = Range();
+    RenderState::BindVertexArray(vao);
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(lod.indexCount), GL_UNSIGNED_INT,
+        (void*)((range.firstIndex + lod.firstIndex) * sizeof(unsigned int)), instanceCount, static_cast<GLint>(range.baseVertex));
+}
+
+void Mesh::Release() {
+    GeometryPool::Free(geometry);
+    geometry = GeometryHandle();
 }
@@ -6,24 +6,62 @@
 #include <vector>
 #include <string>
 #include "../texture/Texture2D.h"
+#include "../culling/Bounds.h"
+#include "GeometryPool.h"
 
 struct Vertex {
     glm::vec3 Position;
     glm::vec2 TexCoords;
 };
 
+// per-instance attributes streamed to the GPU for instanced draws
+struct InstanceData {
+    glm::mat4 Model;
+    glm::vec4 Tint;
+};
+
+// index range of one level of detail within a mesh's indices
+struct MeshLod {
+    unsigned int firstIndex;
+    unsigned int indexCount;
+    // largest deviation from the full detail mesh, in model units
+    float error;
+};
+
 class Mesh {
 public:
+    // CPU-side copies of the geometry, left empty when the mesh is uploaded straight from a mesh cache
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
-    unsigned int VAO;
+    // the mesh's vertices and indices in the GeometryPool
+    GeometryHandle geometry;
+    // indices of level 0
+    unsigned int indexCount;
+    // level 0 is the full detail mesh, all levels index the same vertices
+    std::vector<MeshLod> lods;
+    // model space bounds, computed from the vertices when the mesh is created
+    AABB bounds;
+    BoundingSphere sphere;
 
-    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices);
+    // without lods the whole index buffer is the only level
+    Mesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices, std::vector<MeshLod> lods = std::vector<MeshLod>());
+    // uploads the given arrays without keeping a CPU copy, indexCount covers the indices of all levels
+    Mesh(const Vertex* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int indexCount,
+        std::vector<MeshLod> lods = std::vector<MeshLod>());
 
     void Draw();
+    // draws instanceCount copies of a level in a single call through vao, a vertex array
+    // from GeometryPool::CreateInstancedVertexArray
+    void DrawInstanced(unsigned int instanceCount, unsigned int vao, unsigned int level = 0);
+    // where the mesh currently lives in the pool's buffers, valid until the next allocation
+    const GeometryRange& Range() const { return GeometryPool::Get(geometry); }
+    // the level of detail used for level, meshes with fewer levels repeat their coarsest one
+    const MeshLod& Lod(unsigned int level) const { return lods[level < lods.size() ? level : lods.size() - 1]; }
+    // returns the mesh's ranges to the pool
+    void Release();
 private:
-    unsigned int VBO, EBO;
-    void setupMesh();
+    void setupMesh(const Vertex* vertexData, unsigned int vertexCount, const unsigned int* indexData, unsigned int totalIndexCount);
+    void computeBounds(const Vertex* vertexData, unsigned int vertexCount);
 };
 
 #endif
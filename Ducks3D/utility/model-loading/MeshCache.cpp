@@ -0,0 +1,130 @@
+#include "MeshCache.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+
+#include "../io/MappedFile.h"
+
+namespace {
+    const char MAGIC[4] = { 'D', 'K', 'M', 'C' };
+    // bump whenever the layout of the file or of Vertex changes, or the import produces different geometry
+    const uint32_t VERSION = 4;
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t vertexSize;
+        uint32_t meshCount;
+        uint64_t sourceSize;
+        int64_t sourceTime;
+    };
+
+    struct MeshEntry {
+        uint32_t vertexCount;
+        // indices of all levels of detail
+        uint32_t indexCount;
+        uint32_t lodCount;
+    };
+
+    bool statSource(const std::string& path, uint64_t& size, int64_t& time) {
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0)
+            return false;
+        size = static_cast<uint64_t>(info.st_size);
+        time = static_cast<int64_t>(info.st_mtime);
+        return true;
+    }
+}
+
+std::string MeshCache::PathFor(const std::string& modelPath) {
+    size_t dot = modelPath.find_last_of('.');
+    size_t slash = modelPath.find_last_of("/\\");
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        return modelPath + ".mesh";
+    return modelPath.substr(0, dot) + ".mesh";
+}
+
+bool MeshCache::Write(const std::string& modelPath, const std::vector<Mesh>& meshes) {
+    Header header;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.vertexSize = sizeof(Vertex);
+    header.meshCount = static_cast<uint32_t>(meshes.size());
+    if (!statSource(modelPath, header.sourceSize, header.sourceTime))
+        return false;
+
+    std::ofstream file(PathFor(modelPath), std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    for (const Mesh& mesh : meshes) {
+        MeshEntry entry = { static_cast<uint32_t>(mesh.vertices.size()), static_cast<uint32_t>(mesh.indices.size()), static_cast<uint32_t>(mesh.lods.size()) };
+        file.write(reinterpret_cast<const char*>(&entry), sizeof(entry));
+    }
+    for (const Mesh& mesh : meshes) {
+        file.write(reinterpret_cast<const char*>(mesh.lods.data()), mesh.lods.size() * sizeof(MeshLod));
+        file.write(reinterpret_cast<const char*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(Vertex));
+        file.write(reinterpret_cast<const char*>(mesh.indices.data()), mesh.indices.size() * sizeof(unsigned int));
+    }
+    return static_cast<bool>(file);
+}
+
+bool MeshCache::Load(const std::string& modelPath, std::vector<Mesh>& meshes) {
+    MappedFile file;
+    if (!file.Open(PathFor(modelPath)) || file.Size() < sizeof(Header))
+        return false;
+
+    Header header;
+    std::memcpy(&header, file.Data(), sizeof(header));
+    if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 || header.version != VERSION || header.vertexSize != sizeof(Vertex))
+        return false;
+    uint64_t sourceSize;
+    int64_t sourceTime;
+    if (statSource(modelPath, sourceSize, sourceTime) && (sourceSize != header.sourceSize || sourceTime != header.sourceTime))
+        return false;
+
+    // validate the whole layout before creating any GL objects
+    const MeshEntry* entries = reinterpret_cast<const MeshEntry*>(file.Data() + sizeof(Header));
+    size_t expected = sizeof(Header) + header.meshCount * sizeof(MeshEntry);
+    if (expected > file.Size())
+        return false;
+    for (uint32_t i = 0; i < header.meshCount; i++)
+        expected += entries[i].lodCount * sizeof(MeshLod) + entries[i].vertexCount * sizeof(Vertex) + entries[i].indexCount * sizeof(unsigned int);
+    if (expected != file.Size())
+        return false;
+    const unsigned char* lodTable = file.Data() + sizeof(Header) + header.meshCount * sizeof(MeshEntry);
+    for (uint32_t i = 0; i < header.meshCount; i++) {
+        if (entries[i].lodCount == 0)
+            return false;
+        for (uint32_t level = 0; level < entries[i].lodCount; level++) {
+            MeshLod lod;
+            std::memcpy(&lod, lodTable + level * sizeof(MeshLod), sizeof(lod));
+            if (lod.firstIndex > entries[i].indexCount || lod.indexCount > entries[i].indexCount - lod.firstIndex)
+                return false;
+        }
+        // indices past the vertices would have the GPU and the CPU occluders read out of bounds
+        const unsigned int* indices = reinterpret_cast<const unsigned int*>(lodTable + entries[i].lodCount * sizeof(MeshLod)
+            + entries[i].vertexCount * sizeof(Vertex));
+        for (uint32_t index = 0; index < entries[i].indexCount; index++) {
+            if (indices[index] >= entries[i].vertexCount)
+                return false;
+        }
+        lodTable += entries[i].lodCount * sizeof(MeshLod) + entries[i].vertexCount * sizeof(Vertex) + entries[i].indexCount * sizeof(unsigned int);
+    }
+
+    const unsigned char* cursor = file.Data() + sizeof(Header) + header.meshCount * sizeof(MeshEntry);
+    meshes.reserve(meshes.size() + header.meshCount);
+    for (uint32_t i = 0; i < header.meshCount; i++) {
+        const MeshLod* lods = reinterpret_cast<const MeshLod*>(cursor);
+        cursor += entries[i].lodCount * sizeof(MeshLod);
+        const Vertex* vertices = reinterpret_cast<const Vertex*>(cursor);
+        cursor += entries[i].vertexCount * sizeof(Vertex);
+        const unsigned int* indices = reinterpret_cast<const unsigned int*>(cursor);
+        cursor += entries[i].indexCount * sizeof(unsigned int);
+        meshes.emplace_back(vertices, entries[i].vertexCount, indices, entries[i].indexCount,
+            std::vector<MeshLod>(lods, lods + entries[i].lodCount));
+    }
+    return true;
+}
@@ -0,0 +1,25 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <string>
+#include <vector>
+#include "Mesh.h"
+
+// Compact binary container for imported meshes, written next to the
+// source model on first import. The file holds a header, a table of
+// per-mesh vertex/index/level counts and then each mesh's level of
+// detail ranges and packed Vertex and index arrays, so loading is a
+// memory map plus one upload per buffer.
+class MeshCache {
+public:
+    // path of the cache belonging to a source model, e.g. duck.obj -> duck.mesh
+    static std::string PathFor(const std::string& modelPath);
+    // writes meshes (which must still hold their CPU-side geometry), tagged with the source file's size and timestamp
+    static bool Write(const std::string& modelPath, const std::vector<Mesh>& meshes);
+    // maps the cache of modelPath and uploads its meshes, fails if it is missing, stale or malformed
+    static bool Load(const std::string& modelPath, std::vector<Mesh>& meshes);
+private:
+    MeshCache() {}
+};
+
+#endif
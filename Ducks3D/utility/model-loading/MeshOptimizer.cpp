@@ -0,0 +1,185 @@
+#include "MeshOptimizer.h"
+
+#include <iostream>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+    struct VertexHash {
+        size_t operator()(const Vertex& vertex) const {
+            // FNV-1a over the raw bytes, identical vertices are bitwise identical
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&vertex);
+            size_t hash = 2166136261u;
+            for (size_t i = 0; i < sizeof(Vertex); i++)
+                hash = (hash ^ bytes[i]) * 16777619u;
+            return hash;
+        }
+    };
+
+    struct VertexEqual {
+        bool operator()(const Vertex& a, const Vertex& b) const {
+            return std::memcmp(&a, &b, sizeof(Vertex)) == 0;
+        }
+    };
+
+    // picks the next fanning vertex for Tipsify: the candidate still in the cache after
+    // emitting its remaining triangles that entered the cache the earliest
+    int nextFanningVertex(const std::vector<unsigned int>& candidates, const std::vector<unsigned int>& liveTriangles,
+        const std::vector<unsigned int>& cacheTime, unsigned int timestamp) {
+        int best = -1;
+        int bestPriority = -1;
+        for (unsigned int vertex : candidates) {
+            if (liveTriangles[vertex] == 0)
+                continue;
+            int priority = 0;
+            if (timestamp - cacheTime[vertex] + 2 * liveTriangles[vertex] <= MeshOptimizer::CACHE_SIZE)
+                priority = timestamp - cacheTime[vertex];
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                best = static_cast<int>(vertex);
+            }
+        }
+        return best;
+    }
+}
+
+void MeshOptimizer::Optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    if (indices.empty())
+        return;
+    size_t vertexCount = vertices.size();
+    CacheStats before = AnalyzeVertexCache(indices, vertices.size());
+
+    WeldVertices(vertices, indices);
+    OptimizeVertexCache(indices, vertices.size());
+    OptimizeVertexFetch(vertices, indices);
+
+    CacheStats after = AnalyzeVertexCache(indices, vertices.size());
+    std::cout << "MeshOptimizer: " << vertexCount << " -> " << vertices.size() << " vertices, "
+        << "ACMR " << before.acmr << " -> " << after.acmr << ", "
+        << "ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+}
+
+void MeshOptimizer::WeldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    std::unordered_map<Vertex, unsigned int, VertexHash, VertexEqual> unique;
+    unique.reserve(vertices.size());
+    std::vector<unsigned int> remap(vertices.size());
+    std::vector<Vertex> welded;
+    welded.reserve(vertices.size());
+
+    for (size_t i = 0; i < vertices.size(); i++) {
+        auto inserted = unique.emplace(vertices[i], static_cast<unsigned int>(welded.size()));
+        if (inserted.second)
+            welded.push_back(vertices[i]);
+        remap[i] = inserted.first->second;
+    }
+    for (unsigned int& index : indices)
+        index = remap[index];
+    vertices.swap(welded);
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount) {
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0 || vertexCount == 0)
+        return;
+
+    // vertex -> triangle adjacency in compressed rows
+    std::vector<unsigned int> liveTriangles(vertexCount, 0);
+    for (unsigned int index : indices)
+        liveTriangles[index]++;
+    std::vector<unsigned int> offsets(vertexCount + 1, 0);
+    for (size_t v = 0; v < vertexCount; v++)
+        offsets[v + 1] = offsets[v] + liveTriangles[v];
+    std::vector<unsigned int> adjacency(offsets[vertexCount]);
+    std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t t = 0; t < triangleCount; t++)
+        for (size_t corner = 0; corner < 3; corner++)
+            adjacency[fill[indices[t * 3 + corner]]++] = static_cast<unsigned int>(t);
+
+    std::vector<unsigned int> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<unsigned int> deadEnds;
+    std::vector<unsigned int> candidates;
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+
+    unsigned int timestamp = CACHE_SIZE + 1;
+    size_t cursor = 0;
+    int fanning = 0;
+    while (fanning >= 0) {
+        candidates.clear();
+        for (unsigned int i = offsets[fanning]; i < offsets[fanning + 1]; i++) {
+            unsigned int triangle = adjacency[i];
+            if (emitted[triangle])
+                continue;
+            for (size_t corner = 0; corner < 3; corner++) {
+                unsigned int vertex = indices[triangle * 3 + corner];
+                output.push_back(vertex);
+                deadEnds.push_back(vertex);
+                candidates.push_back(vertex);
+                liveTriangles[vertex]--;
+                if (timestamp - cacheTime[vertex] > CACHE_SIZE)
+                    cacheTime[vertex] = timestamp++;
+            }
+            emitted[triangle] = true;
+        }
+
+        fanning = nextFanningVertex(candidates, liveTriangles, cacheTime, timestamp);
+        if (fanning >= 0)
+            continue;
+        // dead end: fall back to recently used vertices, then to input order
+        while (!deadEnds.empty()) {
+            unsigned int vertex = deadEnds.back();
+            deadEnds.pop_back();
+            if (liveTriangles[vertex] > 0) {
+                fanning = static_cast<int>(vertex);
+                break;
+            }
+        }
+        while (fanning < 0 && cursor < vertexCount) {
+            if (liveTriangles[cursor] > 0)
+                fanning = static_cast<int>(cursor);
+            cursor++;
+        }
+    }
+    indices.swap(output);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    const unsigned int unassigned = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), unassigned);
+    std::vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+
+    for (unsigned int& index : indices) {
+        if (remap[index] == unassigned) {
+            remap[index] = static_cast<unsigned int>(ordered.size());
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+MeshOptimizer::CacheStats MeshOptimizer::AnalyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount) {
+    CacheStats stats = { 0.0f, 0.0f };
+    if (indices.empty() || vertexCount == 0)
+        return stats;
+
+    // a vertex is in the FIFO while fewer than CACHE_SIZE misses happened since it was inserted
+    std::vector<size_t> insertedAt(vertexCount, 0);
+    std::vector<bool> used(vertexCount, false);
+    size_t misses = 0, unique = 0;
+    for (unsigned int index : indices) {
+        if (!used[index]) {
+            used[index] = true;
+            unique++;
+        }
+        if (insertedAt[index] == 0 || misses - insertedAt[index] >= CACHE_SIZE) {
+            misses++;
+            insertedAt[index] = misses;
+        }
+    }
+    stats.acmr = static_cast<float>(misses) / static_cast<float>(indices.size() / 3);
+    stats.atvr = static_cast<float>(misses) / static_cast<float>(unique);
+    return stats;
+}
@@ -0,0 +1,37 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <vector>
+#include "Mesh.h"
+
+// Post-import optimization passes for indexed triangle lists. Run in
+// order they weld duplicate vertices, reorder triangles for the
+// post-transform vertex cache (Tipsify, Sander et al. 2007) and reorder
+// vertices so they are fetched in the order the index buffer uses them.
+class MeshOptimizer {
+public:
+    // simulated FIFO post-transform cache size used by the passes and the statistics
+    static const unsigned int CACHE_SIZE = 16;
+
+    struct CacheStats {
+        // average cache miss ratio: transformed vertices per triangle, 0.5 is the ideal for large meshes
+        float acmr;
+        // average transform to vertex ratio: transformed vertices per unique vertex, 1.0 is the ideal
+        float atvr;
+    };
+
+    // runs all passes and logs the vertex count and cache statistics before and after
+    static void Optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+    // merges bitwise identical vertices and remaps the indices onto the survivors
+    static void WeldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+    // reorders triangles so consecutive ones share recently transformed vertices
+    static void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount);
+    // reorders vertices by first use in the index buffer and drops unreferenced ones
+    static void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+    // simulates a FIFO cache of CACHE_SIZE entries over the index buffer
+    static CacheStats AnalyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount);
+private:
+    MeshOptimizer() {}
+};
+
+#endif
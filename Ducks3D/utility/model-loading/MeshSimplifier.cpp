@@ -0,0 +1,291 @@
+#include "MeshSimplifier.h"
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include <unordered_map>
+
+#include "MeshOptimizer.h"
+
+namespace {
+    // levels stop once a pass keeps more than this share of the previous level's triangles
+    const float MIN_REDUCTION = 0.9f;
+    const size_t MIN_LOD_INDICES = 3 * 8;
+    // border quadrics outweigh surface ones so open edges barely move
+    const double BORDER_WEIGHT = 10.0;
+
+    // symmetric 4x4 matrix, stored as its upper triangle
+    struct Quadric {
+        double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+        Quadric() : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0) {}
+
+        void AddPlane(double a, double b, double c, double d, double weight) {
+            a2 += weight * a * a; ab += weight * a * b; ac += weight * a * c; ad += weight * a * d;
+            b2 += weight * b * b; bc += weight * b * c; bd += weight * b * d;
+            c2 += weight * c * c; cd += weight * c * d;
+            d2 += weight * d * d;
+        }
+
+        void Add(const Quadric& other) {
+            a2 += other.a2; ab += other.ab; ac += other.ac; ad += other.ad;
+            b2 += other.b2; bc += other.bc; bd += other.bd;
+            c2 += other.c2; cd += other.cd;
+            d2 += other.d2;
+        }
+
+        // weighted squared distance of p to the accumulated planes
+        double Error(const glm::vec3& p) const {
+            double x = p.x, y = p.y, z = p.z;
+            double error = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                + c2 * z * z + 2 * cd * z
+                + d2;
+            return std::max(error, 0.0);
+        }
+    };
+
+    struct PositionKey {
+        uint32_t bits[3];
+        bool operator==(const PositionKey& other) const { return std::memcmp(bits, other.bits, sizeof(bits)) == 0; }
+    };
+
+    struct PositionKeyHash {
+        size_t operator()(const PositionKey& key) const {
+            return (key.bits[0] * 73856093u) ^ (key.bits[1] * 19349663u) ^ (key.bits[2] * 83492791u);
+        }
+    };
+
+    struct Collapse {
+        // position groups, from is moved onto to
+        unsigned int from, to;
+        double cost;
+    };
+
+    // adds the plane of the triangle to q, unweighted so costs stay squared distances
+    void addTriangleQuadric(Quadric& q, const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2) {
+        glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+        float length = glm::length(normal);
+        if (length == 0.0f)
+            return;
+        normal /= length;
+        q.AddPlane(normal.x, normal.y, normal.z, -glm::dot(normal, p0), 1.0);
+    }
+}
+
+std::vector<unsigned int> MeshSimplifier::Simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+    size_t targetIndexCount, float& error) {
+    size_t vertexCount = vertices.size();
+    error = 0.0f;
+
+    // vertices sharing a position form a group, named after its first vertex
+    std::vector<unsigned int> group(vertexCount);
+    std::vector<std::vector<unsigned int>> members(vertexCount);
+    {
+        std::unordered_map<PositionKey, unsigned int, PositionKeyHash> firstAt;
+        firstAt.reserve(vertexCount);
+        for (unsigned int v = 0; v < vertexCount; v++) {
+            PositionKey key;
+            std::memcpy(key.bits, &vertices[v].Position, sizeof(key.bits));
+            auto inserted = firstAt.insert({ key, v });
+            group[v] = inserted.first->second;
+            members[group[v]].push_back(v);
+        }
+    }
+    auto position = [&](unsigned int g) -> const glm::vec3& { return vertices[g].Position; };
+
+    std::vector<Quadric> quadrics(vertexCount);
+    std::unordered_map<uint64_t, int> edgeUses;
+    auto edgeKey = [](unsigned int a, unsigned int b) { return a < b ? (uint64_t(a) << 32) | b : (uint64_t(b) << 32) | a; };
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        unsigned int g[3] = { group[indices[i]], group[indices[i + 1]], group[indices[i + 2]] };
+        Quadric q;
+        addTriangleQuadric(q, position(g[0]), position(g[1]), position(g[2]));
+        for (int c = 0; c < 3; c++) {
+            quadrics[g[c]].Add(q);
+            edgeUses[edgeKey(g[c], g[(c + 1) % 3])]++;
+        }
+    }
+    // an edge used by a single triangle is an open border, pin it with a plane through it perpendicular to the triangle
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        unsigned int g[3] = { group[indices[i]], group[indices[i + 1]], group[indices[i + 2]] };
+        glm::vec3 normal = glm::cross(position(g[1]) - position(g[0]), position(g[2]) - position(g[0]));
+        if (glm::length(normal) == 0.0f)
+            continue;
+        normal = glm::normalize(normal);
+        for (int c = 0; c < 3; c++) {
+            unsigned int a = g[c], b = g[(c + 1) % 3];
+            if (edgeUses[edgeKey(a, b)] != 1)
+                continue;
+            glm::vec3 edge = position(b) - position(a);
+            glm::vec3 side = glm::cross(edge, normal);
+            float length = glm::length(side);
+            if (length == 0.0f)
+                continue;
+            side /= length;
+            Quadric q;
+            q.AddPlane(side.x, side.y, side.z, -glm::dot(side, position(a)), BORDER_WEIGHT);
+            quadrics[a].Add(q);
+            quadrics[b].Add(q);
+        }
+    }
+
+    std::vector<unsigned int> result = indices;
+    std::vector<std::vector<unsigned int>> trianglesOf(vertexCount);
+    std::vector<Collapse> collapses;
+    std::vector<bool> locked(vertexCount);
+    std::vector<unsigned int> remap(vertexCount);
+    std::vector<unsigned int> target(vertexCount);
+    double maxCost = 0.0;
+
+    while (result.size() > targetIndexCount) {
+        // adjacency of the current triangles per group
+        for (std::vector<unsigned int>& triangles : trianglesOf)
+            triangles.clear();
+        collapses.clear();
+        for (unsigned int t = 0; t < result.size() / 3; t++) {
+            for (int c = 0; c < 3; c++)
+                trianglesOf[group[result[t * 3 + c]]].push_back(t);
+            for (int c = 0; c < 3; c++) {
+                unsigned int a = group[result[t * 3 + c]], b = group[result[t * 3 + (c + 1) % 3]];
+                if (a < b)
+                    collapses.push_back({ a, b, 0.0 });
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.from != y.from ? x.from < y.from : x.to < y.to; });
+        collapses.erase(std::unique(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.from == y.from && x.to == y.to; }), collapses.end());
+        // collapse each edge in its cheaper direction
+        for (Collapse& collapse : collapses) {
+            Quadric q = quadrics[collapse.from];
+            q.Add(quadrics[collapse.to]);
+            double toCost = q.Error(position(collapse.to));
+            double fromCost = q.Error(position(collapse.from));
+            if (fromCost < toCost)
+                std::swap(collapse.from, collapse.to);
+            collapse.cost = std::min(toCost, fromCost);
+        }
+        std::sort(collapses.begin(), collapses.end(), [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+        std::fill(locked.begin(), locked.end(), false);
+        for (unsigned int v = 0; v < vertexCount; v++)
+            remap[v] = v;
+        // every collapse removes the two triangles around its edge, so a pass needs about half as many
+        size_t trianglesToRemove = (result.size() - targetIndexCount + 2) / 3;
+        size_t removed = 0;
+        size_t applied = 0;
+        for (const Collapse& collapse : collapses) {
+            if (removed >= trianglesToRemove)
+                break;
+            if (locked[collapse.from] || locked[collapse.to])
+                continue;
+
+            // every vertex of the from group needs a neighbour in the to group to move onto, otherwise a seam would tear
+            for (unsigned int v : members[collapse.from])
+                target[v] = ~0u;
+            size_t shared = 0;
+            for (unsigned int t : trianglesOf[collapse.from]) {
+                bool hasTo = false;
+                for (int c = 0; c < 3; c++)
+                    hasTo |= group[result[t * 3 + c]] == collapse.to;
+                if (!hasTo)
+                    continue;
+                shared++;
+                for (int c = 0; c < 3; c++) {
+                    unsigned int v = result[t * 3 + c];
+                    if (group[v] != collapse.from)
+                        continue;
+                    for (int o = 0; o < 3; o++) {
+                        if (group[result[t * 3 + o]] == collapse.to)
+                            target[v] = result[t * 3 + o];
+                    }
+                }
+            }
+            bool valid = true;
+            for (unsigned int t : trianglesOf[collapse.from]) {
+                for (int c = 0; c < 3 && valid; c++) {
+                    unsigned int v = result[t * 3 + c];
+                    if (group[v] == collapse.from && target[v] == ~0u)
+                        valid = false;
+                }
+            }
+            // the triangles that survive must not turn over
+            for (unsigned int t : trianglesOf[collapse.from]) {
+                if (!valid)
+                    break;
+                glm::vec3 before[3], after[3];
+                bool hasTo = false;
+                for (int c = 0; c < 3; c++) {
+                    unsigned int g = group[result[t * 3 + c]];
+                    hasTo |= g == collapse.to;
+                    before[c] = position(g);
+                    after[c] = g == collapse.from ? position(collapse.to) : before[c];
+                }
+                if (hasTo)
+                    continue;
+                glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+                glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+                if (glm::dot(normalBefore, normalAfter) <= 0.0f)
+                    valid = false;
+            }
+            if (!valid)
+                continue;
+
+            for (unsigned int v : members[collapse.from]) {
+                if (target[v] != ~0u)
+                    remap[v] = target[v];
+            }
+            quadrics[collapse.to].Add(quadrics[collapse.from]);
+            // the neighbourhood changed, its collapses are re-evaluated next pass
+            for (unsigned int t : trianglesOf[collapse.from]) {
+                for (int c = 0; c < 3; c++)
+                    locked[group[result[t * 3 + c]]] = true;
+            }
+            maxCost = std::max(maxCost, collapse.cost);
+            removed += shared;
+            applied++;
+        }
+        if (applied == 0)
+            break;
+
+        // rewrite the triangles and drop the ones that collapsed to a line
+        size_t write = 0;
+        for (size_t i = 0; i + 2 < result.size(); i += 3) {
+            unsigned int a = remap[result[i]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+            if (group[a] == group[b] || group[b] == group[c] || group[c] == group[a])
+                continue;
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    // quadric costs are sums of squared distances to the original planes
+    error = static_cast<float>(std::sqrt(maxCost));
+    return result;
+}
+
+std::vector<MeshLod> MeshSimplifier::BuildLods(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    std::vector<MeshLod> lods;
+    std::vector<unsigned int> original = indices;
+    lods.push_back({ 0, static_cast<unsigned int>(indices.size()), 0.0f });
+    size_t previousCount = indices.size();
+    while (lods.size() < MAX_LODS) {
+        size_t target = (previousCount / 2) / 3 * 3;
+        if (target < MIN_LOD_INDICES)
+            break;
+        float error;
+        // each level starts from the original mesh, so its quadrics measure the deviation from it
+        std::vector<unsigned int> level = Simplify(vertices, original, target, error);
+        if (level.size() > previousCount * MIN_REDUCTION)
+            break;
+        MeshOptimizer::OptimizeVertexCache(level, vertices.size());
+        // coarser levels never claim to be more accurate than finer ones
+        error = std::max(error, lods.back().error);
+        lods.push_back({ static_cast<unsigned int>(indices.size()), static_cast<unsigned int>(level.size()), error });
+        indices.insert(indices.end(), level.begin(), level.end());
+        previousCount = level.size();
+    }
+    return lods;
+}
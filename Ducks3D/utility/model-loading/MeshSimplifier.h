@@ -0,0 +1,30 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <vector>
+#include "Mesh.h"
+
+// Quadric error mesh simplification (Garland and Heckbert 1997) by
+// half-edge collapses: a vertex is always moved onto one of its
+// neighbours, so the simplified meshes only rewrite the index buffer and
+// keep sharing the original vertices. Vertices at the same position
+// (texture seams) collapse together and only along edges that exist on
+// both sides of the seam; open borders are held in place by extra
+// quadrics and collapses that would flip a triangle are rejected.
+class MeshSimplifier {
+public:
+    // most levels BuildLods produces, level 0 included
+    static const unsigned int MAX_LODS = 5;
+
+    // simplifies indices towards targetIndexCount, stops early when no collapse is left.
+    // error receives the largest geometric deviation introduced, in model units
+    static std::vector<unsigned int> Simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+        size_t targetIndexCount, float& error);
+    // appends simplified levels, each with about half the triangles of the one before, to indices
+    // and returns the ranges of all levels, level 0 being the original indices
+    static std::vector<MeshLod> BuildLods(const std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+private:
+    MeshSimplifier() {}
+};
+
+#endif
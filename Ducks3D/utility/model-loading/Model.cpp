@@ -1,8 +1,13 @@
 #include "Model.h"
+#include "../rendering/StreamingBuffer.h"
 #include <iostream>
+#include <algorithm>
+#include <chrono>
 
-Model::Model(const std::string& path) {
-    loadModel(path);
+const float Model::LOD_HYSTERESIS = 0.2f;
+
+Model::Model(const std::string& path, bool useCache, bool objReader, JobSystem* jobs) {
+    loadModel(path, useCache, objReader, jobs);
 }
 
 void Model::Draw() {
@@ -10,18 +15,176 @@ void Model::Draw() {
         mesh.Draw();
 }
 
-void Model::loadModel(const std::string& path) {
-    Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path,
-        aiProcess_Triangulate | aiProcess_FlipUVs);
-
-    if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-        std::cerr << "Assimp Error: " << importer.GetErrorString() << std::endl;
+void Model::DrawInstanced(const std::vector<InstanceData>& instances) {
+    if (instances.empty())
         return;
+
+    uploadInstances(0, instances);
+    for (Mesh& mesh : meshes)
+        mesh.DrawInstanced(static_cast<unsigned int>(instances.size()), instanceVAOs[0]);
+}
+
+void Model::Submit(RenderQueue& queue, const DrawItem& material) {
+    DrawItem item = material;
+    item.indexed = true;
+    item.instanceCount = 0;
+    item.vao = GeometryPool::VertexArray();
+    for (Mesh& mesh : meshes) {
+        const GeometryRange& range = mesh.Range();
+        item.firstIndex = range.firstIndex;
+        item.baseVertex = static_cast<int>(range.baseVertex);
+        item.count = static_cast<GLsizei>(mesh.indexCount);
+        queue.Submit(item);
+    }
+}
+
+void Model::SubmitInstanced(RenderQueue& queue, const DrawItem& material, const std::vector<InstanceData>& instances) {
+    SubmitInstanced(queue, material, instances, std::vector<unsigned int>(instances.size(), 0));
+}
+
+void Model::SubmitInstanced(RenderQueue& queue, const DrawItem& material, const std::vector<InstanceData>& instances,
+    const std::vector<unsigned int>& levels) {
+    lodInstances.resize(LodCount());
+    for (std::vector<InstanceData>& group : lodInstances)
+        group.clear();
+    if (!lodInstances.empty()) {
+        for (size_t i = 0; i < instances.size(); i++)
+            lodInstances[std::min(levels[i], LodCount() - 1)].push_back(instances[i]);
+    }
+    SubmitLodGroups(queue, material, lodInstances);
+}
+
+void Model::SubmitLodGroups(RenderQueue& queue, const DrawItem& material, const std::vector<std::vector<InstanceData>>& groups) {
+    lodSubmitted.assign(LodCount(), 0);
+    DrawItem item = material;
+    item.indexed = true;
+    for (unsigned int level = 0; level < groups.size() && level < LodCount(); level++) {
+        if (groups[level].empty())
+            continue;
+        lodSubmitted[level] = groups[level].size();
+        uploadInstances(level, groups[level]);
+        item.instanceCount = static_cast<unsigned int>(groups[level].size());
+        item.vao = instanceVAOs[level];
+        for (Mesh& mesh : meshes) {
+            const MeshLod& lod = mesh.Lod(level);
+            const GeometryRange& range = mesh.Range();
+            item.firstIndex = range.firstIndex + lod.firstIndex;
+            item.baseVertex = static_cast<int>(range.baseVertex);
+            item.count = static_cast<GLsizei>(lod.indexCount);
+            queue.Submit(item);
+        }
+    }
+}
+
+void Model::AddLodGroups(DrawBatch& batch, const std::vector<std::vector<InstanceData>>& groups) {
+    lodSubmitted.assign(LodCount(), 0);
+    for (unsigned int level = 0; level < groups.size() && level < LodCount(); level++) {
+        if (groups[level].empty())
+            continue;
+        lodSubmitted[level] = groups[level].size();
+        unsigned int instanceCount = static_cast<unsigned int>(groups[level].size());
+        unsigned int firstInstance = batch.AddInstances(groups[level].data(), groups[level].size());
+        for (Mesh& mesh : meshes)
+            batch.AddDraw(mesh.Range(), mesh.Lod(level), firstInstance, instanceCount);
+    }
+}
+
+unsigned int Model::SelectLod(float pixelsPerUnit, unsigned int previous, float threshold) const {
+    if (lodErrors.empty())
+        return 0;
+
+    unsigned int coarsest = LodCount() - 1;
+    unsigned int level = std::min(previous, coarsest);
+    while (level > 0 && lodErrors[level] * pixelsPerUnit > threshold)
+        level--;
+    while (level < coarsest && lodErrors[level + 1] * pixelsPerUnit < threshold * (1.0f - LOD_HYSTERESIS))
+        level++;
+    return level;
+}
+
+void Model::Release() {
+    for (Mesh& mesh : meshes)
+        mesh.Release();
+    meshes.clear();
+    for (unsigned int vao : instanceVAOs)
+        GeometryPool::DeleteVertexArray(vao);
+    instanceVAOs.clear();
+    if (!instanceVBOs.empty())
+        glDeleteBuffers(static_cast<GLsizei>(instanceVBOs.size()), instanceVBOs.data());
+    instanceVBOs.clear();
+    instanceCapacities.clear();
+    lodInstances.clear();
+    lodSubmitted.clear();
+}
+
+void Model::uploadInstances(unsigned int level, const std::vector<InstanceData>& instances) {
+    if (instanceVBOs.empty()) {
+        // GL 3.3 has no base instance, so each level streams its instances through a buffer of its own
+        instanceVBOs.resize(std::max(LodCount(), 1u));
+        instanceCapacities.assign(instanceVBOs.size(), 0);
+        glGenBuffers(static_cast<GLsizei>(instanceVBOs.size()), instanceVBOs.data());
+        // every mesh lives in the pool's buffers, so one vertex array per level serves all of them
+        for (unsigned int instanceVBO : instanceVBOs)
+            instanceVAOs.push_back(GeometryPool::CreateInstancedVertexArray(instanceVBO));
+    }
+
+    StreamingBuffer::Upload(GL_ARRAY_BUFFER, instanceVBOs[level], instanceCapacities[level], instances.data(),
+        instances.size() * sizeof(InstanceData));
+}
+
+void Model::computeLodErrors() {
+    size_t count = 0;
+    for (const Mesh& mesh : meshes)
+        count = std::max(count, mesh.lods.size());
+    lodErrors.assign(count, 0.0f);
+    for (const Mesh& mesh : meshes) {
+        for (unsigned int level = 0; level < count; level++)
+            lodErrors[level] = std::max(lodErrors[level], mesh.Lod(level).error);
     }
+}
 
+void Model::loadModel(const std::string& path, bool useCache, bool objReader, JobSystem* jobs) {
+    auto start = std::chrono::steady_clock::now();
     directory = path.substr(0, path.find_last_of('/'));
-    processNode(scene->mRootNode, scene);
+
+    if (useCache && MeshCache::Load(path, meshes)) {
+        for (const Mesh& mesh : meshes)
+            bounds.Expand(mesh.bounds);
+        computeLodErrors();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "Model: loaded " << path << " from mesh cache in " << elapsed.count() << " ms" << std::endl;
+        return;
+    }
+
+    // Assimp remains the fallback for OBJ features the reader rejects
+    std::vector<ObjReader::Group> groups;
+    const char* importerName = "ObjReader";
+    if (objReader && ObjReader::CanRead(path) && ObjReader::Read(path, groups, jobs)) {
+        for (ObjReader::Group& group : groups)
+            meshes.push_back(buildMesh(std::move(group.vertices), std::move(group.indices)));
+    }
+    else {
+        importerName = "Assimp";
+        Assimp::Importer importer;
+        const aiScene* scene = importer.ReadFile(path,
+            aiProcess_Triangulate | aiProcess_FlipUVs);
+
+        if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
+            std::cerr << "Assimp Error: " << importer.GetErrorString() << std::endl;
+            return;
+        }
+
+        processNode(scene->mRootNode, scene);
+    }
+    for (const Mesh& mesh : meshes)
+        bounds.Expand(mesh.bounds);
+    computeLodErrors();
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    std::cout << "Model: imported " << path << " through " << importerName << " in " << elapsed.count() << " ms" << std::endl;
+
+    if (useCache && !MeshCache::Write(path, meshes))
+        std::cerr << "Model: failed to write mesh cache " << MeshCache::PathFor(path) << std::endl;
 }
 
 void Model::processNode(aiNode* node, const aiScene* scene) {
@@ -38,6 +201,8 @@ void Model::processNode(aiNode* node, const aiScene* scene) {
 Mesh Model::processMesh(aiMesh* mesh) {
     std::vector<Vertex> vertices;
     std::vector<unsigned int> indices;
+    vertices.reserve(mesh->mNumVertices);
+    indices.reserve(mesh->mNumFaces * 3);
 
     for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
         Vertex vertex;
@@ -66,5 +231,14 @@ Mesh Model::processMesh(aiMesh* mesh) {
             indices.push_back(face.mIndices[j]);
     }
 
-    return Mesh(vertices, indices);
+    return buildMesh(std::move(vertices), std::move(indices));
+}
+
+Mesh Model::buildMesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices) {
+    // importers such as Assimp's OBJ one emit a unique vertex per face corner, weld and reorder for the vertex stage
+    MeshOptimizer::Optimize(vertices, indices);
+    // coarser levels are appended to the index buffer and share the welded vertices
+    std::vector<MeshLod> lods = MeshSimplifier::BuildLods(vertices, indices);
+
+    return Mesh(std::move(vertices), std::move(indices), std::move(lods));
 }
\ No newline at end of file
@@ -7,19 +7,79 @@
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include "Mesh.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ObjReader.h"
 #include "../ResourceManager.h"
+#include "../rendering/RenderQueue.h"
+#include "../rendering/DrawBatch.h"
 
 class Model {
 public:
-    Model(const std::string& path);
+    // a coarser level is only taken once its error is this much below the threshold
+    static const float LOD_HYSTERESIS;
+
+    // loads from the binary mesh cache next to path when it is up to date, otherwise imports
+    // and (re)writes the cache. useCache = false always imports and leaves the cache alone.
+    // OBJ files are imported through ObjReader unless objReader is false, everything else through Assimp.
+    // ObjReader parses on jobs when given, on the calling thread otherwise
+    Model(const std::string& path, bool useCache = true, bool objReader = true, JobSystem* jobs = nullptr);
     void Draw();
+    // draws every mesh once per instance, one draw call per mesh regardless of the instance count
+    void DrawInstanced(const std::vector<InstanceData>& instances);
+    // queues one draw per mesh, material supplies everything but the geometry
+    void Submit(RenderQueue& queue, const DrawItem& material);
+    // uploads the instances right away and queues one instanced draw per mesh,
+    // the instance buffer is shared so a model can only be submitted instanced once per frame
+    void SubmitInstanced(RenderQueue& queue, const DrawItem& material, const std::vector<InstanceData>& instances);
+    // as above with a level of detail per instance, instances are grouped by level and every
+    // level in use gets one instanced draw per mesh
+    void SubmitInstanced(RenderQueue& queue, const DrawItem& material, const std::vector<InstanceData>& instances,
+        const std::vector<unsigned int>& levels);
+    // as above with the instances already grouped, groups[level] holds the instances drawn at level
+    void SubmitLodGroups(RenderQueue& queue, const DrawItem& material, const std::vector<std::vector<InstanceData>>& groups);
+    // adds the groups to batch instead, one draw per mesh and level in use that share the level's instances
+    void AddLodGroups(DrawBatch& batch, const std::vector<std::vector<InstanceData>>& groups);
+    // number of levels of detail, the most any of the meshes has
+    unsigned int LodCount() const { return static_cast<unsigned int>(lodErrors.size()); }
+    // largest deviation of a level from the full detail model, in model units
+    float LodError(unsigned int level) const { return lodErrors[level]; }
+    // picks the coarsest level whose error covers at most threshold pixels when a model unit
+    // covers pixelsPerUnit pixels. Starting from previous, a coarser level is only taken once its
+    // error is clearly below the threshold, so instances near a switching distance don't flicker
+    unsigned int SelectLod(float pixelsPerUnit, unsigned int previous, float threshold) const;
+    // instances drawn at level by the last SubmitInstanced or AddLodGroups
+    size_t SubmittedAtLod(unsigned int level) const { return level < lodSubmitted.size() ? lodSubmitted[level] : 0; }
+    // model space box around all meshes
+    const AABB& Bounds() const { return bounds; }
+    const std::vector<Mesh>& Meshes() const { return meshes; }
+    // frees the meshes' pool ranges and deletes the instance buffers and their vertex arrays
+    void Release();
 
 private:
     std::vector<Mesh> meshes;
     std::string directory;
-    void loadModel(const std::string& path);
+    AABB bounds;
+    // max over the meshes per level
+    std::vector<float> lodErrors;
+    // dynamic per-instance buffers shared by all meshes, one per level of detail, grown on demand
+    std::vector<unsigned int> instanceVBOs;
+    // their sizes in bytes
+    std::vector<size_t> instanceCapacities;
+    // the pool's geometry plus one of the instance buffers, shared by all meshes
+    std::vector<unsigned int> instanceVAOs;
+    // grouping scratch of SubmitInstanced
+    std::vector<std::vector<InstanceData>> lodInstances;
+    // instances per level of the last submission
+    std::vector<size_t> lodSubmitted;
+    void uploadInstances(unsigned int level, const std::vector<InstanceData>& instances);
+    void computeLodErrors();
+    void loadModel(const std::string& path, bool useCache, bool objReader, JobSystem* jobs);
     void processNode(aiNode* node, const aiScene* scene);
     Mesh processMesh(aiMesh* mesh);
+    // optimizes imported geometry and builds its levels of detail
+    Mesh buildMesh(std::vector<Vertex> vertices, std::vector<unsigned int> indices);
 };
 
 #endif
@@ -0,0 +1,473 @@
+#include "ObjReader.h"
+
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <climits>
+#include <iostream>
+#include <algorithm>
+#include <unordered_map>
+
+#include "../io/MappedFile.h"
+
+namespace {
+    // a chunk smaller than this isn't worth a job
+    const size_t MIN_CHUNK_BYTES = 256 * 1024;
+    // texture coordinate of a corner without one
+    const int NO_INDEX = INT_MIN;
+    // corner indices that count from the start of their chunk rather than of the file
+    const unsigned char POSITION_LOCAL = 1;
+    const unsigned char TEXCOORD_LOCAL = 2;
+    // significant digits that still fit a 64-bit mantissa
+    const int MAX_DIGITS = 19;
+    // value of an unused WeldTable slot
+    const unsigned int EMPTY_SLOT = 0xFFFFFFFFu;
+
+    const double POWERS_OF_TEN[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    struct Corner {
+        int position;
+        int texCoord;
+        unsigned char flags;
+    };
+
+    // a usemtl line, taking effect at the chunk's corner with that index
+    struct MaterialSwitch {
+        size_t corner;
+        std::string name;
+    };
+
+    struct Chunk {
+        const char* begin;
+        const char* end;
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec2> texCoords;
+        size_t normals = 0;
+        // three per triangle
+        std::vector<Corner> corners;
+        std::vector<MaterialSwitch> materials;
+        // set on the first malformed line
+        const char* error = nullptr;
+        // positions and texture coordinates of the chunks before this one
+        size_t positionOffset = 0;
+        size_t texCoordOffset = 0;
+    };
+
+    // position/texture coordinate pair -> vertex, open addressing with linear probing
+    class WeldTable {
+    public:
+        WeldTable() : count(0) { resize(64); }
+
+        // the vertex of key, or vertex if key is new
+        unsigned int Insert(uint64_t key, unsigned int vertex) {
+            if ((count + 1) * 2 > keys.size())
+                resize(keys.size() * 2);
+            size_t mask = keys.size() - 1;
+            for (size_t slot = hash(key) & mask;; slot = (slot + 1) & mask) {
+                if (values[slot] == EMPTY_SLOT) {
+                    keys[slot] = key;
+                    values[slot] = vertex;
+                    count++;
+                    return vertex;
+                }
+                if (keys[slot] == key)
+                    return values[slot];
+            }
+        }
+    private:
+        std::vector<uint64_t> keys;
+        std::vector<unsigned int> values;
+        size_t count;
+
+        static size_t hash(uint64_t key) {
+            key ^= key >> 33;
+            key *= 0xFF51AFD7ED558CCDull;
+            key ^= key >> 33;
+            return static_cast<size_t>(key);
+        }
+
+        void resize(size_t size) {
+            std::vector<uint64_t> oldKeys(size);
+            std::vector<unsigned int> oldValues(size, EMPTY_SLOT);
+            oldKeys.swap(keys);
+            oldValues.swap(values);
+            count = 0;
+            for (size_t i = 0; i < oldValues.size(); i++) {
+                if (oldValues[i] != EMPTY_SLOT)
+                    Insert(oldKeys[i], oldValues[i]);
+            }
+        }
+    };
+
+    inline bool isBlank(char c) {
+        return c == ' ' || c == '\t' || c == '\r';
+    }
+
+    inline bool isDigit(char c) {
+        return static_cast<unsigned char>(c - '0') < 10;
+    }
+
+    inline const char* skipBlanks(const char* p, const char* end) {
+        while (p < end && isBlank(*p))
+            p++;
+        return p;
+    }
+
+    // true if the 8 bytes at p are all digits, in which case value is their number. SWAR: all
+    // digits are checked and combined in a few 64-bit operations, assuming a little-endian CPU
+    inline bool parseEightDigits(const char* p, uint32_t& value) {
+        uint64_t chunk;
+        std::memcpy(&chunk, p, sizeof(chunk));
+        if (((chunk & 0xF0F0F0F0F0F0F0F0ull) | (((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) != 0x3333333333333333ull)
+            return false;
+        chunk -= 0x3030303030303030ull;
+        // pairs of digits, then quadruples, then all eight
+        chunk = chunk * 10 + (chunk >> 8);
+        chunk = ((chunk & 0x000000FF000000FFull) * (100 + (1000000ull << 32))
+            + ((chunk >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32))) >> 32;
+        value = static_cast<uint32_t>(chunk);
+        return true;
+    }
+
+    // appends the digits at p to mantissa, digits beyond MAX_DIGITS only move the decimal exponent
+    // when they are left of the point (integer) and are dropped right of it
+    inline const char* parseDigits(const char* p, const char* end, bool integer, uint64_t& mantissa, int& digits, int& exponent) {
+        uint32_t eight;
+        while (end - p >= 8 && digits + 8 <= MAX_DIGITS && parseEightDigits(p, eight)) {
+            mantissa = mantissa * 100000000ull + eight;
+            // leading zeros aren't significant
+            if (mantissa != 0)
+                digits += 8;
+            if (!integer)
+                exponent -= 8;
+            p += 8;
+        }
+        for (; p < end && isDigit(*p); p++) {
+            if (digits < MAX_DIGITS) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa != 0)
+                    digits++;
+                if (!integer)
+                    exponent--;
+            }
+            else if (integer) {
+                exponent++;
+            }
+        }
+        return p;
+    }
+
+    // parses a face index, nullptr if there are no digits
+    inline const char* parseIndex(const char* p, const char* end, int& index) {
+        bool negative = p < end && *p == '-';
+        if (negative)
+            p++;
+        long long value = 0;
+        const char* digitsStart = p;
+        for (; p < end && isDigit(*p); p++) {
+            value = value * 10 + (*p - '0');
+            if (value > INT_MAX)
+                return nullptr;
+        }
+        if (p == digitsStart)
+            return nullptr;
+        index = static_cast<int>(negative ? -value : value);
+        return p;
+    }
+
+    // makes a 1-based or negative OBJ index zero-based, counting negative ones back from the
+    // chunk's current element count
+    inline bool resolveIndex(int index, size_t chunkCount, int& resolved, bool& local) {
+        if (index > 0) {
+            resolved = index - 1;
+            local = false;
+            return true;
+        }
+        if (index < 0) {
+            resolved = static_cast<int>(static_cast<long long>(chunkCount) + index);
+            local = true;
+            return true;
+        }
+        return false;
+    }
+
+    // parses count floats separated by blanks into values, at least required of them
+    inline const char* parseFloats(const char* p, const char* end, float* values, int count, int required) {
+        for (int i = 0; i < count; i++) {
+            p = skipBlanks(p, end);
+            if (p == end && i >= required)
+                return p;
+            p = ObjReader::ParseFloat(p, end, values[i]);
+            if (!p || (p < end && !isBlank(*p)))
+                return nullptr;
+        }
+        return p;
+    }
+
+    void parseFace(Chunk& chunk, const char* p, const char* end, std::vector<Corner>& polygon) {
+        polygon.clear();
+        while (true) {
+            p = skipBlanks(p, end);
+            if (p == end)
+                break;
+            // v, v/vt, v//vn or v/vt/vn
+            int position = 0, texCoord = 0, normal = 0;
+            p = parseIndex(p, end, position);
+            if (p && p < end && *p == '/') {
+                p++;
+                if (p < end && *p != '/')
+                    p = parseIndex(p, end, texCoord);
+                if (p && p < end && *p == '/')
+                    p = parseIndex(p + 1, end, normal);
+            }
+            Corner corner;
+            bool local = false;
+            if (!p || (p < end && !isBlank(*p)) || !resolveIndex(position, chunk.positions.size(), corner.position, local)) {
+                chunk.error = "malformed face";
+                return;
+            }
+            corner.flags = local ? POSITION_LOCAL : 0;
+            corner.texCoord = NO_INDEX;
+            if (texCoord != 0) {
+                resolveIndex(texCoord, chunk.texCoords.size(), corner.texCoord, local);
+                if (local)
+                    corner.flags |= TEXCOORD_LOCAL;
+            }
+            polygon.push_back(corner);
+        }
+        if (polygon.size() < 3) {
+            // lines and points have no triangles to draw
+            return;
+        }
+        for (size_t i = 1; i + 1 < polygon.size(); i++) {
+            chunk.corners.push_back(polygon[0]);
+            chunk.corners.push_back(polygon[i]);
+            chunk.corners.push_back(polygon[i + 1]);
+        }
+    }
+
+    void parseChunk(Chunk& chunk) {
+        std::vector<Corner> polygon;
+        const char* p = chunk.begin;
+        while (p < chunk.end && !chunk.error) {
+            const char* lineEnd = static_cast<const char*>(std::memchr(p, '\n', chunk.end - p));
+            if (!lineEnd)
+                lineEnd = chunk.end;
+            p = skipBlanks(p, lineEnd);
+            size_t length = lineEnd - p;
+            float values[3];
+            if (length >= 2 && p[0] == 'v' && isBlank(p[1])) {
+                if (!parseFloats(p + 2, lineEnd, values, 3, 3))
+                    chunk.error = "malformed vertex position";
+                else
+                    chunk.positions.push_back(glm::vec3(values[0], values[1], values[2]));
+            }
+            else if (length >= 3 && p[0] == 'v' && p[1] == 't' && isBlank(p[2])) {
+                values[1] = 0.0f;
+                if (!parseFloats(p + 3, lineEnd, values, 2, 1))
+                    chunk.error = "malformed texture coordinate";
+                else
+                    chunk.texCoords.push_back(glm::vec2(values[0], 1.0f - values[1]));
+            }
+            else if (length >= 3 && p[0] == 'v' && p[1] == 'n' && isBlank(p[2])) {
+                if (!parseFloats(p + 3, lineEnd, values, 3, 3))
+                    chunk.error = "malformed normal";
+                else
+                    chunk.normals++;
+            }
+            else if (length >= 2 && p[0] == 'f' && isBlank(p[1])) {
+                parseFace(chunk, p + 2, lineEnd, polygon);
+            }
+            else if (length >= 7 && std::memcmp(p, "usemtl", 6) == 0 && isBlank(p[6])) {
+                const char* name = skipBlanks(p + 7, lineEnd);
+                const char* nameEnd = lineEnd;
+                while (nameEnd > name && isBlank(nameEnd[-1]))
+                    nameEnd--;
+                chunk.materials.push_back(MaterialSwitch{ chunk.corners.size(), std::string(name, nameEnd) });
+            }
+            // comments, objects, groups, smoothing groups, mtllib, lines and points carry nothing we draw
+            p = lineEnd < chunk.end ? lineEnd + 1 : chunk.end;
+        }
+    }
+}
+
+bool ObjReader::CanRead(const std::string& path) {
+    if (path.size() < 4)
+        return false;
+    std::string extension = path.substr(path.size() - 4);
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension == ".obj";
+}
+
+const char* ObjReader::ParseFloat(const char* text, const char* end, float& value) {
+    const char* p = text;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    uint64_t mantissa = 0;
+    int digits = 0, exponent = 0;
+    const char* integerStart = p;
+    p = parseDigits(p, end, true, mantissa, digits, exponent);
+    bool any = p != integerStart;
+    if (p < end && *p == '.') {
+        const char* fractionStart = ++p;
+        p = parseDigits(p, end, false, mantissa, digits, exponent);
+        any = any || p != fractionStart;
+    }
+    if (!any)
+        return nullptr;
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        // only an exponent with digits belongs to the number
+        const char* q = p + 1;
+        bool negativeExponent = q < end && *q == '-';
+        if (q < end && (*q == '-' || *q == '+'))
+            q++;
+        if (q < end && isDigit(*q)) {
+            int written = 0;
+            for (; q < end && isDigit(*q); q++) {
+                if (written < 100000)
+                    written = written * 10 + (*q - '0');
+            }
+            exponent += negativeExponent ? -written : written;
+            p = q;
+        }
+    }
+
+    double result;
+    if (mantissa == 0) {
+        result = 0.0;
+    }
+    else if (exponent >= -22 && exponent <= 22) {
+        // the powers are exact, so this is one rounding of the (up to 19 digit) mantissa and one of the product
+        result = static_cast<double>(mantissa);
+        result = exponent < 0 ? result / POWERS_OF_TEN[-exponent] : result * POWERS_OF_TEN[exponent];
+    }
+    else {
+        // far out of a float's range, or denormal: rare enough for the C library
+        std::string copy(text, p);
+        result = std::abs(std::strtod(copy.c_str(), nullptr));
+    }
+    value = static_cast<float>(negative ? -result : result);
+    return p;
+}
+
+bool ObjReader::Read(const std::string& path, std::vector<Group>& groups, JobSystem* jobs) {
+    groups.clear();
+    MappedFile file;
+    if (!file.Open(path)) {
+        std::cerr << "ObjReader: failed to open " << path << std::endl;
+        return false;
+    }
+    const char* data = reinterpret_cast<const char*>(file.Data());
+    const char* dataEnd = data + file.Size();
+
+    unsigned int threads = jobs ? jobs->ThreadCount() : 1;
+    size_t chunkCount = std::max<size_t>(1, std::min<size_t>(threads, file.Size() / MIN_CHUNK_BYTES));
+    std::vector<Chunk> chunks(chunkCount);
+    const char* begin = data;
+    for (size_t i = 0; i < chunkCount; i++) {
+        // every chunk but the last ends after the first line break past its share of the file
+        const char* end = dataEnd;
+        if (i + 1 < chunkCount) {
+            end = std::max(begin, data + file.Size() * (i + 1) / chunkCount);
+            const char* lineBreak = static_cast<const char*>(std::memchr(end, '\n', dataEnd - end));
+            end = lineBreak ? lineBreak + 1 : dataEnd;
+        }
+        chunks[i].begin = begin;
+        chunks[i].end = end;
+        begin = end;
+    }
+
+    if (jobs) {
+        jobs->ParallelFor(chunkCount, 1, [&chunks](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+                parseChunk(chunks[i]);
+        });
+    }
+    else
+        parseChunk(chunks[0]);
+
+    size_t positionCount = 0, texCoordCount = 0;
+    for (Chunk& chunk : chunks) {
+        if (chunk.error) {
+            std::cerr << "ObjReader: " << chunk.error << " in " << path << std::endl;
+            return false;
+        }
+        chunk.positionOffset = positionCount;
+        chunk.texCoordOffset = texCoordCount;
+        positionCount += chunk.positions.size();
+        texCoordCount += chunk.texCoords.size();
+    }
+    if (positionCount > INT_MAX || texCoordCount > INT_MAX) {
+        std::cerr << "ObjReader: too many vertices in " << path << std::endl;
+        return false;
+    }
+    std::vector<glm::vec3> positions;
+    std::vector<glm::vec2> texCoords;
+    positions.reserve(positionCount);
+    texCoords.reserve(texCoordCount);
+    for (const Chunk& chunk : chunks) {
+        positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+        texCoords.insert(texCoords.end(), chunk.texCoords.begin(), chunk.texCoords.end());
+    }
+
+    // a group is created by the first face using its material, faces before the first usemtl go
+    // to a group without material
+    std::unordered_map<std::string, size_t> groupIndices;
+    std::vector<WeldTable> welds;
+    const std::string noMaterial;
+    const std::string* material = &noMaterial;
+    size_t current = SIZE_MAX;
+    for (const Chunk& chunk : chunks) {
+        size_t nextSwitch = 0;
+        for (size_t i = 0; i < chunk.corners.size(); i++) {
+            while (nextSwitch < chunk.materials.size() && chunk.materials[nextSwitch].corner == i) {
+                material = &chunk.materials[nextSwitch++].name;
+                current = SIZE_MAX;
+            }
+            if (current == SIZE_MAX) {
+                auto inserted = groupIndices.emplace(*material, groups.size());
+                if (inserted.second) {
+                    groups.push_back(Group());
+                    groups.back().material = *material;
+                    welds.emplace_back();
+                }
+                current = inserted.first->second;
+            }
+
+            const Corner& corner = chunk.corners[i];
+            long long position = corner.position + static_cast<long long>(corner.flags & POSITION_LOCAL ? chunk.positionOffset : 0);
+            long long texCoord = -1;
+            if (corner.texCoord != NO_INDEX)
+                texCoord = corner.texCoord + static_cast<long long>(corner.flags & TEXCOORD_LOCAL ? chunk.texCoordOffset : 0);
+            if (position < 0 || position >= static_cast<long long>(positionCount) || texCoord < -1 || texCoord >= static_cast<long long>(texCoordCount)) {
+                std::cerr << "ObjReader: face index out of range in " << path << std::endl;
+                groups.clear();
+                return false;
+            }
+
+            Group& group = groups[current];
+            uint64_t key = (static_cast<uint64_t>(position) << 32) | static_cast<uint32_t>(texCoord + 1);
+            unsigned int vertex = welds[current].Insert(key, static_cast<unsigned int>(group.vertices.size()));
+            if (vertex == group.vertices.size()) {
+                Vertex welded;
+                welded.Position = positions[position];
+                welded.TexCoords = texCoord >= 0 ? texCoords[texCoord] : glm::vec2(0.0f, 0.0f);
+                group.vertices.push_back(welded);
+            }
+            group.indices.push_back(vertex);
+        }
+        // a usemtl after the chunk's last face applies to the next chunk
+        if (nextSwitch < chunk.materials.size()) {
+            material = &chunk.materials.back().name;
+            current = SIZE_MAX;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,38 @@
+#ifndef OBJ_READER_H
+#define OBJ_READER_H
+
+#include <string>
+#include <vector>
+#include "Mesh.h"
+#include "../jobs/JobSystem.h"
+
+// Wavefront OBJ reader for the scene's triangle meshes, used instead of
+// Assimp's importer. The file is memory mapped and cut at line
+// boundaries into chunks that are parsed as jobs of their own. The
+// chunks are then stitched together in file order: relative indices are
+// resolved, polygons fan triangulated and every distinct pair of
+// position and texture coordinate becomes one vertex. Faces are grouped
+// into one mesh per material (usemtl) in order of first use. Normals are
+// parsed but not kept since Vertex has none, and texture coordinates are
+// flipped vertically like Assimp's aiProcess_FlipUVs does.
+class ObjReader {
+public:
+    struct Group {
+        std::string material;
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+    };
+
+    // true for paths ending in .obj, in any case
+    static bool CanRead(const std::string& path);
+    // parses path into groups, in one chunk per thread of jobs or on the calling thread alone if jobs is null.
+    // Fails with a message on stderr
+    static bool Read(const std::string& path, std::vector<Group>& groups, JobSystem* jobs = nullptr);
+    // parses a decimal float starting at text and ending before end, returns where it stopped or nullptr
+    // if there is no number. Correctly rounded unless the value lies within a double ulp of halfway between two floats
+    static const char* ParseFloat(const char* text, const char* end, float& value);
+private:
+    ObjReader() {}
+};
+
+#endif
@@ -0,0 +1,215 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+
+Profiler::Profiler()
+    : epoch(std::chrono::steady_clock::now()), frameNumber(0), droppedFrames(0), activePass(-1), blocking(false) {
+    for (FrameSlot& slot : frames) {
+        slot.frame = 0;
+        slot.pending = false;
+    }
+}
+
+void Profiler::Release() {
+    for (FrameSlot& slot : frames) {
+        if (!slot.queries.empty())
+            glDeleteQueries(static_cast<GLsizei>(slot.queries.size()), slot.queries.data());
+        slot.queries.clear();
+        slot.passes.clear();
+        slot.pending = false;
+    }
+}
+
+void Profiler::BeginFrame() {
+    FrameSlot& slot = frames[frameNumber % FRAME_LATENCY];
+    if (slot.pending)
+        resolve(slot, this->blocking);
+    slot.frame = frameNumber;
+    slot.passes.clear();
+}
+
+void Profiler::EndFrame() {
+    FrameSlot& slot = frames[frameNumber % FRAME_LATENCY];
+    slot.pending = !slot.passes.empty();
+    frameNumber++;
+}
+
+void Profiler::BeginPass(const char* name) {
+    FrameSlot& slot = frames[frameNumber % FRAME_LATENCY];
+    PassRecord record;
+    record.pass = passIndex(name);
+    record.cpuStart = now();
+    record.cpuEnd = record.cpuStart;
+    if (slot.passes.size() == slot.queries.size()) {
+        unsigned int query;
+        glGenQueries(1, &query);
+        slot.queries.push_back(query);
+    }
+    slot.passes.push_back(record);
+    this->activePass = record.pass;
+    glBeginQuery(GL_TIME_ELAPSED, slot.queries[slot.passes.size() - 1]);
+}
+
+void Profiler::EndPass() {
+    if (this->activePass < 0)
+        return;
+    glEndQuery(GL_TIME_ELAPSED);
+    frames[frameNumber % FRAME_LATENCY].passes.back().cpuEnd = now();
+    this->activePass = -1;
+}
+
+void Profiler::SetCounter(const char* name, double value) {
+    size_t index = 0;
+    while (index < counters.size() && counters[index].name != name && std::strcmp(counters[index].name, name) != 0)
+        index++;
+    if (index == counters.size()) {
+        Counter counter = { name, value };
+        counters.push_back(counter);
+    }
+    counters[index].value = value;
+    TraceEvent event = { static_cast<int>(index), TRACE_COUNTER, now(), value };
+    pushTrace(event);
+}
+
+void Profiler::Flush() {
+    // oldest first, so finished frames stay in order
+    for (int i = 0; i < FRAME_LATENCY; i++) {
+        FrameSlot& slot = frames[(frameNumber + i) % FRAME_LATENCY];
+        if (slot.pending)
+            resolve(slot, true);
+    }
+}
+
+bool Profiler::PopFrameTiming(FrameTiming& timing) {
+    if (finished.empty())
+        return false;
+    timing = finished.front();
+    finished.pop_front();
+    return true;
+}
+
+std::vector<Profiler::PassStats> Profiler::Stats() const {
+    std::vector<PassStats> stats;
+    std::vector<double> sorted;
+    for (const PassHistory& history : passes) {
+        PassStats pass;
+        pass.name = history.name;
+        double* fields[2][3] = {
+            { &pass.cpuMin, &pass.cpuAvg, &pass.cpuP99 },
+            { &pass.gpuMin, &pass.gpuAvg, &pass.gpuP99 }
+        };
+        const std::vector<double>* samples[2] = { &history.cpu, &history.gpu };
+        for (int i = 0; i < 2; i++) {
+            sorted.assign(samples[i]->begin(), samples[i]->begin() + history.count);
+            if (sorted.empty()) {
+                *fields[i][0] = *fields[i][1] = *fields[i][2] = 0.0;
+                continue;
+            }
+            std::sort(sorted.begin(), sorted.end());
+            double sum = 0.0;
+            for (double sample : sorted)
+                sum += sample;
+            *fields[i][0] = sorted.front();
+            *fields[i][1] = sum / sorted.size();
+            *fields[i][2] = sorted[std::min(sorted.size() - 1, sorted.size() * 99 / 100)];
+        }
+        stats.push_back(pass);
+    }
+    return stats;
+}
+
+bool Profiler::ExportChromeTrace(const std::string& path) const {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file)
+        return false;
+    // GPU durations come from elapsed-time queries and carry no timestamps of their
+    // own, so they are placed at the CPU submission time of their pass on a second track
+    std::fprintf(file, "{\"traceEvents\":[\n");
+    std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n");
+    std::fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+    for (const TraceEvent& event : trace) {
+        if (event.kind == TRACE_COUNTER) {
+            std::fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"value\":%g}}",
+                counters[event.index].name, event.start, event.duration);
+            continue;
+        }
+        bool gpu = event.kind == TRACE_GPU;
+        std::fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+            passes[event.index].name, gpu ? "gpu" : "cpu", gpu ? 2 : 1, event.start, event.duration);
+    }
+    std::fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    return std::fclose(file) == 0;
+}
+
+double Profiler::now() const {
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - this->epoch).count();
+}
+
+int Profiler::passIndex(const char* name) {
+    for (size_t i = 0; i < passes.size(); i++) {
+        if (passes[i].name == name || std::strcmp(passes[i].name, name) == 0)
+            return static_cast<int>(i);
+    }
+    PassHistory history;
+    history.name = name;
+    history.cpu.assign(HISTORY, 0.0);
+    history.gpu.assign(HISTORY, 0.0);
+    history.next = history.count = 0;
+    passes.push_back(history);
+    return static_cast<int>(passes.size() - 1);
+}
+
+void Profiler::resolve(FrameSlot& slot, bool wait) {
+    slot.pending = false;
+    if (!wait) {
+        // queries finish in submission order, so the last one being ready covers the frame
+        GLint available = 0;
+        glGetQueryObjectiv(slot.queries[slot.passes.size() - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            this->droppedFrames++;
+            return;
+        }
+    }
+
+    FrameTiming timing = { slot.frame, 0.0, 0.0 };
+    frameCpu.assign(passes.size(), -1.0);
+    frameGpu.assign(passes.size(), 0.0);
+    for (size_t i = 0; i < slot.passes.size(); i++) {
+        const PassRecord& record = slot.passes[i];
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(slot.queries[i], GL_QUERY_RESULT, &nanoseconds);
+        double cpu = (record.cpuEnd - record.cpuStart) / 1000.0;
+        double gpu = nanoseconds / 1.0e6;
+        timing.cpu += cpu;
+        timing.gpu += gpu;
+        frameCpu[record.pass] = std::max(frameCpu[record.pass], 0.0) + cpu;
+        frameGpu[record.pass] += gpu;
+
+        TraceEvent cpuEvent = { record.pass, TRACE_CPU, record.cpuStart, record.cpuEnd - record.cpuStart };
+        TraceEvent gpuEvent = { record.pass, TRACE_GPU, record.cpuStart, gpu * 1000.0 };
+        pushTrace(cpuEvent);
+        pushTrace(gpuEvent);
+    }
+    for (size_t pass = 0; pass < passes.size(); pass++) {
+        if (frameCpu[pass] < 0.0)
+            continue;
+        PassHistory& history = passes[pass];
+        history.cpu[history.next] = frameCpu[pass];
+        history.gpu[history.next] = frameGpu[pass];
+        history.next = (history.next + 1) % HISTORY;
+        if (history.count < HISTORY)
+            history.count++;
+    }
+    finished.push_back(timing);
+    // nobody is popping, don't let the backlog grow without bound
+    while (finished.size() > HISTORY)
+        finished.pop_front();
+}
+
+void Profiler::pushTrace(const TraceEvent& event) {
+    trace.push_back(event);
+    if (trace.size() > MAX_TRACE_EVENTS)
+        trace.pop_front();
+}
@@ -0,0 +1,125 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <chrono>
+
+#include <glad/glad.h>
+
+// Per-pass frame profiler. Every pass is timed on the CPU with
+// steady_clock and on the GPU with a GL_TIME_ELAPSED query. The queries
+// of the last FRAME_LATENCY frames live in a ring and are read back when
+// their slot comes around again, so profiling never stalls the pipeline;
+// results that are still not available then are dropped, unless the
+// profiler is blocking. Elapsed-time queries cannot nest, so neither can
+// passes.
+class Profiler {
+public:
+    static const int FRAME_LATENCY = 4;
+    // frames kept per pass for the rolling statistics
+    static const int HISTORY = 240;
+    // trace events kept for the Chrome trace export, older ones are discarded
+    static const size_t MAX_TRACE_EVENTS = 200000;
+
+    // rolling statistics of a pass over the last HISTORY frames, in milliseconds
+    struct PassStats {
+        std::string name;
+        double cpuMin, cpuAvg, cpuP99;
+        double gpuMin, gpuAvg, gpuP99;
+    };
+    // named per-frame value, e.g. how many draws were culled
+    struct Counter {
+        const char* name;
+        double value;
+    };
+    // sums over all passes of a finished frame, in milliseconds
+    struct FrameTiming {
+        unsigned long long frame;
+        double cpu, gpu;
+    };
+
+    Profiler();
+
+    void Release();
+    // when blocking, BeginFrame waits for results still in flight instead of dropping them
+    void SetBlocking(bool blocking) { this->blocking = blocking; }
+    void BeginFrame();
+    void EndFrame();
+    // name must stay valid for the lifetime of the profiler, string literals are expected.
+    // a pass opened several times in a frame is reported as the sum of its runs
+    void BeginPass(const char* name);
+    void EndPass();
+    // records the current value of a counter, name follows the same rules as pass names
+    void SetCounter(const char* name, double value);
+    const std::vector<Counter>& Counters() const { return counters; }
+    // waits for and collects every frame still in flight
+    void Flush();
+    // pops the oldest finished frame that hasn't been popped yet
+    bool PopFrameTiming(FrameTiming& timing);
+    std::vector<PassStats> Stats() const;
+    unsigned long long DroppedFrames() const { return droppedFrames; }
+    // writes the collected passes as Chrome trace events (chrome://tracing, Perfetto)
+    bool ExportChromeTrace(const std::string& path) const;
+private:
+    struct PassRecord {
+        int pass;
+        double cpuStart, cpuEnd;
+    };
+    struct FrameSlot {
+        unsigned long long frame;
+        std::vector<PassRecord> passes;
+        std::vector<unsigned int> queries;
+        bool pending;
+    };
+    struct PassHistory {
+        const char* name;
+        std::vector<double> cpu, gpu;
+        int next, count;
+    };
+    enum TraceKind { TRACE_CPU, TRACE_GPU, TRACE_COUNTER };
+    struct TraceEvent {
+        // index of the pass or, for counters, of the counter
+        int index;
+        TraceKind kind;
+        // start and duration in microseconds, counters keep their value in duration
+        double start, duration;
+    };
+
+    FrameSlot frames[FRAME_LATENCY];
+    std::vector<PassHistory> passes;
+    std::vector<Counter> counters;
+    std::deque<TraceEvent> trace;
+    std::deque<FrameTiming> finished;
+    // per pass totals of the frame being resolved, a pass opened several times in a frame counts once
+    std::vector<double> frameCpu, frameGpu;
+    std::chrono::steady_clock::time_point epoch;
+    unsigned long long frameNumber, droppedFrames;
+    int activePass;
+    bool blocking;
+
+    // microseconds since the profiler was created
+    double now() const;
+    int passIndex(const char* name);
+    void resolve(FrameSlot& slot, bool wait);
+    void pushTrace(const TraceEvent& event);
+};
+
+// Times the enclosing scope as a pass of the given profiler.
+class ProfileScope {
+public:
+    ProfileScope(Profiler& profiler, const char* name)
+        : profiler(profiler) {
+        profiler.BeginPass(name);
+    }
+    ~ProfileScope() {
+        profiler.EndPass();
+    }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+private:
+    Profiler& profiler;
+};
+
+#endif
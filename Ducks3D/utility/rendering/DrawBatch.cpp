@@ -0,0 +1,64 @@
+#include "DrawBatch.h"
+#include "StreamingBuffer.h"
+
+DrawBatch::DrawBatch()
+    : commandBuffer(0), instanceBuffer(0), commandCapacity(0), instanceCapacity(0), vao(0) {
+}
+
+void DrawBatch::Begin() {
+    commands.clear();
+    instances.clear();
+}
+
+unsigned int DrawBatch::AddInstances(const InstanceData* data, size_t count) {
+    unsigned int first = static_cast<unsigned int>(instances.size());
+    instances.insert(instances.end(), data, data + count);
+    return first;
+}
+
+void DrawBatch::AddDraw(const GeometryRange& range, const MeshLod& lod, unsigned int firstInstance, unsigned int instanceCount) {
+    if (instanceCount == 0 || lod.indexCount == 0)
+        return;
+    DrawElementsIndirectCommand command;
+    command.count = lod.indexCount;
+    command.instanceCount = instanceCount;
+    command.firstIndex = range.firstIndex + lod.firstIndex;
+    command.baseVertex = static_cast<int>(range.baseVertex);
+    command.baseInstance = firstInstance;
+    commands.push_back(command);
+}
+
+void DrawBatch::Submit(RenderQueue& queue, const DrawItem& material) {
+    if (commands.empty())
+        return;
+    if (vao == 0) {
+        glGenBuffers(1, &commandBuffer);
+        glGenBuffers(1, &instanceBuffer);
+        // orphaning keeps the buffer's name, so the vertex array stays valid across uploads
+        vao = GeometryPool::CreateInstancedVertexArray(instanceBuffer);
+    }
+    StreamingBuffer::Upload(GL_ARRAY_BUFFER, instanceBuffer, instanceCapacity, instances.data(), instances.size() * sizeof(InstanceData));
+    StreamingBuffer::Upload(GL_DRAW_INDIRECT_BUFFER, commandBuffer, commandCapacity, commands.data(),
+        commands.size() * sizeof(DrawElementsIndirectCommand));
+
+    DrawItem item = material;
+    item.vao = vao;
+    item.indexed = true;
+    item.drawCount = static_cast<GLsizei>(commands.size());
+    item.indirectBuffer = commandBuffer;
+    item.indirectOffset = 0;
+    queue.Submit(item);
+}
+
+void DrawBatch::Release() {
+    if (vao != 0)
+        GeometryPool::DeleteVertexArray(vao);
+    if (commandBuffer != 0)
+        glDeleteBuffers(1, &commandBuffer);
+    if (instanceBuffer != 0)
+        glDeleteBuffers(1, &instanceBuffer);
+    vao = commandBuffer = instanceBuffer = 0;
+    commandCapacity = instanceCapacity = 0;
+    commands.clear();
+    instances.clear();
+}
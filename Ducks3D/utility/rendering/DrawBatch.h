@@ -0,0 +1,54 @@
+#ifndef DRAW_BATCH_H
+#define DRAW_BATCH_H
+
+#include <vector>
+#include <cstddef>
+
+#include "GLExtensions.h"
+#include "RenderQueue.h"
+#include "../model-loading/Mesh.h"
+
+// the command layout glMultiDrawElementsIndirect reads
+struct DrawElementsIndirectCommand {
+    unsigned int count;
+    unsigned int instanceCount;
+    unsigned int firstIndex;
+    int baseVertex;
+    unsigned int baseInstance;
+};
+
+// Collects the instanced draws of pooled meshes that share a program and
+// material and submits them to the render queue as a single
+// glMultiDrawElementsIndirect. All instances go into one buffer and
+// each command picks its own through baseInstance, which offsets the
+// instanced attributes, so the shaders read InstanceData as before and
+// the number of GL calls doesn't depend on how many meshes, levels or
+// objects are in the batch.
+class DrawBatch {
+public:
+    DrawBatch();
+
+    // false if the context can't draw batches, draws then have to be submitted one by one
+    static bool Supported() { return GLExtensions::MultiDrawIndirect(); }
+    // drops the draws and instances of the last frame
+    void Begin();
+    // copies instances into the batch and returns the index of the first, for AddDraw
+    unsigned int AddInstances(const InstanceData* data, size_t count);
+    // one draw of lod of the mesh at range, for instanceCount instances starting at firstInstance
+    void AddDraw(const GeometryRange& range, const MeshLod& lod, unsigned int firstInstance, unsigned int instanceCount);
+    // uploads commands and instances and queues them as one item, material supplies everything but the geometry.
+    // The buffers are reused, so a batch can only be submitted once per frame
+    void Submit(RenderQueue& queue, const DrawItem& material);
+    size_t Draws() const { return commands.size(); }
+    size_t Instances() const { return instances.size(); }
+    void Release();
+private:
+    std::vector<DrawElementsIndirectCommand> commands;
+    std::vector<InstanceData> instances;
+    unsigned int commandBuffer, instanceBuffer;
+    size_t commandCapacity, instanceCapacity;
+    // pool geometry plus instanceBuffer
+    unsigned int vao;
+};
+
+#endif
@@ -0,0 +1,85 @@
+#include "FrameUniforms.h"
+
+#include <cstring>
+
+#include "GLExtensions.h"
+
+const char* const FrameUniforms::BLOCK_NAME = "FrameData";
+
+FrameUniforms::FrameUniforms()
+    : buffer(0), slotSize(0), mapped(nullptr), slot(0), stalls(0) {
+    for (GLsync& fence : fences)
+        fence = nullptr;
+}
+
+void FrameUniforms::Generate() {
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    slotSize = (sizeof(FrameData) + alignment - 1) / alignment * alignment;
+
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    if (GLExtensions::BufferStorage()) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        GLExtensions::BufferStorageData(GL_UNIFORM_BUFFER, slotSize * RING_SIZE, nullptr, flags);
+        mapped = static_cast<unsigned char*>(glMapBufferRange(GL_UNIFORM_BUFFER, 0, slotSize * RING_SIZE, flags));
+    }
+    else {
+        glBufferData(GL_UNIFORM_BUFFER, slotSize * RING_SIZE, nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void FrameUniforms::Update(const FrameData& data) {
+    slot = (slot + 1) % RING_SIZE;
+    if (fences[slot]) {
+        // RING_SIZE frames ago, normally long signalled
+        GLenum result = glClientWaitSync(fences[slot], 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED) {
+            stalls++;
+            while (glClientWaitSync(fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) == GL_TIMEOUT_EXPIRED) {}
+        }
+        glDeleteSync(fences[slot]);
+        fences[slot] = nullptr;
+    }
+
+    GLintptr offset = slot * slotSize;
+    if (mapped) {
+        std::memcpy(mapped + offset, &data, sizeof(FrameData));
+    }
+    else {
+        glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+        void* target = glMapBufferRange(GL_UNIFORM_BUFFER, offset, sizeof(FrameData),
+            GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (target) {
+            std::memcpy(target, &data, sizeof(FrameData));
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+        }
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    glBindBufferRange(GL_UNIFORM_BUFFER, BINDING, buffer, offset, sizeof(FrameData));
+}
+
+void FrameUniforms::EndFrame() {
+    if (fences[slot])
+        glDeleteSync(fences[slot]);
+    fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+void FrameUniforms::Release() {
+    for (GLsync& fence : fences) {
+        if (fence)
+            glDeleteSync(fence);
+        fence = nullptr;
+    }
+    if (buffer != 0) {
+        if (mapped) {
+            glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+            glUnmapBuffer(GL_UNIFORM_BUFFER);
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        }
+        glDeleteBuffers(1, &buffer);
+    }
+    buffer = 0;
+    mapped = nullptr;
+}
@@ -0,0 +1,59 @@
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+// Per-frame data every program reads from the std140 block
+//
+//   layout (std140) uniform FrameData { ... };
+//
+// members in the order below. Shader binds a block of that name to
+// BINDING when it links, so no program uploads these on its own.
+struct FrameData {
+    glm::mat4 view;
+    glm::mat4 projection;
+    glm::mat4 viewProjection;
+    // w unused
+    glm::vec4 cameraPosition;
+    // width, height, 1 / width, 1 / height in pixels
+    glm::vec4 viewport;
+};
+
+// Streams FrameData through a ring of RING_SIZE slots in one uniform
+// buffer, a frame writes the slot the GPU finished with longest ago and
+// binds it to BINDING. With buffer storage (GL 4.4 / ARB_buffer_storage)
+// the buffer stays mapped persistent and coherent, so a frame's upload
+// is a single memcpy; otherwise each slot is mapped unsynchronized for
+// the copy. Either way the driver never copies or synchronizes on its
+// own, a fence per slot tells when it may be written again.
+class FrameUniforms {
+public:
+    static const unsigned int BINDING = 0;
+    static const int RING_SIZE = 3;
+    // name of the block in GLSL
+    static const char* const BLOCK_NAME;
+
+    FrameUniforms();
+
+    void Generate();
+    // writes data into the next slot, waiting on its fence if the GPU still reads it, and binds it
+    void Update(const FrameData& data);
+    // fences the slot of this frame, call after the frame's last draw
+    void EndFrame();
+    // times Update had to wait on the GPU since the last reset
+    unsigned int Stalls() const { return stalls; }
+    void ResetStalls() { stalls = 0; }
+    void Release();
+private:
+    unsigned int buffer;
+    // slot size rounded up to the uniform buffer offset alignment
+    GLsizeiptr slotSize;
+    // persistent mapping of the whole ring, null without buffer storage
+    unsigned char* mapped;
+    GLsync fences[RING_SIZE];
+    int slot;
+    unsigned int stalls;
+};
+
+#endif
@@ -0,0 +1,167 @@
+#include "GLExtensions.h"
+
+#include <cstring>
+#include <algorithm>
+
+// Instantiate static variables
+int GLExtensions::major = 0;
+int GLExtensions::minor = 0;
+std::vector<std::string> GLExtensions::extensions;
+GLExtensions::TexStorage2DProc GLExtensions::texStorage2D = nullptr;
+GLExtensions::BufferStorageProc GLExtensions::bufferStorage = nullptr;
+GLExtensions::ProgramParameteriProc GLExtensions::programParameteri = nullptr;
+GLExtensions::GetProgramBinaryProc GLExtensions::getProgramBinary = nullptr;
+GLExtensions::ProgramBinaryProc GLExtensions::programBinary = nullptr;
+bool GLExtensions::parallelShaderCompile = false;
+GLExtensions::MultiDrawElementsIndirectProc GLExtensions::multiDrawElementsIndirect = nullptr;
+GLExtensions::DispatchComputeProc GLExtensions::dispatchCompute = nullptr;
+GLExtensions::MemoryBarrierProc GLExtensions::memoryBarrier = nullptr;
+float GLExtensions::maxAnisotropy = 1.0f;
+bool GLExtensions::s3tc = false;
+bool GLExtensions::bptc = false;
+bool GLExtensions::etc2 = false;
+
+void GLExtensions::Load(GLADloadproc load) {
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    extensions.clear();
+    for (GLint i = 0; i < count; i++)
+        extensions.push_back(reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i)));
+
+    texStorage2D = nullptr;
+    if (AtLeast(4, 2) || Has("GL_ARB_texture_storage"))
+        texStorage2D = reinterpret_cast<TexStorage2DProc>(load("glTexStorage2D"));
+
+    bufferStorage = nullptr;
+    if (AtLeast(4, 4) || Has("GL_ARB_buffer_storage"))
+        bufferStorage = reinterpret_cast<BufferStorageProc>(load("glBufferStorage"));
+
+    programParameteri = nullptr;
+    getProgramBinary = nullptr;
+    programBinary = nullptr;
+    GLint binaryFormats = 0;
+    if (AtLeast(4, 1) || Has("GL_ARB_get_program_binary"))
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &binaryFormats);
+    if (binaryFormats > 0) {
+        programParameteri = reinterpret_cast<ProgramParameteriProc>(load("glProgramParameteri"));
+        getProgramBinary = reinterpret_cast<GetProgramBinaryProc>(load("glGetProgramBinary"));
+        programBinary = reinterpret_cast<ProgramBinaryProc>(load("glProgramBinary"));
+        if (!programParameteri || !getProgramBinary)
+            programBinary = nullptr;
+    }
+
+    parallelShaderCompile = false;
+    MaxShaderCompilerThreadsProc maxShaderCompilerThreads = nullptr;
+    if (Has("GL_KHR_parallel_shader_compile"))
+        maxShaderCompilerThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(load("glMaxShaderCompilerThreadsKHR"));
+    else if (Has("GL_ARB_parallel_shader_compile"))
+        maxShaderCompilerThreads = reinterpret_cast<MaxShaderCompilerThreadsProc>(load("glMaxShaderCompilerThreadsARB"));
+    if (maxShaderCompilerThreads) {
+        // 0xFFFFFFFF: as many threads as the implementation sees fit
+        maxShaderCompilerThreads(0xFFFFFFFFu);
+        parallelShaderCompile = true;
+    }
+
+    multiDrawElementsIndirect = nullptr;
+    if (AtLeast(4, 3) || (Has("GL_ARB_multi_draw_indirect") && (AtLeast(4, 2) || Has("GL_ARB_base_instance"))))
+        multiDrawElementsIndirect = reinterpret_cast<MultiDrawElementsIndirectProc>(load("glMultiDrawElementsIndirect"));
+
+    dispatchCompute = nullptr;
+    memoryBarrier = nullptr;
+    // the compute shaders are #version 430, the extensions alone don't let them compile
+    if (AtLeast(4, 3)) {
+        dispatchCompute = reinterpret_cast<DispatchComputeProc>(load("glDispatchCompute"));
+        memoryBarrier = reinterpret_cast<MemoryBarrierProc>(load("glMemoryBarrier"));
+        if (!memoryBarrier)
+            dispatchCompute = nullptr;
+    }
+
+    maxAnisotropy = 1.0f;
+    if (AtLeast(4, 6) || Has("GL_ARB_texture_filter_anisotropic") || Has("GL_EXT_texture_filter_anisotropic"))
+        glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &maxAnisotropy);
+
+    s3tc = Has("GL_EXT_texture_compression_s3tc");
+    bptc = AtLeast(4, 2) || Has("GL_ARB_texture_compression_bptc");
+    etc2 = AtLeast(4, 3) || Has("GL_ARB_ES3_compatibility");
+}
+
+bool GLExtensions::Has(const char* name) {
+    return std::find_if(extensions.begin(), extensions.end(),
+        [name](const std::string& extension) { return std::strcmp(extension.c_str(), name) == 0; }) != extensions.end();
+}
+
+bool GLExtensions::AtLeast(int major, int minor) {
+    return GLExtensions::major > major || (GLExtensions::major == major && GLExtensions::minor >= minor);
+}
+
+void GLExtensions::TexStorage2D(GLenum target, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height) {
+    texStorage2D(target, levels, internalFormat, width, height);
+}
+
+void GLExtensions::BufferStorageData(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags) {
+    bufferStorage(target, size, data, flags);
+}
+
+void GLExtensions::ProgramParameter(GLuint program, GLenum name, GLint value) {
+    programParameteri(program, name, value);
+}
+
+void GLExtensions::GetProgramBinary(GLuint program, GLsizei bufferSize, GLsizei* length, GLenum* format, void* binary) {
+    getProgramBinary(program, bufferSize, length, format, binary);
+}
+
+void GLExtensions::ProgramBinaryData(GLuint program, GLenum format, const void* binary, GLsizei length) {
+    programBinary(program, format, binary, length);
+}
+
+void GLExtensions::MultiDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride) {
+    multiDrawElementsIndirect(mode, type, indirect, drawCount, stride);
+}
+
+void GLExtensions::DispatchCompute(GLuint groupsX, GLuint groupsY, GLuint groupsZ) {
+    dispatchCompute(groupsX, groupsY, groupsZ);
+}
+
+void GLExtensions::MemoryBarriers(GLbitfield barriers) {
+    memoryBarrier(barriers);
+}
+
+bool GLExtensions::SupportsCompressedFormat(GLenum format) {
+    switch (format) {
+    case GL_COMPRESSED_RED_RGTC1:
+    case GL_COMPRESSED_SIGNED_RED_RGTC1:
+    case GL_COMPRESSED_RG_RGTC2:
+    case GL_COMPRESSED_SIGNED_RG_RGTC2:
+        // core since GL 3.0
+        return true;
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+        return s3tc;
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+    case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
+    case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+        return bptc;
+    case GL_COMPRESSED_R11_EAC:
+    case GL_COMPRESSED_SIGNED_R11_EAC:
+    case GL_COMPRESSED_RG11_EAC:
+    case GL_COMPRESSED_SIGNED_RG11_EAC:
+    case GL_COMPRESSED_RGB8_ETC2:
+    case GL_COMPRESSED_SRGB8_ETC2:
+    case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+    case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+    case GL_COMPRESSED_RGBA8_ETC2_EAC:
+    case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+        return etc2;
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,141 @@
+#ifndef GL_EXTENSIONS_H
+#define GL_EXTENSIONS_H
+
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+// enums of the extensions below that the GL 3.3 core loader doesn't define
+#ifndef GL_TEXTURE_MAX_ANISOTROPY
+#define GL_TEXTURE_MAX_ANISOTROPY 0x84FE
+#define GL_MAX_TEXTURE_MAX_ANISOTROPY 0x84FF
+#endif
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#define GL_COMPRESSED_RGBA_S3TC_DXT1_EXT 0x83F1
+#define GL_COMPRESSED_RGBA_S3TC_DXT3_EXT 0x83F2
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT 0x8C4D
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT 0x8C4E
+#define GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT 0x8C4F
+#endif
+#ifndef GL_COMPRESSED_RGBA_BPTC_UNORM
+#define GL_COMPRESSED_RGBA_BPTC_UNORM 0x8E8C
+#define GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM 0x8E8D
+#define GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT 0x8E8E
+#define GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT 0x8E8F
+#endif
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#define GL_MAP_COHERENT_BIT 0x0080
+#define GL_DYNAMIC_STORAGE_BIT 0x0100
+#define GL_CLIENT_STORAGE_BIT 0x0200
+#endif
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#define GL_PROGRAM_BINARY_FORMATS 0x87FF
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#define GL_DRAW_INDIRECT_BUFFER_BINDING 0x8F43
+#endif
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#define GL_COMMAND_BARRIER_BIT 0x00000040
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#define GL_SHADER_STORAGE_BARRIER_BIT 0x00002000
+#endif
+#ifndef GL_COMPRESSED_R11_EAC
+#define GL_COMPRESSED_R11_EAC 0x9270
+#define GL_COMPRESSED_SIGNED_R11_EAC 0x9271
+#define GL_COMPRESSED_RG11_EAC 0x9272
+#define GL_COMPRESSED_SIGNED_RG11_EAC 0x9273
+#define GL_COMPRESSED_RGB8_ETC2 0x9274
+#define GL_COMPRESSED_SRGB8_ETC2 0x9275
+#define GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2 0x9276
+#define GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2 0x9277
+#define GL_COMPRESSED_RGBA8_ETC2_EAC 0x9278
+#define GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC 0x9279
+#endif
+
+// Capabilities and entry points beyond the GL 3.3 core profile glad was
+// generated for. Load queries the context once after glad is initialized;
+// every feature is either core in the context's version or provided by an
+// extension, and callers check the matching query before using it.
+class GLExtensions {
+public:
+    // reads version and extension list of the current context and resolves the extra entry points through load
+    static void Load(GLADloadproc load);
+    // true if the context advertises the extension, e.g. "GL_ARB_texture_storage"
+    static bool Has(const char* name);
+    // true if the context's version is at least major.minor
+    static bool AtLeast(int major, int minor);
+
+    // glTexStorage2D: GL 4.2 or ARB_texture_storage
+    static bool TextureStorage() { return texStorage2D != nullptr; }
+    static void TexStorage2D(GLenum target, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height);
+    // glBufferStorage: GL 4.4 or ARB_buffer_storage, allows persistently mapped buffers
+    static bool BufferStorage() { return bufferStorage != nullptr; }
+    static void BufferStorageData(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+    // glGetProgramBinary/glProgramBinary: GL 4.1 or ARB_get_program_binary, and the driver
+    // offering at least one binary format
+    static bool ProgramBinary() { return programBinary != nullptr; }
+    static void ProgramParameter(GLuint program, GLenum name, GLint value);
+    static void GetProgramBinary(GLuint program, GLsizei bufferSize, GLsizei* length, GLenum* format, void* binary);
+    static void ProgramBinaryData(GLuint program, GLenum format, const void* binary, GLsizei length);
+    // KHR_ or ARB_parallel_shader_compile: compiles and links run on driver threads and
+    // GL_COMPLETION_STATUS_KHR can be polled without blocking. Load lets the driver pick the thread count
+    static bool ParallelShaderCompile() { return parallelShaderCompile; }
+    // glMultiDrawElementsIndirect with a base instance per command: GL 4.3, or ARB_multi_draw_indirect
+    // together with GL 4.2 or ARB_base_instance (without it the field must be 0)
+    static bool MultiDrawIndirect() { return multiDrawElementsIndirect != nullptr; }
+    static void MultiDrawElementsIndirect(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride);
+    // compute shaders and shader storage buffers: GL 4.3, which the #version 430 shaders need
+    static bool ComputeShaders() { return dispatchCompute != nullptr; }
+    static void DispatchCompute(GLuint groupsX, GLuint groupsY, GLuint groupsZ);
+    // glMemoryBarrier, named apart from the Windows MemoryBarrier macro
+    static void MemoryBarriers(GLbitfield barriers);
+    // GL 4.6, ARB_ or EXT_texture_filter_anisotropic
+    static bool AnisotropicFiltering() { return maxAnisotropy > 1.0f; }
+    static float MaxAnisotropy() { return maxAnisotropy; }
+    // true if compressed textures of format (one of the enums above or RGTC) can be sampled
+    static bool SupportsCompressedFormat(GLenum format);
+private:
+    GLExtensions() {}
+
+    typedef void (APIENTRYP TexStorage2DProc)(GLenum target, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height);
+    typedef void (APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+    typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum name, GLint value);
+    typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufferSize, GLsizei* length, GLenum* format, void* binary);
+    typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum format, const void* binary, GLsizei length);
+    typedef void (APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+    typedef void (APIENTRYP MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void* indirect, GLsizei drawCount, GLsizei stride);
+    typedef void (APIENTRYP DispatchComputeProc)(GLuint groupsX, GLuint groupsY, GLuint groupsZ);
+    typedef void (APIENTRYP MemoryBarrierProc)(GLbitfield barriers);
+
+    static int major, minor;
+    static std::vector<std::string> extensions;
+    static TexStorage2DProc texStorage2D;
+    static BufferStorageProc bufferStorage;
+    static ProgramParameteriProc programParameteri;
+    static GetProgramBinaryProc getProgramBinary;
+    static ProgramBinaryProc programBinary;
+    static bool parallelShaderCompile;
+    static MultiDrawElementsIndirectProc multiDrawElementsIndirect;
+    static DispatchComputeProc dispatchCompute;
+    static MemoryBarrierProc memoryBarrier;
+    static float maxAnisotropy;
+    static bool s3tc, bptc, etc2;
+};
+
+#endif
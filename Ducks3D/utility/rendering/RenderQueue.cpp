@@ -0,0 +1,131 @@
+#include "RenderQueue.h"
+
+#include <cstring>
+
+#include "RenderState.h"
+#include "GLExtensions.h"
+#include "../profiling/Profiler.h"
+
+namespace {
+    const uint64_t DEPTH_MASK = (1ull << 24) - 1;
+    const uint64_t NAME_MASK = (1ull << 10) - 1;
+}
+
+DrawItem::DrawItem()
+    : shader(nullptr), texture(nullptr), vao(0), primitive(GL_TRIANGLES), count(0), firstIndex(0), baseVertex(0), indexed(true), instanceCount(0),
+    drawCount(0), indirectBuffer(0), indirectOffset(0),
+    model(1.0f), center(0.0f), layer(RenderQueue::LAYER_WORLD), translucent(false), pass(nullptr) {
+}
+
+RenderQueue::RenderQueue()
+    : cameraPosition(0.0f), farPlane(1.0f) {
+}
+
+void RenderQueue::Begin(const glm::vec3& cameraPosition, float farPlane) {
+    this->cameraPosition = cameraPosition;
+    this->farPlane = farPlane;
+    items.clear();
+    keys.clear();
+}
+
+void RenderQueue::Submit(const DrawItem& item) {
+    items.push_back(item);
+    keys.push_back(makeKey(item));
+}
+
+void RenderQueue::Sort() {
+    size_t count = keys.size();
+    order.resize(count);
+    for (size_t i = 0; i < count; i++)
+        order[i] = static_cast<uint32_t>(i);
+    if (count < 2)
+        return;
+    scratchKeys.resize(count);
+    scratchOrder.resize(count);
+
+    uint64_t* sourceKeys = keys.data();
+    uint32_t* sourceOrder = order.data();
+    uint64_t* targetKeys = scratchKeys.data();
+    uint32_t* targetOrder = scratchOrder.data();
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t offsets[256] = {};
+        for (size_t i = 0; i < count; i++)
+            offsets[(sourceKeys[i] >> shift) & 0xFF]++;
+        // every key has the same digit, the pass wouldn't move anything
+        if (offsets[(sourceKeys[0] >> shift) & 0xFF] == count)
+            continue;
+        size_t total = 0;
+        for (size_t& offset : offsets) {
+            size_t digitCount = offset;
+            offset = total;
+            total += digitCount;
+        }
+        for (size_t i = 0; i < count; i++) {
+            size_t target = offsets[(sourceKeys[i] >> shift) & 0xFF]++;
+            targetKeys[target] = sourceKeys[i];
+            targetOrder[target] = sourceOrder[i];
+        }
+        std::swap(sourceKeys, targetKeys);
+        std::swap(sourceOrder, targetOrder);
+    }
+    if (sourceKeys != keys.data()) {
+        std::memcpy(keys.data(), sourceKeys, count * sizeof(uint64_t));
+        std::memcpy(order.data(), sourceOrder, count * sizeof(uint32_t));
+    }
+}
+
+void RenderQueue::Execute(Profiler* profiler) {
+    const char* activePass = nullptr;
+    for (size_t i = 0; i < order.size(); i++) {
+        const DrawItem& item = items[order[i]];
+        if (profiler && item.pass != activePass) {
+            if (activePass)
+                profiler->EndPass();
+            if (item.pass)
+                profiler->BeginPass(item.pass);
+            activePass = item.pass;
+        }
+
+        RenderState::SetBlend(item.translucent);
+        if (item.translucent)
+            RenderState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        item.shader->Use();
+        if (item.modelUniform.IsValid())
+            item.shader->SetMatrix4(item.modelUniform, item.model);
+        if (item.texture)
+            item.texture->Bind(0);
+        RenderState::BindVertexArray(item.vao);
+
+        if (item.drawCount > 0) {
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, item.indirectBuffer);
+            GLExtensions::MultiDrawElementsIndirect(item.primitive, GL_UNSIGNED_INT, (void*)item.indirectOffset, item.drawCount, 0);
+        }
+        else if (item.indexed && item.instanceCount > 0)
+            glDrawElementsInstancedBaseVertex(item.primitive, item.count, GL_UNSIGNED_INT, (void*)(item.firstIndex * sizeof(unsigned int)),
+                item.instanceCount, item.baseVertex);
+        else if (item.indexed)
+            glDrawElementsBaseVertex(item.primitive, item.count, GL_UNSIGNED_INT, (void*)(item.firstIndex * sizeof(unsigned int)), item.baseVertex);
+        else if (item.instanceCount > 0)
+            glDrawArraysInstanced(item.primitive, 0, item.count, item.instanceCount);
+        else
+            glDrawArrays(item.primitive, 0, item.count);
+    }
+    if (profiler && activePass)
+        profiler->EndPass();
+    RenderState::SetBlend(false);
+}
+
+uint64_t RenderQueue::makeKey(const DrawItem& item) const {
+    float distance = glm::length(item.center - cameraPosition) / farPlane;
+    distance = glm::clamp(distance, 0.0f, 1.0f);
+    uint64_t depth = static_cast<uint64_t>(distance * DEPTH_MASK) & DEPTH_MASK;
+    uint64_t shader = (item.shader ? item.shader->id : 0) & NAME_MASK;
+    uint64_t texture = (item.texture ? item.texture->id : 0) & NAME_MASK;
+    uint64_t vao = item.vao & NAME_MASK;
+
+    uint64_t key = static_cast<uint64_t>(item.layer & 0xF) << 60;
+    if (!item.translucent)
+        return key | (shader << 44) | (texture << 34) | (vao << 24) | depth;
+    key |= 1ull << 59;
+    return key | ((DEPTH_MASK - depth) << 30) | (shader << 20) | (texture << 10) | vao;
+}
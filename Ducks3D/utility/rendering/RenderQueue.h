@@ -0,0 +1,86 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <vector>
+#include <cstdint>
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include "../shader/Shader.h"
+#include "../texture/Texture2D.h"
+
+class Profiler;
+
+// Everything needed to issue one draw call from the render queue.
+struct DrawItem {
+    Shader* shader;
+    // bound to texture unit 0, may be null
+    const Texture2D* texture;
+    unsigned int vao;
+    GLenum primitive;
+    GLsizei count;
+    // first index of an indexed draw within the bound element buffer
+    unsigned int firstIndex;
+    // added to every index of an indexed draw
+    int baseVertex;
+    bool indexed;
+    // 0 issues a regular draw, anything else an instanced one
+    unsigned int instanceCount;
+    // anything but 0 issues drawCount DrawElementsIndirectCommands read from indirectBuffer at byte
+    // indirectOffset as one glMultiDrawElementsIndirect, count, firstIndex, baseVertex and instanceCount are unused then
+    GLsizei drawCount;
+    unsigned int indirectBuffer;
+    size_t indirectOffset;
+    // set to upload model before the draw, left invalid for draws without a per-draw matrix
+    UniformHandle modelUniform;
+    glm::mat4 model;
+    // world space position used for depth sorting
+    glm::vec3 center;
+    unsigned int layer;
+    bool translucent;
+    // profiler pass the draw is accounted to, may be null
+    const char* pass;
+
+    DrawItem();
+};
+
+// Collects the draws of a frame and issues them in an order that
+// minimizes state changes. Each submission gets a 64-bit sort key,
+// from the most significant bits down:
+//
+//   opaque:      layer(4) | 0 | shader(10) | texture(10) | vao(10) | depth(24)
+//   translucent: layer(4) | 1 | inverted depth(24) | shader(10) | texture(10) | vao(10)
+//
+// so layers are drawn in order, opaque draws are grouped by state and
+// go front-to-back within a state, and translucent draws go strictly
+// back-to-front. GL names are folded into 10 bits, a collision only
+// costs sorting quality. Keys are LSD radix sorted, skipping digits
+// that are the same for every key.
+class RenderQueue {
+public:
+    enum Layer {
+        LAYER_WORLD = 0,
+        LAYER_HUD = 1
+    };
+
+    RenderQueue();
+
+    // clears the queue and sets the camera used for depth keys, distances are normalized by farPlane
+    void Begin(const glm::vec3& cameraPosition, float farPlane);
+    void Submit(const DrawItem& item);
+    void Sort();
+    // issues all draws in key order through RenderState, opening a profiler pass whenever the item's pass changes
+    void Execute(Profiler* profiler = nullptr);
+    size_t Size() const { return items.size(); }
+private:
+    std::vector<DrawItem> items;
+    std::vector<uint64_t> keys, scratchKeys;
+    std::vector<uint32_t> order, scratchOrder;
+    glm::vec3 cameraPosition;
+    float farPlane;
+
+    uint64_t makeKey(const DrawItem& item) const;
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include "RenderState.h"
+
+namespace {
+    // value no GL name or enum takes, marks cached state as unknown
+    const unsigned int UNKNOWN = ~0u;
+}
+
+// Instantiate static variables
+unsigned int RenderState::program = UNKNOWN;
+unsigned int RenderState::vertexArray = UNKNOWN;
+unsigned int RenderState::activeUnit = UNKNOWN;
+unsigned int RenderState::textures[RenderState::MAX_TEXTURE_UNITS] = {
+    UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN,
+    UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN, UNKNOWN
+};
+int RenderState::blend = -1;
+int RenderState::depthTest = -1;
+int RenderState::cullFace = -1;
+GLenum RenderState::blendSource = UNKNOWN;
+GLenum RenderState::blendDestination = UNKNOWN;
+GLenum RenderState::cullMode = UNKNOWN;
+RenderState::Counters RenderState::counters = { 0, 0 };
+
+void RenderState::UseProgram(unsigned int program) {
+    if (update(RenderState::program, program))
+        glUseProgram(program);
+}
+
+void RenderState::BindVertexArray(unsigned int vao) {
+    if (update(vertexArray, vao))
+        glBindVertexArray(vao);
+}
+
+void RenderState::ActiveTexture(unsigned int unit) {
+    if (update(activeUnit, unit))
+        glActiveTexture(GL_TEXTURE0 + unit);
+}
+
+void RenderState::BindTexture2D(unsigned int unit, unsigned int texture) {
+    if (textures[unit] == texture) {
+        counters.skipped++;
+        return;
+    }
+    ActiveTexture(unit);
+    textures[unit] = texture;
+    counters.issued++;
+    glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void RenderState::DeleteTexture(unsigned int texture) {
+    for (unsigned int& bound : textures) {
+        if (bound == texture)
+            bound = 0;
+    }
+    glDeleteTextures(1, &texture);
+}
+
+void RenderState::SetBlend(bool enabled) {
+    if (!update(blend, enabled))
+        return;
+    if (enabled)
+        glEnable(GL_BLEND);
+    else
+        glDisable(GL_BLEND);
+}
+
+void RenderState::BlendFunc(GLenum source, GLenum destination) {
+    if (blendSource == source && blendDestination == destination) {
+        counters.skipped++;
+        return;
+    }
+    blendSource = source;
+    blendDestination = destination;
+    counters.issued++;
+    glBlendFunc(source, destination);
+}
+
+void RenderState::SetDepthTest(bool enabled) {
+    if (!update(depthTest, enabled))
+        return;
+    if (enabled)
+        glEnable(GL_DEPTH_TEST);
+    else
+        glDisable(GL_DEPTH_TEST);
+}
+
+void RenderState::SetCullFace(bool enabled) {
+    if (!update(cullFace, enabled))
+        return;
+    if (enabled)
+        glEnable(GL_CULL_FACE);
+    else
+        glDisable(GL_CULL_FACE);
+}
+
+void RenderState::CullFace(GLenum mode) {
+    if (update(cullMode, mode))
+        glCullFace(mode);
+}
+
+void RenderState::Invalidate() {
+    program = vertexArray = activeUnit = UNKNOWN;
+    for (unsigned int& texture : textures)
+        texture = UNKNOWN;
+    blend = depthTest = cullFace = -1;
+    blendSource = blendDestination = cullMode = UNKNOWN;
+}
+
+void RenderState::ResetCounters() {
+    counters.issued = 0;
+    counters.skipped = 0;
+}
+
+bool RenderState::update(unsigned int& cached, unsigned int value) {
+    if (cached == value) {
+        counters.skipped++;
+        return false;
+    }
+    cached = value;
+    counters.issued++;
+    return true;
+}
+
+bool RenderState::update(int& cached, bool value) {
+    if (cached == (value ? 1 : 0)) {
+        counters.skipped++;
+        return false;
+    }
+    cached = value ? 1 : 0;
+    counters.issued++;
+    return true;
+}
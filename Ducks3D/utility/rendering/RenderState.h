@@ -0,0 +1,56 @@
+#ifndef RENDER_STATE_H
+#define RENDER_STATE_H
+
+#include <glad/glad.h>
+
+// A static state cache in front of the GL calls the renderer issues
+// every frame. It remembers the bound program, vertex array, active
+// texture unit, 2D texture per unit and the blend/depth/cull state, and
+// only forwards a call to the driver when it changes something. All GL
+// code that touches this state must go through it (or call Invalidate
+// afterwards), otherwise the cache goes stale.
+class RenderState {
+public:
+    static const unsigned int MAX_TEXTURE_UNITS = 16;
+
+    // number of state calls forwarded to the driver and skipped as redundant since the last reset
+    struct Counters {
+        unsigned long long issued;
+        unsigned long long skipped;
+    };
+
+    static void UseProgram(unsigned int program);
+    static void BindVertexArray(unsigned int vao);
+    static void ActiveTexture(unsigned int unit);
+    // binds texture to GL_TEXTURE_2D of the given unit, making it the active unit if a bind is needed
+    static void BindTexture2D(unsigned int unit, unsigned int texture);
+    // deletes texture, units it was bound to fall back to 0 like they do in GL
+    static void DeleteTexture(unsigned int texture);
+    static void SetBlend(bool enabled);
+    static void BlendFunc(GLenum source, GLenum destination);
+    static void SetDepthTest(bool enabled);
+    static void SetCullFace(bool enabled);
+    static void CullFace(GLenum mode);
+    // forgets all cached state, so the next call of each kind is always issued
+    static void Invalidate();
+    static unsigned int ActiveUnit() { return activeUnit; }
+    static Counters GetCounters() { return counters; }
+    static void ResetCounters();
+private:
+    RenderState() {}
+
+    static unsigned int program;
+    static unsigned int vertexArray;
+    static unsigned int activeUnit;
+    static unsigned int textures[MAX_TEXTURE_UNITS];
+    // -1 while unknown
+    static int blend, depthTest, cullFace;
+    static GLenum blendSource, blendDestination, cullMode;
+    static Counters counters;
+
+    // records whether a call is needed, returns true if it has to be issued
+    static bool update(unsigned int& cached, unsigned int value);
+    static bool update(int& cached, bool value);
+};
+
+#endif
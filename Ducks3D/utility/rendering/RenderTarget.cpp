@@ -0,0 +1,46 @@
+#include "RenderTarget.h"
+
+RenderTarget::RenderTarget()
+    : id(0), width(0), height(0), colorBuffer(0), depthBuffer(0) {
+}
+
+bool RenderTarget::Generate(unsigned int width, unsigned int height) {
+    this->width = width;
+    this->height = height;
+
+    glGenFramebuffers(1, &this->id);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->id);
+
+    glGenRenderbuffers(1, &this->colorBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, this->colorBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, this->colorBuffer);
+
+    glGenRenderbuffers(1, &this->depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, this->depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, this->depthBuffer);
+
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    return complete;
+}
+
+void RenderTarget::Bind() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, this->id);
+}
+
+void RenderTarget::ReadPixels(std::vector<unsigned char>& pixels) const {
+    pixels.resize(this->width * this->height * 4);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, this->id);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, this->width, this->height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+}
+
+void RenderTarget::Release() {
+    glDeleteFramebuffers(1, &this->id);
+    glDeleteRenderbuffers(1, &this->colorBuffer);
+    glDeleteRenderbuffers(1, &this->depthBuffer);
+    this->id = this->colorBuffer = this->depthBuffer = 0;
+}
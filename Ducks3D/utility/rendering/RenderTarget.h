@@ -0,0 +1,27 @@
+#ifndef RENDER_TARGET_H
+#define RENDER_TARGET_H
+
+#include <vector>
+
+#include <glad/glad.h>
+
+// Offscreen framebuffer with an RGBA8 color and a 24-bit depth
+// attachment, used when rendering without a visible window.
+class RenderTarget {
+public:
+    unsigned int id;
+    unsigned int width, height;
+
+    RenderTarget();
+
+    // creates the framebuffer and its attachments, returns false if it is incomplete
+    bool Generate(unsigned int width, unsigned int height);
+    void Bind() const;
+    // reads back the color attachment as bottom-up RGBA rows
+    void ReadPixels(std::vector<unsigned char>& pixels) const;
+    void Release();
+private:
+    unsigned int colorBuffer, depthBuffer;
+};
+
+#endif
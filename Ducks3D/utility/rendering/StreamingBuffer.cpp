@@ -0,0 +1,13 @@
+#include "StreamingBuffer.h"
+
+#include <algorithm>
+
+void StreamingBuffer::Upload(GLenum target, unsigned int buffer, size_t& capacity, const void* data, size_t size) {
+    glBindBuffer(target, buffer);
+    // grow geometrically so a growing list doesn't reallocate every frame
+    if (size > capacity)
+        capacity = std::max(size, capacity * 2);
+    glBufferData(target, capacity, nullptr, GL_DYNAMIC_DRAW);
+    glBufferSubData(target, 0, size, data);
+    glBindBuffer(target, 0);
+}
@@ -0,0 +1,22 @@
+#ifndef STREAMING_BUFFER_H
+#define STREAMING_BUFFER_H
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+// Uploads of data that is rewritten every frame, like instance lists and
+// indirect commands. The buffer's storage is respecified before each
+// upload, which orphans the old storage, so the upload never waits on
+// draws still reading last frame's data. The buffer keeps its name, so
+// vertex arrays that refer to it stay valid.
+class StreamingBuffer {
+public:
+    // orphans buffer, growing it geometrically to fit size bytes, and writes data to its start.
+    // capacity holds the buffer's size in bytes between uploads, 0 before the first
+    static void Upload(GLenum target, unsigned int buffer, size_t& capacity, const void* data, size_t size);
+private:
+    StreamingBuffer() {}
+};
+
+#endif
@@ -0,0 +1,203 @@
+#include "TextOverlay.h"
+#include "RenderState.h"
+
+#include <cctype>
+#include <algorithm>
+
+namespace {
+    struct Glyph {
+        char character;
+        unsigned char rows[7];
+    };
+
+    // 5x7 glyphs, one row per byte with the leftmost pixel in bit 4
+    const Glyph FONT[] = {
+        { ' ', { 0b00000, 0b00000, 0b00000, 0b00000, 0b00000, 0b00000, 0b00000 } },
+        { '%', { 0b11000, 0b11001, 0b00010, 0b00100, 0b01000, 0b10011, 0b00011 } },
+        { '(', { 0b00010, 0b00100, 0b01000, 0b01000, 0b01000, 0b00100, 0b00010 } },
+        { ')', { 0b01000, 0b00100, 0b00010, 0b00010, 0b00010, 0b00100, 0b01000 } },
+        { '-', { 0b00000, 0b00000, 0b00000, 0b11111, 0b00000, 0b00000, 0b00000 } },
+        { '.', { 0b00000, 0b00000, 0b00000, 0b00000, 0b00000, 0b01100, 0b01100 } },
+        { '/', { 0b00000, 0b00001, 0b00010, 0b00100, 0b01000, 0b10000, 0b00000 } },
+        { '0', { 0b01110, 0b10001, 0b10011, 0b10101, 0b11001, 0b10001, 0b01110 } },
+        { '1', { 0b00100, 0b01100, 0b00100, 0b00100, 0b00100, 0b00100, 0b01110 } },
+        { '2', { 0b01110, 0b10001, 0b00001, 0b00010, 0b00100, 0b01000, 0b11111 } },
+        { '3', { 0b11111, 0b00010, 0b00100, 0b00010, 0b00001, 0b10001, 0b01110 } },
+        { '4', { 0b00010, 0b00110, 0b01010, 0b10010, 0b11111, 0b00010, 0b00010 } },
+        { '5', { 0b11111, 0b10000, 0b11110, 0b00001, 0b00001, 0b10001, 0b01110 } },
+        { '6', { 0b00110, 0b01000, 0b10000, 0b11110, 0b10001, 0b10001, 0b01110 } },
+        { '7', { 0b11111, 0b00001, 0b00010, 0b00100, 0b01000, 0b01000, 0b01000 } },
+        { '8', { 0b01110, 0b10001, 0b10001, 0b01110, 0b10001, 0b10001, 0b01110 } },
+        { '9', { 0b01110, 0b10001, 0b10001, 0b01111, 0b00001, 0b00010, 0b01100 } },
+        { ':', { 0b00000, 0b01100, 0b01100, 0b00000, 0b01100, 0b01100, 0b00000 } },
+        { '=', { 0b00000, 0b00000, 0b11111, 0b00000, 0b11111, 0b00000, 0b00000 } },
+        { '?', { 0b01110, 0b10001, 0b00001, 0b00010, 0b00100, 0b00000, 0b00100 } },
+        { 'A', { 0b01110, 0b10001, 0b10001, 0b11111, 0b10001, 0b10001, 0b10001 } },
+        { 'B', { 0b11110, 0b10001, 0b10001, 0b11110, 0b10001, 0b10001, 0b11110 } },
+        { 'C', { 0b01110, 0b10001, 0b10000, 0b10000, 0b10000, 0b10001, 0b01110 } },
+        { 'D', { 0b11100, 0b10010, 0b10001, 0b10001, 0b10001, 0b10010, 0b11100 } },
+        { 'E', { 0b11111, 0b10000, 0b10000, 0b11110, 0b10000, 0b10000, 0b11111 } },
+        { 'F', { 0b11111, 0b10000, 0b10000, 0b11110, 0b10000, 0b10000, 0b10000 } },
+        { 'G', { 0b01110, 0b10001, 0b10000, 0b10111, 0b10001, 0b10001, 0b01111 } },
+        { 'H', { 0b10001, 0b10001, 0b10001, 0b11111, 0b10001, 0b10001, 0b10001 } },
+        { 'I', { 0b01110, 0b00100, 0b00100, 0b00100, 0b00100, 0b00100, 0b01110 } },
+        { 'J', { 0b00111, 0b00010, 0b00010, 0b00010, 0b00010, 0b10010, 0b01100 } },
+        { 'K', { 0b10001, 0b10010, 0b10100, 0b11000, 0b10100, 0b10010, 0b10001 } },
+        { 'L', { 0b10000, 0b10000, 0b10000, 0b10000, 0b10000, 0b10000, 0b11111 } },
+        { 'M', { 0b10001, 0b11011, 0b10101, 0b10101, 0b10001, 0b10001, 0b10001 } },
+        { 'N', { 0b10001, 0b10001, 0b11001, 0b10101, 0b10011, 0b10001, 0b10001 } },
+        { 'O', { 0b01110, 0b10001, 0b10001, 0b10001, 0b10001, 0b10001, 0b01110 } },
+        { 'P', { 0b11110, 0b10001, 0b10001, 0b11110, 0b10000, 0b10000, 0b10000 } },
+        { 'Q', { 0b01110, 0b10001, 0b10001, 0b10001, 0b10101, 0b10010, 0b01101 } },
+        { 'R', { 0b11110, 0b10001, 0b10001, 0b11110, 0b10100, 0b10010, 0b10001 } },
+        { 'S', { 0b01111, 0b10000, 0b10000, 0b01110, 0b00001, 0b00001, 0b11110 } },
+        { 'T', { 0b11111, 0b00100, 0b00100, 0b00100, 0b00100, 0b00100, 0b00100 } },
+        { 'U', { 0b10001, 0b10001, 0b10001, 0b10001, 0b10001, 0b10001, 0b01110 } },
+        { 'V', { 0b10001, 0b10001, 0b10001, 0b10001, 0b10001, 0b01010, 0b00100 } },
+        { 'W', { 0b10001, 0b10001, 0b10001, 0b10101, 0b10101, 0b10101, 0b01010 } },
+        { 'X', { 0b10001, 0b10001, 0b01010, 0b00100, 0b01010, 0b10001, 0b10001 } },
+        { 'Y', { 0b10001, 0b10001, 0b10001, 0b01010, 0b00100, 0b00100, 0b00100 } },
+        { 'Z', { 0b11111, 0b00001, 0b00010, 0b00100, 0b01000, 0b10000, 0b11111 } },
+        { '_', { 0b00000, 0b00000, 0b00000, 0b00000, 0b00000, 0b00000, 0b11111 } },
+    };
+    const int GLYPH_COUNT = sizeof(FONT) / sizeof(FONT[0]);
+    // an extra fully lit cell at the end of the atlas, used for the backdrop
+    const int SOLID_GLYPH = GLYPH_COUNT;
+    const int CELL_WIDTH = 6;
+    const int CELL_HEIGHT = 8;
+    const int ATLAS_WIDTH = (GLYPH_COUNT + 1) * CELL_WIDTH;
+    const int FLOATS_PER_VERTEX = 8;
+
+    const float TEXT_COLOR[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    const float BACKDROP_COLOR[4] = { 0.0f, 0.0f, 0.0f, 0.6f };
+}
+
+TextOverlay::TextOverlay()
+    : shader(nullptr), VAO(0), VBO(0), capacity(0) {
+}
+
+void TextOverlay::Generate(Shader& shader) {
+    this->shader = &shader;
+
+    // unknown characters map to '?'
+    int fallback = 0;
+    for (int i = 0; i < GLYPH_COUNT; i++)
+        if (FONT[i].character == '?')
+            fallback = i;
+    for (int c = 0; c < 128; c++)
+        this->glyphs[c] = static_cast<unsigned char>(fallback);
+    for (int i = 0; i < GLYPH_COUNT; i++)
+        this->glyphs[static_cast<unsigned char>(FONT[i].character)] = static_cast<unsigned char>(i);
+
+    std::vector<unsigned char> atlas(ATLAS_WIDTH * CELL_HEIGHT, 0);
+    for (int i = 0; i <= GLYPH_COUNT; i++) {
+        for (int row = 0; row < 7; row++) {
+            for (int column = 0; column < 5; column++) {
+                bool lit = i == SOLID_GLYPH || (FONT[i].rows[row] >> (4 - column)) & 1;
+                atlas[row * ATLAS_WIDTH + i * CELL_WIDTH + column] = lit ? 255 : 0;
+            }
+        }
+    }
+    // the solid cell also covers the spacing so backdrop quads have no seams
+    for (int row = 0; row < CELL_HEIGHT; row++)
+        for (int column = 0; column < CELL_WIDTH; column++)
+            atlas[row * ATLAS_WIDTH + SOLID_GLYPH * CELL_WIDTH + column] = 255;
+
+    this->font.internalFormat = GL_R8;
+    this->font.imageFormat = GL_RED;
+    this->font.wrapS = GL_CLAMP_TO_EDGE;
+    this->font.wrapT = GL_CLAMP_TO_EDGE;
+    this->font.filterMin = GL_NEAREST;
+    this->font.filterMax = GL_NEAREST;
+    this->font.Generate(ATLAS_WIDTH, CELL_HEIGHT, atlas.data());
+
+    glGenVertexArrays(1, &this->VAO);
+    glGenBuffers(1, &this->VBO);
+    RenderState::BindVertexArray(this->VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, FLOATS_PER_VERTEX * sizeof(float), (void*)(4 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    RenderState::BindVertexArray(0);
+}
+
+void TextOverlay::Release() {
+    RenderState::BindVertexArray(0);
+    RenderState::BindTexture2D(0, 0);
+    glDeleteVertexArrays(1, &this->VAO);
+    glDeleteBuffers(1, &this->VBO);
+    glDeleteTextures(1, &this->font.id);
+    this->VAO = this->VBO = 0;
+    this->capacity = 0;
+}
+
+void TextOverlay::Draw(const std::vector<std::string>& lines, int x, int y, int viewportWidth, int viewportHeight) {
+    if (lines.empty() || !this->shader)
+        return;
+
+    const float cellWidth = static_cast<float>(CELL_WIDTH * SCALE);
+    const float cellHeight = static_cast<float>(CELL_HEIGHT * SCALE);
+    size_t columns = 0;
+    for (const std::string& line : lines)
+        columns = std::max(columns, line.size());
+
+    this->vertices.clear();
+    this->pushQuad(x - cellWidth * 0.5f, y - cellHeight * 0.5f, x + columns * cellWidth + cellWidth * 0.5f, y + lines.size() * cellHeight + cellHeight * 0.5f,
+        SOLID_GLYPH, BACKDROP_COLOR, viewportWidth, viewportHeight);
+    for (size_t row = 0; row < lines.size(); row++) {
+        for (size_t column = 0; column < lines[row].size(); column++) {
+            unsigned char character = static_cast<unsigned char>(std::toupper(static_cast<unsigned char>(lines[row][column])));
+            if (character == ' ')
+                continue;
+            float left = x + column * cellWidth;
+            float top = y + row * cellHeight;
+            this->pushQuad(left, top, left + cellWidth, top + cellHeight, this->glyphs[character & 0x7F], TEXT_COLOR, viewportWidth, viewportHeight);
+        }
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, this->VBO);
+    if (this->vertices.size() > this->capacity) {
+        this->capacity = this->vertices.size() * 2;
+        glBufferData(GL_ARRAY_BUFFER, this->capacity * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, 0, this->vertices.size() * sizeof(float), this->vertices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    RenderState::SetDepthTest(false);
+    RenderState::SetBlend(true);
+    RenderState::BlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    this->shader->Use();
+    this->font.Bind(0);
+    RenderState::BindVertexArray(this->VAO);
+    glDrawArrays(GL_TRIANGLES, 0, static_cast<GLsizei>(this->vertices.size() / FLOATS_PER_VERTEX));
+
+    RenderState::SetBlend(false);
+    RenderState::SetDepthTest(true);
+}
+
+void TextOverlay::pushQuad(float left, float top, float right, float bottom, int glyph, const float* color, int viewportWidth, int viewportHeight) {
+    // pixels (origin top-left) to normalized device coordinates
+    float x0 = 2.0f * left / viewportWidth - 1.0f;
+    float x1 = 2.0f * right / viewportWidth - 1.0f;
+    float y0 = 1.0f - 2.0f * bottom / viewportHeight;
+    float y1 = 1.0f - 2.0f * top / viewportHeight;
+    // texel row 0 holds the top of the glyphs
+    float u0 = static_cast<float>(glyph * CELL_WIDTH) / ATLAS_WIDTH;
+    float u1 = static_cast<float>((glyph + 1) * CELL_WIDTH) / ATLAS_WIDTH;
+    float v0 = 1.0f;
+    float v1 = 0.0f;
+
+    // counter-clockwise, so back-face culling can stay on
+    const float corners[6][4] = {
+        { x0, y0, u0, v0 }, { x1, y0, u1, v0 }, { x1, y1, u1, v1 },
+        { x0, y0, u0, v0 }, { x1, y1, u1, v1 }, { x0, y1, u0, v1 }
+    };
+    for (const float* corner : corners) {
+        this->vertices.insert(this->vertices.end(), corner, corner + 4);
+        this->vertices.insert(this->vertices.end(), color, color + 4);
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef TEXT_OVERLAY_H
+#define TEXT_OVERLAY_H
+
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "../shader/Shader.h"
+#include "../texture/Texture2D.h"
+
+// Draws lines of text in screen space with a built-in 5x7 pixel font,
+// for debug overlays such as the profiler statistics. Only digits,
+// letters (lower case is drawn as upper case) and a few punctuation
+// marks have glyphs, anything else is drawn as '?'.
+class TextOverlay {
+public:
+    // on-screen size of a font pixel
+    static const int SCALE = 2;
+
+    TextOverlay();
+
+    // creates the font texture and the vertex buffer, shader must be compiled from text.vert/text.frag
+    void Generate(Shader& shader);
+    void Release();
+    // draws the lines over a translucent backdrop with their top-left corner at pixel (x, y)
+    void Draw(const std::vector<std::string>& lines, int x, int y, int viewportWidth, int viewportHeight);
+private:
+    Shader* shader;
+    Texture2D font;
+    unsigned int VAO, VBO;
+    size_t capacity;
+    unsigned char glyphs[128];
+    std::vector<float> vertices;
+
+    void pushQuad(float left, float top, float right, float bottom, int glyph, const float* color, int viewportWidth, int viewportHeight);
+};
+
+#endif
@@ -0,0 +1,107 @@
+#include "ProgramCache.h"
+
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <vector>
+
+#include "../io/MappedFile.h"
+#include "../rendering/GLExtensions.h"
+
+// Instantiate static variables
+int ProgramCache::hits = 0;
+int ProgramCache::misses = 0;
+
+namespace {
+    const char MAGIC[4] = { 'D', 'K', 'P', 'B' };
+    // bump whenever the layout of the file or the key changes
+    const uint32_t VERSION = 1;
+
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint64_t key;
+        uint32_t format;
+        uint32_t length;
+    };
+
+    // 64-bit FNV-1a, every part is prefixed with its length so parts can't run into each other
+    uint64_t hashPart(uint64_t hash, const char* data, size_t length) {
+        uint64_t size = length;
+        const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&size);
+        for (size_t i = 0; i < sizeof(size); i++)
+            hash = (hash ^ bytes[i]) * 1099511628211ull;
+        for (size_t i = 0; i < length; i++)
+            hash = (hash ^ static_cast<unsigned char>(data[i])) * 1099511628211ull;
+        return hash;
+    }
+
+    uint64_t hashString(uint64_t hash, const GLubyte* string) {
+        const char* text = string ? reinterpret_cast<const char*>(string) : "";
+        return hashPart(hash, text, std::strlen(text));
+    }
+}
+
+std::string ProgramCache::PathFor(const char* vertexPath, const char* fragmentPath, const char* geometryPath) {
+    const char* paths[] = { vertexPath, fragmentPath, geometryPath };
+    uint64_t hash = 14695981039346656037ull;
+    for (const char* path : paths)
+        hash = path ? hashPart(hash, path, std::strlen(path)) : hashPart(hash, "", 0);
+    char name[24];
+    std::snprintf(name, sizeof(name), ".%016llx", static_cast<unsigned long long>(hash));
+
+    std::string stem = vertexPath;
+    size_t dot = stem.find_last_of('.');
+    size_t slash = stem.find_last_of("/\\");
+    if (dot != std::string::npos && (slash == std::string::npos || dot > slash))
+        stem.resize(dot);
+    return stem + name + ".program";
+}
+
+uint64_t ProgramCache::Key(const std::string& vertexSource, const std::string& fragmentSource, const std::string& geometrySource) {
+    uint64_t hash = 14695981039346656037ull;
+    hash = hashString(hash, glGetString(GL_VENDOR));
+    hash = hashString(hash, glGetString(GL_RENDERER));
+    hash = hashString(hash, glGetString(GL_VERSION));
+    hash = hashPart(hash, vertexSource.data(), vertexSource.size());
+    hash = hashPart(hash, fragmentSource.data(), fragmentSource.size());
+    hash = hashPart(hash, geometrySource.data(), geometrySource.size());
+    return hash;
+}
+
+bool ProgramCache::Load(const std::string& path, uint64_t key, Shader& shader) {
+    MappedFile file;
+    bool loaded = false;
+    if (GLExtensions::ProgramBinary() && file.Open(path) && file.Size() >= sizeof(Header)) {
+        Header header;
+        std::memcpy(&header, file.Data(), sizeof(header));
+        loaded = std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) == 0 && header.version == VERSION && header.key == key
+            && header.length > 0 && file.Size() == sizeof(Header) + header.length
+            && shader.LoadBinary(header.format, file.Data() + sizeof(Header), static_cast<GLsizei>(header.length));
+    }
+    if (loaded)
+        hits++;
+    else
+        misses++;
+    return loaded;
+}
+
+bool ProgramCache::Write(const std::string& path, uint64_t key, const Shader& shader) {
+    Header header;
+    std::vector<unsigned char> binary;
+    GLenum format = 0;
+    if (!shader.GetBinary(format, binary))
+        return false;
+    std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+    header.version = VERSION;
+    header.key = key;
+    header.format = format;
+    header.length = static_cast<uint32_t>(binary.size());
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(binary.data()), binary.size());
+    return static_cast<bool>(file);
+}
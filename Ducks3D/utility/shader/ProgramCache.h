@@ -0,0 +1,36 @@
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <string>
+#include <cstdint>
+
+#include "Shader.h"
+
+// Linked program binaries kept on disk, so a warm start skips compiling
+// and linking GLSL. A cache file sits next to the program's vertex
+// shader, named after all of its stages, and holds one binary, tagged with a key hashed from the sources
+// and the driver's vendor, renderer and version strings; any change to
+// either makes it stale and the next load compiles from source and
+// replaces it.
+class ProgramCache {
+public:
+    // path of the cache belonging to a program, e.g. basic.vert + basic.frag -> basic.<hash of both paths>.program,
+    // so programs sharing a vertex shader get files of their own. geometryPath may be null
+    static std::string PathFor(const char* vertexPath, const char* fragmentPath, const char* geometryPath);
+    // key of a program built from these sources by the current context's driver, geometrySource may be empty
+    static uint64_t Key(const std::string& vertexSource, const std::string& fragmentSource, const std::string& geometrySource);
+    // creates shader from the cached binary, fails if it is missing, stale, malformed or rejected by the driver
+    static bool Load(const std::string& path, uint64_t key, Shader& shader);
+    // stores the binary of a linked shader under key
+    static bool Write(const std::string& path, uint64_t key, const Shader& shader);
+
+    // programs loaded from / compiled past the cache since the start
+    static int Hits() { return hits; }
+    static int Misses() { return misses; }
+private:
+    ProgramCache() {}
+
+    static int hits, misses;
+};
+
+#endif
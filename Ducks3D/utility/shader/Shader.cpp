@@ -1,98 +1,207 @@
 #include "Shader.h"
 
 #include <iostream>
+#include <cstring>
+
+#include "../rendering/RenderState.h"
+#include "../rendering/FrameUniforms.h"
+#include "../rendering/GLExtensions.h"
 
 Shader& Shader::Use() {
-    glUseProgram(this->id);
+    RenderState::UseProgram(this->id);
     return *this;
 }
 
 void Shader::Compile(const char* vertexSource, const char* fragmentSource, const char* geometrySource) {
-    unsigned int sVertex, sFragment, gShader;
+    this->StartCompile(vertexSource, fragmentSource, geometrySource);
+    this->FinishCompile();
+}
+
+void Shader::StartCompile(const char* vertexSource, const char* fragmentSource, const char* geometrySource) {
     // vertex Shader
-    sVertex = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(sVertex, 1, &vertexSource, NULL);
-    glCompileShader(sVertex);
-    checkCompileErrors(sVertex, "VERTEX");
+    this->stages[0] = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(this->stages[0], 1, &vertexSource, NULL);
+    glCompileShader(this->stages[0]);
     // fragment Shader
-    sFragment = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(sFragment, 1, &fragmentSource, NULL);
-    glCompileShader(sFragment);
-    checkCompileErrors(sFragment, "FRAGMENT");
+    this->stages[1] = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(this->stages[1], 1, &fragmentSource, NULL);
+    glCompileShader(this->stages[1]);
     // if geometry shader source code is given, also compile geometry shader
+    this->stages[2] = 0;
     if (geometrySource != nullptr) {
-        gShader = glCreateShader(GL_GEOMETRY_SHADER);
-        glShaderSource(gShader, 1, &geometrySource, NULL);
-        glCompileShader(gShader);
-        checkCompileErrors(gShader, "GEOMETRY");
+        this->stages[2] = glCreateShader(GL_GEOMETRY_SHADER);
+        glShaderSource(this->stages[2], 1, &geometrySource, NULL);
+        glCompileShader(this->stages[2]);
+    }
+    // shader program, linked right away: a failed compile just makes the link fail too
+    this->id = glCreateProgram();
+    for (unsigned int stage : this->stages) {
+        if (stage != 0)
+            glAttachShader(this->id, stage);
     }
-    // shader program
+    // keeps the binary around for the program cache
+    if (GLExtensions::ProgramBinary())
+        GLExtensions::ProgramParameter(this->id, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    glLinkProgram(this->id);
+}
+
+void Shader::CompileCompute(const char* computeSource) {
+    unsigned int compute = glCreateShader(GL_COMPUTE_SHADER);
+    glShaderSource(compute, 1, &computeSource, NULL);
+    glCompileShader(compute);
+    checkCompileErrors(compute, "COMPUTE");
     this->id = glCreateProgram();
-    glAttachShader(this->id, sVertex);
-    glAttachShader(this->id, sFragment);
-    if (geometrySource != nullptr)
-        glAttachShader(this->id, gShader);
+    glAttachShader(this->id, compute);
     glLinkProgram(this->id);
     checkCompileErrors(this->id, "PROGRAM");
+    setupLinked();
+    glDeleteShader(compute);
+}
+
+bool Shader::IsCompiled() const {
+    if (!this->IsCompiling() || !GLExtensions::ParallelShaderCompile())
+        return true;
+    int completed = 0;
+    glGetProgramiv(this->id, GL_COMPLETION_STATUS_KHR, &completed);
+    return completed != 0;
+}
+
+void Shader::FinishCompile() {
+    if (!this->IsCompiling())
+        return;
+    // the first status query waits for the driver
+    checkCompileErrors(this->stages[0], "VERTEX");
+    checkCompileErrors(this->stages[1], "FRAGMENT");
+    if (this->stages[2] != 0)
+        checkCompileErrors(this->stages[2], "GEOMETRY");
+    checkCompileErrors(this->id, "PROGRAM");
+    setupLinked();
     // delete the shaders as they're linked into our program now and no longer necessary
-    glDeleteShader(sVertex);
-    glDeleteShader(sFragment);
-    if (geometrySource != nullptr)
-        glDeleteShader(gShader);
+    for (unsigned int& stage : this->stages) {
+        if (stage != 0)
+            glDeleteShader(stage);
+        stage = 0;
+    }
+}
+
+bool Shader::LoadBinary(GLenum format, const void* binary, GLsizei length) {
+    if (!GLExtensions::ProgramBinary())
+        return false;
+    this->id = glCreateProgram();
+    GLExtensions::ProgramBinaryData(this->id, format, binary, length);
+    // a binary from another driver build or GPU fails like a link error
+    int success = 0;
+    glGetProgramiv(this->id, GL_LINK_STATUS, &success);
+    if (!success) {
+        glDeleteProgram(this->id);
+        this->id = 0;
+        return false;
+    }
+    setupLinked();
+    return true;
+}
+
+bool Shader::GetBinary(GLenum& format, std::vector<unsigned char>& binary) const {
+    if (!GLExtensions::ProgramBinary())
+        return false;
+    int success = 0, length = 0;
+    glGetProgramiv(this->id, GL_LINK_STATUS, &success);
+    glGetProgramiv(this->id, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (!success || length <= 0)
+        return false;
+    binary.resize(length);
+    GLsizei written = 0;
+    GLExtensions::GetProgramBinary(this->id, length, &written, &format, binary.data());
+    binary.resize(written);
+    return written > 0;
 }
 
 void Shader::SetFloat(const char* name, float value, bool useShader) {
-    if (useShader)
-        this->Use();
-    glUniform1f(glGetUniformLocation(this->id, name), value);
+    this->SetFloat(this->GetUniform(name), value, useShader);
 }
 
 void Shader::SetInteger(const char* name, int value, bool useShader) {
-    if (useShader)
-        this->Use();
-    glUniform1i(glGetUniformLocation(this->id, name), value);
+    this->SetInteger(this->GetUniform(name), value, useShader);
 }
 
 void Shader::SetVector2f(const char* name, float x, float y, bool useShader) {
-    if (useShader)
-        this->Use();
-    glUniform2f(glGetUniformLocation(this->id, name), x, y);
+    this->SetVector2f(this->GetUniform(name), glm::vec2(x, y), useShader);
 }
 
 void Shader::SetVector2f(const char* name, const glm::vec2& value, bool useShader) {
+    this->SetVector2f(this->GetUniform(name), value, useShader);
+}
+
+void Shader::SetVector3f(const char* name, float x, float y, float z, bool useShader) {
+    this->SetVector3f(this->GetUniform(name), glm::vec3(x, y, z), useShader);
+}
+
+void Shader::SetVector3f(const char* name, const glm::vec3& value, bool useShader) {
+    this->SetVector3f(this->GetUniform(name), value, useShader);
+}
+
+void Shader::SetVector4f(const char* name, float x, float y, float z, float w, bool useShader) {
+    this->SetVector4f(this->GetUniform(name), glm::vec4(x, y, z, w), useShader);
+}
+
+void Shader::SetVector4f(const char* name, const glm::vec4& value, bool useShader) {
+    this->SetVector4f(this->GetUniform(name), value, useShader);
+}
+
+void Shader::SetMatrix4(const char* name, const glm::mat4& matrix, bool useShader) {
+    this->SetMatrix4(this->GetUniform(name), matrix, useShader);
+}
+
+UniformHandle Shader::GetUniform(const char* name) const {
+    UniformHandle handle;
+    if (this->uniforms) {
+        auto iter = this->uniforms->indices.find(name);
+        if (iter != this->uniforms->indices.end())
+            handle.index = iter->second;
+    }
+    return handle;
+}
+
+void Shader::SetFloat(UniformHandle uniform, float value, bool useShader) {
     if (useShader)
         this->Use();
-    glUniform2f(glGetUniformLocation(this->id, name), value.x, value.y);
+    if (this->updateCache(uniform, &value, sizeof(value)))
+        glUniform1f(this->uniforms->slots[uniform.index].location, value);
 }
 
-void Shader::SetVector3f(const char* name, float x, float y, float z, bool useShader) {
+void Shader::SetInteger(UniformHandle uniform, int value, bool useShader) {
     if (useShader)
         this->Use();
-    glUniform3f(glGetUniformLocation(this->id, name), x, y, z);
+    if (this->updateCache(uniform, &value, sizeof(value)))
+        glUniform1i(this->uniforms->slots[uniform.index].location, value);
 }
 
-void Shader::SetVector3f(const char* name, const glm::vec3& value, bool useShader) {
+void Shader::SetVector2f(UniformHandle uniform, const glm::vec2& value, bool useShader) {
     if (useShader)
         this->Use();
-    glUniform3f(glGetUniformLocation(this->id, name), value.x, value.y, value.z);
+    if (this->updateCache(uniform, glm::value_ptr(value), sizeof(value)))
+        glUniform2f(this->uniforms->slots[uniform.index].location, value.x, value.y);
 }
 
-void Shader::SetVector4f(const char* name, float x, float y, float z, float w, bool useShader) {
+void Shader::SetVector3f(UniformHandle uniform, const glm::vec3& value, bool useShader) {
     if (useShader)
         this->Use();
-    glUniform4f(glGetUniformLocation(this->id, name), x, y, z, w);
+    if (this->updateCache(uniform, glm::value_ptr(value), sizeof(value)))
+        glUniform3f(this->uniforms->slots[uniform.index].location, value.x, value.y, value.z);
 }
 
-void Shader::SetVector4f(const char* name, const glm::vec4& value, bool useShader) {
+void Shader::SetVector4f(UniformHandle uniform, const glm::vec4& value, bool useShader) {
     if (useShader)
         this->Use();
-    glUniform4f(glGetUniformLocation(this->id, name), value.x, value.y, value.z, value.w);
+    if (this->updateCache(uniform, glm::value_ptr(value), sizeof(value)))
+        glUniform4f(this->uniforms->slots[uniform.index].location, value.x, value.y, value.z, value.w);
 }
 
-void Shader::SetMatrix4(const char* name, const glm::mat4& matrix, bool useShader) {
+void Shader::SetMatrix4(UniformHandle uniform, const glm::mat4& matrix, bool useShader) {
     if (useShader)
         this->Use();
-    glUniformMatrix4fv(glGetUniformLocation(this->id, name), 1, false, glm::value_ptr(matrix));
+    if (this->updateCache(uniform, glm::value_ptr(matrix), sizeof(matrix)))
+        glUniformMatrix4fv(this->uniforms->slots[uniform.index].location, 1, false, glm::value_ptr(matrix));
 }
 
 void Shader::checkCompileErrors(unsigned int object, std::string type) {
@@ -116,3 +225,51 @@ void Shader::checkCompileErrors(unsigned int object, std::string type) {
         }
     }
 }
+
+void Shader::setupLinked() {
+    buildUniformTable();
+    // GLSL 3.30 can't declare block bindings, programs reading the per-frame block are pointed at it here
+    GLuint frameBlock = glGetUniformBlockIndex(this->id, FrameUniforms::BLOCK_NAME);
+    if (frameBlock != GL_INVALID_INDEX)
+        glUniformBlockBinding(this->id, frameBlock, FrameUniforms::BINDING);
+}
+
+void Shader::buildUniformTable() {
+    this->uniforms = std::make_shared<UniformTable>();
+    int count = 0, maxLength = 0;
+    glGetProgramiv(this->id, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(this->id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    std::vector<char> name(maxLength > 0 ? maxLength : 1);
+    for (int i = 0; i < count; i++) {
+        GLsizei length;
+        GLint size;
+        GLenum type;
+        glGetActiveUniform(this->id, i, static_cast<GLsizei>(name.size()), &length, &size, &type, name.data());
+        std::string uniformName(name.data(), length);
+        // members of uniform blocks have no location
+        int location = glGetUniformLocation(this->id, uniformName.c_str());
+        if (location < 0)
+            continue;
+        UniformSlot slot;
+        slot.location = location;
+        slot.uploaded = false;
+        int index = static_cast<int>(this->uniforms->slots.size());
+        this->uniforms->slots.push_back(slot);
+        this->uniforms->indices[uniformName] = index;
+        // arrays are reported as "name[0]", also make them reachable by their plain name
+        size_t bracket = uniformName.find('[');
+        if (bracket != std::string::npos)
+            this->uniforms->indices[uniformName.substr(0, bracket)] = index;
+    }
+}
+
+bool Shader::updateCache(UniformHandle uniform, const void* value, size_t size) {
+    if (!uniform.IsValid() || !this->uniforms || uniform.index >= static_cast<int>(this->uniforms->slots.size()))
+        return false;
+    UniformSlot& slot = this->uniforms->slots[uniform.index];
+    if (slot.uploaded && std::memcmp(slot.value, value, size) == 0)
+        return false;
+    std::memcpy(slot.value, value, size);
+    slot.uploaded = true;
+    return true;
+}
\ No newline at end of file
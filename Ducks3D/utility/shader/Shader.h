@@ -2,11 +2,20 @@
 #define SHADER_H
 
 #include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
 
 #include <glad/glad.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
+// index into a shader's uniform table, resolved once by name so per-frame sets do no string work
+struct UniformHandle {
+    int index = -1;
+    bool IsValid() const { return index >= 0; }
+};
+
 class Shader {
 public:
     unsigned int id;
@@ -15,6 +24,21 @@ public:
 
     Shader& Use();
     void Compile(const char* vertexSource, const char* fragmentSource, const char* geometrySource = nullptr);
+    // Compile split in two: StartCompile submits compiling and linking without asking for any
+    // result, so the driver can work on several programs at once. The program can't be used
+    // before FinishCompile, which checks the results and blocks if they aren't there yet
+    void StartCompile(const char* vertexSource, const char* fragmentSource, const char* geometrySource = nullptr);
+    // compiles and links a compute program right away, see GLExtensions::ComputeShaders
+    void CompileCompute(const char* computeSource);
+    // true once FinishCompile won't block; polls GL_COMPLETION_STATUS_KHR where supported, else always true
+    bool IsCompiled() const;
+    void FinishCompile();
+    // between StartCompile and FinishCompile
+    bool IsCompiling() const { return stages[0] != 0; }
+    // creates the program from a binary retrieved with GetBinary, returns false if the driver rejects it
+    bool LoadBinary(GLenum format, const void* binary, GLsizei length);
+    // the driver's binary of the linked program, false if there is none (see GLExtensions::ProgramBinary)
+    bool GetBinary(GLenum& format, std::vector<unsigned char>& binary) const;
     void SetFloat(const char* name, float value, bool useShader = false);
     void SetInteger(const char* name, int value, bool useShader = false);
     void SetVector2f(const char* name, float x, float y, bool useShader = false);
@@ -24,8 +48,37 @@ public:
     void SetVector4f(const char* name, float x, float y, float z, float w, bool useShader = false);
     void SetVector4f(const char* name, const glm::vec4& value, bool useShader = false);
     void SetMatrix4(const char* name, const glm::mat4& matrix, bool useShader = false);
+    // resolves an active uniform of the linked program, unknown names give an invalid handle whose sets are ignored
+    UniformHandle GetUniform(const char* name) const;
+    void SetFloat(UniformHandle uniform, float value, bool useShader = false);
+    void SetInteger(UniformHandle uniform, int value, bool useShader = false);
+    void SetVector2f(UniformHandle uniform, const glm::vec2& value, bool useShader = false);
+    void SetVector3f(UniformHandle uniform, const glm::vec3& value, bool useShader = false);
+    void SetVector4f(UniformHandle uniform, const glm::vec4& value, bool useShader = false);
+    void SetMatrix4(UniformHandle uniform, const glm::mat4& matrix, bool useShader = false);
 private:
+    // location of an active uniform plus the last value uploaded to it
+    struct UniformSlot {
+        int location;
+        unsigned char value[sizeof(glm::mat4)];
+        bool uploaded;
+    };
+    struct UniformTable {
+        std::vector<UniformSlot> slots;
+        std::unordered_map<std::string, int> indices;
+    };
+    // shared so every copy of a Shader handed out by the ResourceManager sees the same cached values
+    std::shared_ptr<UniformTable> uniforms;
+    // vertex, fragment and geometry shader objects until FinishCompile, 0 if absent
+    unsigned int stages[3] = { 0, 0, 0 };
+
     void checkCompileErrors(unsigned int object, std::string type);
+    // state every linked program needs, however it was created
+    void setupLinked();
+    // walks the active uniforms of the linked program and records their locations
+    void buildUniformTable();
+    // records value as the current one of the uniform, returns false if it is already uploaded
+    bool updateCache(UniformHandle uniform, const void* value, size_t size);
 };
 
 #endif
\ No newline at end of file
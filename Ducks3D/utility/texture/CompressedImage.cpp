@@ -0,0 +1,274 @@
+#include "CompressedImage.h"
+
+#include <cstdint>
+#include <cstring>
+#include <cctype>
+#include <algorithm>
+
+#include "../io/MappedFile.h"
+#include "../rendering/GLExtensions.h"
+
+namespace {
+    const uint32_t DDS_MAGIC = 0x20534444; // "DDS "
+    const uint32_t DDPF_FOURCC = 0x4;
+    const uint32_t DDSCAPS2_CUBEMAP = 0x200;
+    const uint32_t DDSCAPS2_VOLUME = 0x200000;
+    const uint32_t D3D10_RESOURCE_DIMENSION_TEXTURE2D = 3;
+
+    struct DDSHeader {
+        uint32_t size;
+        uint32_t flags;
+        uint32_t height;
+        uint32_t width;
+        uint32_t pitchOrLinearSize;
+        uint32_t depth;
+        uint32_t mipMapCount;
+        uint32_t reserved1[11];
+        // DDS_PIXELFORMAT
+        uint32_t pixelFormatSize;
+        uint32_t pixelFormatFlags;
+        uint32_t fourCC;
+        uint32_t rgbBitCount;
+        uint32_t masks[4];
+        uint32_t caps, caps2, caps3, caps4;
+        uint32_t reserved2;
+    };
+
+    struct DDSHeaderDX10 {
+        uint32_t dxgiFormat;
+        uint32_t resourceDimension;
+        uint32_t miscFlag;
+        uint32_t arraySize;
+        uint32_t miscFlags2;
+    };
+
+    const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+    struct KTX2Header {
+        unsigned char identifier[12];
+        uint32_t vkFormat;
+        uint32_t typeSize;
+        uint32_t pixelWidth;
+        uint32_t pixelHeight;
+        uint32_t pixelDepth;
+        uint32_t layerCount;
+        uint32_t faceCount;
+        uint32_t levelCount;
+        uint32_t supercompressionScheme;
+        uint32_t dfdByteOffset;
+        uint32_t dfdByteLength;
+        uint32_t kvdByteOffset;
+        uint32_t kvdByteLength;
+        uint64_t sgdByteOffset;
+        uint64_t sgdByteLength;
+    };
+
+    struct KTX2Level {
+        uint64_t byteOffset;
+        uint64_t byteLength;
+        uint64_t uncompressedByteLength;
+    };
+
+    uint32_t fourCC(char a, char b, char c, char d) {
+        return uint32_t(uint8_t(a)) | uint32_t(uint8_t(b)) << 8 | uint32_t(uint8_t(c)) << 16 | uint32_t(uint8_t(d)) << 24;
+    }
+
+    GLenum formatFromFourCC(uint32_t code) {
+        if (code == fourCC('D', 'X', 'T', '1')) return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+        if (code == fourCC('D', 'X', 'T', '3')) return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+        if (code == fourCC('D', 'X', 'T', '5')) return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        if (code == fourCC('A', 'T', 'I', '1') || code == fourCC('B', 'C', '4', 'U')) return GL_COMPRESSED_RED_RGTC1;
+        if (code == fourCC('A', 'T', 'I', '2') || code == fourCC('B', 'C', '5', 'U')) return GL_COMPRESSED_RG_RGTC2;
+        return 0;
+    }
+
+    GLenum formatFromDXGI(uint32_t format) {
+        switch (format) {
+        case 71: return GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;        // BC1_UNORM
+        case 72: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT;  // BC1_UNORM_SRGB
+        case 74: return GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;        // BC2_UNORM
+        case 75: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT;  // BC2_UNORM_SRGB
+        case 77: return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;        // BC3_UNORM
+        case 78: return GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT;  // BC3_UNORM_SRGB
+        case 80: return GL_COMPRESSED_RED_RGTC1;                 // BC4_UNORM
+        case 81: return GL_COMPRESSED_SIGNED_RED_RGTC1;          // BC4_SNORM
+        case 83: return GL_COMPRESSED_RG_RGTC2;                  // BC5_UNORM
+        case 84: return GL_COMPRESSED_SIGNED_RG_RGTC2;           // BC5_SNORM
+        case 95: return GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT;   // BC6H_UF16
+        case 96: return GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT;     // BC6H_SF16
+        case 98: return GL_COMPRESSED_RGBA_BPTC_UNORM;           // BC7_UNORM
+        case 99: return GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM;     // BC7_UNORM_SRGB
+        default: return 0;
+        }
+    }
+
+    GLenum formatFromVulkan(uint32_t format) {
+        // VK_FORMAT_BC1_RGB_UNORM_BLOCK (131) up to VK_FORMAT_EAC_R11G11_SNORM_BLOCK (156) are contiguous
+        static const GLenum formats[] = {
+            GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GL_COMPRESSED_SRGB_S3TC_DXT1_EXT,
+            GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT,
+            GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT,
+            GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT,
+            GL_COMPRESSED_RED_RGTC1, GL_COMPRESSED_SIGNED_RED_RGTC1,
+            GL_COMPRESSED_RG_RGTC2, GL_COMPRESSED_SIGNED_RG_RGTC2,
+            GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT, GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT,
+            GL_COMPRESSED_RGBA_BPTC_UNORM, GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM,
+            GL_COMPRESSED_RGB8_ETC2, GL_COMPRESSED_SRGB8_ETC2,
+            GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2, GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2,
+            GL_COMPRESSED_RGBA8_ETC2_EAC, GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC,
+            GL_COMPRESSED_R11_EAC, GL_COMPRESSED_SIGNED_R11_EAC,
+            GL_COMPRESSED_RG11_EAC, GL_COMPRESSED_SIGNED_RG11_EAC
+        };
+        if (format < 131 || format >= 131 + sizeof(formats) / sizeof(formats[0]))
+            return 0;
+        return formats[format - 131];
+    }
+
+    bool hasExtension(const std::string& path, const char* extension) {
+        size_t length = std::strlen(extension);
+        if (path.size() < length)
+            return false;
+        return std::equal(path.end() - length, path.end(), extension,
+            [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == b; });
+    }
+}
+
+CompressedImage::CompressedImage()
+    : format(0), width(0), height(0) {
+}
+
+bool CompressedImage::IsContainer(const std::string& path) {
+    return hasExtension(path, ".dds") || hasExtension(path, ".ktx2");
+}
+
+bool CompressedImage::Load(const std::string& path, CompressedImage& image) {
+    MappedFile file;
+    if (!file.Open(path))
+        return false;
+    image = CompressedImage();
+    if (hasExtension(path, ".dds"))
+        return image.loadDDS(file.Data(), file.Size());
+    return image.loadKTX2(file.Data(), file.Size());
+}
+
+unsigned int CompressedImage::BlockSize(GLenum format) {
+    switch (format) {
+    case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT:
+    case GL_COMPRESSED_RED_RGTC1:
+    case GL_COMPRESSED_SIGNED_RED_RGTC1:
+    case GL_COMPRESSED_RGB8_ETC2:
+    case GL_COMPRESSED_SRGB8_ETC2:
+    case GL_COMPRESSED_RGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+    case GL_COMPRESSED_SRGB8_PUNCHTHROUGH_ALPHA1_ETC2:
+    case GL_COMPRESSED_R11_EAC:
+    case GL_COMPRESSED_SIGNED_R11_EAC:
+        return 8;
+    case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT:
+    case GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT:
+    case GL_COMPRESSED_RG_RGTC2:
+    case GL_COMPRESSED_SIGNED_RG_RGTC2:
+    case GL_COMPRESSED_RGBA_BPTC_UNORM:
+    case GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM:
+    case GL_COMPRESSED_RGB_BPTC_SIGNED_FLOAT:
+    case GL_COMPRESSED_RGB_BPTC_UNSIGNED_FLOAT:
+    case GL_COMPRESSED_RGBA8_ETC2_EAC:
+    case GL_COMPRESSED_SRGB8_ALPHA8_ETC2_EAC:
+    case GL_COMPRESSED_RG11_EAC:
+    case GL_COMPRESSED_SIGNED_RG11_EAC:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+bool CompressedImage::loadDDS(const unsigned char* file, size_t size) {
+    uint32_t magic;
+    DDSHeader header;
+    if (size < sizeof(magic) + sizeof(header))
+        return false;
+    std::memcpy(&magic, file, sizeof(magic));
+    std::memcpy(&header, file + sizeof(magic), sizeof(header));
+    if (magic != DDS_MAGIC || header.size != sizeof(header) || !(header.pixelFormatFlags & DDPF_FOURCC))
+        return false;
+    if (header.caps2 & (DDSCAPS2_CUBEMAP | DDSCAPS2_VOLUME))
+        return false;
+
+    size_t offset = sizeof(magic) + sizeof(header);
+    if (header.fourCC == fourCC('D', 'X', '1', '0')) {
+        DDSHeaderDX10 extended;
+        if (size < offset + sizeof(extended))
+            return false;
+        std::memcpy(&extended, file + offset, sizeof(extended));
+        offset += sizeof(extended);
+        if (extended.resourceDimension != D3D10_RESOURCE_DIMENSION_TEXTURE2D || extended.arraySize > 1)
+            return false;
+        this->format = formatFromDXGI(extended.dxgiFormat);
+    }
+    else {
+        this->format = formatFromFourCC(header.fourCC);
+    }
+    if (this->format == 0 || header.width == 0 || header.height == 0)
+        return false;
+
+    this->width = header.width;
+    this->height = header.height;
+    // the levels follow the headers back to back, largest first
+    unsigned int levelCount = std::max(1u, header.mipMapCount);
+    for (unsigned int level = 0; level < levelCount; level++) {
+        if (!appendLevel(file + offset, size - offset))
+            return false;
+        offset += this->levels.back().size;
+    }
+    return true;
+}
+
+bool CompressedImage::loadKTX2(const unsigned char* file, size_t size) {
+    KTX2Header header;
+    if (size < sizeof(header))
+        return false;
+    std::memcpy(&header, file, sizeof(header));
+    if (std::memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+        return false;
+    // 3D textures, arrays, cube maps and supercompressed payloads would need more than a plain upload
+    if (header.pixelDepth > 0 || header.layerCount > 1 || header.faceCount != 1 || header.supercompressionScheme != 0)
+        return false;
+    this->format = formatFromVulkan(header.vkFormat);
+    if (this->format == 0 || header.pixelWidth == 0 || header.pixelHeight == 0)
+        return false;
+
+    this->width = header.pixelWidth;
+    this->height = header.pixelHeight;
+    // a level count of 0 asks the loader to generate mips, compressed formats can't, so only the base is used
+    unsigned int levelCount = std::max(1u, header.levelCount);
+    if (size < sizeof(header) + levelCount * sizeof(KTX2Level))
+        return false;
+    // the level index is ordered largest first, the payloads are stored smallest first
+    for (unsigned int level = 0; level < levelCount; level++) {
+        KTX2Level entry;
+        std::memcpy(&entry, file + sizeof(header) + level * sizeof(KTX2Level), sizeof(entry));
+        if (entry.byteOffset > size || entry.byteLength > size - entry.byteOffset)
+            return false;
+        if (!appendLevel(file + entry.byteOffset, static_cast<size_t>(entry.byteLength)))
+            return false;
+    }
+    return true;
+}
+
+bool CompressedImage::appendLevel(const unsigned char* source, size_t available) {
+    unsigned int level = static_cast<unsigned int>(this->levels.size());
+    Level entry;
+    entry.width = std::max(1u, this->width >> level);
+    entry.height = std::max(1u, this->height >> level);
+    entry.offset = this->data.size();
+    entry.size = static_cast<size_t>((entry.width + 3) / 4) * ((entry.height + 3) / 4) * BlockSize(this->format);
+    if (entry.size > available)
+        return false;
+    this->data.insert(this->data.end(), source, source + entry.size);
+    this->levels.push_back(entry);
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef COMPRESSED_IMAGE_H
+#define COMPRESSED_IMAGE_H
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include <glad/glad.h>
+
+// A block compressed 2D image with its mip chain, read from a DDS or
+// KTX2 container. BC1-BC7 and ETC2/EAC payloads are supported, they are
+// uploaded as they are so the GPU samples the compressed blocks directly.
+// Cube maps, arrays, volumes and supercompressed (Basis, zstd) KTX2 files
+// are rejected.
+class CompressedImage {
+public:
+    struct Level {
+        unsigned int width, height;
+        // byte range of the level in data
+        size_t offset, size;
+    };
+
+    // GL compressed internal format of the blocks
+    GLenum format;
+    unsigned int width, height;
+    // largest level first
+    std::vector<Level> levels;
+    // all levels packed back to back
+    std::vector<unsigned char> data;
+
+    CompressedImage();
+
+    // true if path names a container Load understands (.dds or .ktx2)
+    static bool IsContainer(const std::string& path);
+    // reads the container at path, fails if it is missing, malformed or holds an unsupported format
+    static bool Load(const std::string& path, CompressedImage& image);
+    // bytes of one 4x4 block of format, 0 for formats Load doesn't produce
+    static unsigned int BlockSize(GLenum format);
+private:
+    bool loadDDS(const unsigned char* file, size_t size);
+    bool loadKTX2(const unsigned char* file, size_t size);
+    // appends the next mip level, copied from source which has to hold at least its size in bytes
+    bool appendLevel(const unsigned char* source, size_t available);
+};
+
+#endif
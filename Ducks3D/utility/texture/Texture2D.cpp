@@ -1,27 +1,127 @@
 #include <iostream>
+#include <cstdint>
+#include <algorithm>
 
 #include "Texture2D.h"
+#include "CompressedImage.h"
+#include "../rendering/RenderState.h"
+#include "../rendering/GLExtensions.h"
+
+namespace {
+    // sized counterpart of the unsized formats used for internalFormat, immutable storage requires one
+    GLenum sizedFormat(GLenum format) {
+        switch (format) {
+        case GL_RED: return GL_R8;
+        case GL_RG: return GL_RG8;
+        case GL_RGB: return GL_RGB8;
+        case GL_RGBA: return GL_RGBA8;
+        default: return format;
+        }
+    }
+
+    unsigned int fullMipChain(unsigned int width, unsigned int height) {
+        unsigned int levels = 1;
+        for (unsigned int size = std::max(width, height); size > 1; size >>= 1)
+            levels++;
+        return levels;
+    }
+}
 
 Texture2D::Texture2D()
-    : width(0), height(0), internalFormat(GL_RGB), imageFormat(GL_RGB), wrapS(GL_REPEAT), wrapT(GL_REPEAT), filterMin(GL_LINEAR), filterMax(GL_LINEAR) {
+    : width(0), height(0), levels(0), internalFormat(GL_RGB), imageFormat(GL_RGB), wrapS(GL_REPEAT), wrapT(GL_REPEAT),
+    filterMin(GL_LINEAR_MIPMAP_LINEAR), filterMax(GL_LINEAR), maxAnisotropy(16.0f), immutable(false) {
     glGenTextures(1, &this->id);
 }
 
-void Texture2D::Generate(unsigned int width, unsigned int height, unsigned char* data) {
+void Texture2D::Generate(unsigned int width, unsigned int height, const unsigned char* data) {
+    generate(width, height, data, data != nullptr);
+}
+
+void Texture2D::GenerateFromBuffer(unsigned int width, unsigned int height, size_t offset) {
+    generate(width, height, reinterpret_cast<const void*>(static_cast<uintptr_t>(offset)), true);
+}
+
+void Texture2D::GenerateCompressed(const CompressedImage& image) {
+    generateCompressed(image, image.data.data(), 0);
+}
+
+void Texture2D::GenerateCompressedFromBuffer(const CompressedImage& image, size_t offset) {
+    generateCompressed(image, nullptr, offset);
+}
+
+void Texture2D::Bind(unsigned int unit) const {
+    RenderState::BindTexture2D(unit, this->id);
+}
+
+void Texture2D::generate(unsigned int width, unsigned int height, const void* pixels, bool upload) {
     this->width = width;
     this->height = height;
-    // create Texture
-    glBindTexture(GL_TEXTURE_2D, this->id);
-    glTexImage2D(GL_TEXTURE_2D, 0, this->internalFormat, width, height, 0, this->imageFormat, GL_UNSIGNED_BYTE, data);
+    this->levels = usesMipmaps() ? fullMipChain(width, height) : 1;
+    prepareStorage();
+    // rows of RGB and single channel images aren't 4-byte aligned for most widths
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    if (GLExtensions::TextureStorage()) {
+        GLExtensions::TexStorage2D(GL_TEXTURE_2D, this->levels, sizedFormat(this->internalFormat), width, height);
+        this->immutable = true;
+        if (upload)
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, width, height, this->imageFormat, GL_UNSIGNED_BYTE, pixels);
+    }
+    else {
+        glTexImage2D(GL_TEXTURE_2D, 0, this->internalFormat, width, height, 0, this->imageFormat, GL_UNSIGNED_BYTE, upload ? pixels : nullptr);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    // without immutable storage the chain is only complete up to the levels that exist
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, this->levels - 1);
+    if (this->levels > 1 && upload)
+        glGenerateMipmap(GL_TEXTURE_2D);
+    setParameters();
+}
+
+void Texture2D::generateCompressed(const CompressedImage& image, const unsigned char* data, size_t offset) {
+    this->width = image.width;
+    this->height = image.height;
+    this->levels = static_cast<unsigned int>(image.levels.size());
+    this->internalFormat = image.format;
+    prepareStorage();
+    if (GLExtensions::TextureStorage()) {
+        GLExtensions::TexStorage2D(GL_TEXTURE_2D, this->levels, image.format, image.width, image.height);
+        this->immutable = true;
+    }
+    for (unsigned int i = 0; i < this->levels; i++) {
+        const CompressedImage::Level& level = image.levels[i];
+        // with an unpack buffer bound the pointer is an offset into it
+        const void* pixels = data ? static_cast<const void*>(data + offset + level.offset)
+            : reinterpret_cast<const void*>(static_cast<uintptr_t>(offset + level.offset));
+        if (this->immutable)
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, i, 0, 0, level.width, level.height, image.format, static_cast<GLsizei>(level.size), pixels);
+        else
+            glCompressedTexImage2D(GL_TEXTURE_2D, i, image.format, level.width, level.height, 0, static_cast<GLsizei>(level.size), pixels);
+    }
+    // compressed images can't be mipmapped on the GPU, so sampling is limited to the levels the file ships
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, this->levels - 1);
+    setParameters();
+}
+
+void Texture2D::prepareStorage() {
+    if (this->immutable) {
+        RenderState::DeleteTexture(this->id);
+        glGenTextures(1, &this->id);
+        this->immutable = false;
+    }
+    RenderState::BindTexture2D(0, this->id);
+}
+
+void Texture2D::setParameters() {
     // set Texture wrap and filter modes
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, this->wrapS);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, this->wrapT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, this->filterMin);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, this->filterMax);
-    // unbind texture
-    glBindTexture(GL_TEXTURE_2D, 0);
+    if (GLExtensions::AnisotropicFiltering() && usesMipmaps())
+        glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY, std::min(this->maxAnisotropy, GLExtensions::MaxAnisotropy()));
 }
 
-void Texture2D::Bind() const {
-    glBindTexture(GL_TEXTURE_2D, this->id);
+bool Texture2D::usesMipmaps() const {
+    return this->filterMin == GL_NEAREST_MIPMAP_NEAREST || this->filterMin == GL_LINEAR_MIPMAP_NEAREST
+        || this->filterMin == GL_NEAREST_MIPMAP_LINEAR || this->filterMin == GL_LINEAR_MIPMAP_LINEAR;
 }
@@ -1,23 +1,52 @@
 #ifndef TEXTURE_H
 #define TEXTURE_H
 
+#include <cstddef>
+
 #include <glad/glad.h>
 
+class CompressedImage;
+
+// A 2D texture. Storage is immutable (glTexStorage2D) where the context
+// supports it, so generating an immutable texture again gives it a new GL
+// name. With a mipmap min filter the full mip chain is allocated, and
+// generated for uncompressed images, and sampling is anisotropic up to
+// maxAnisotropy.
 class Texture2D {
 public:
     unsigned int id;
     unsigned int width, height; 
+    // mip levels of the current storage
+    unsigned int levels;
     // texture Format
     unsigned int internalFormat; // format of texture object
     unsigned int imageFormat; // format of loaded image
     // texture configuration
     unsigned int wrapS, wrapT; // wrapping mode on S and T axis
     unsigned int filterMin, filterMax; // filtering mode
+    float maxAnisotropy; // clamped to what the driver supports, only used with a mipmap min filter
     
     Texture2D();
     
-    void Generate(unsigned int width, unsigned int height, unsigned char* data);
-    void Bind() const;
+    void Generate(unsigned int width, unsigned int height, const unsigned char* data);
+    // like Generate, but the image is read from the bound GL_PIXEL_UNPACK_BUFFER at offset
+    void GenerateFromBuffer(unsigned int width, unsigned int height, size_t offset);
+    // uploads every level of a block compressed image as is, internalFormat becomes the image's format
+    void GenerateCompressed(const CompressedImage& image);
+    // like GenerateCompressed, but the image's data is read from the bound GL_PIXEL_UNPACK_BUFFER at offset
+    void GenerateCompressedFromBuffer(const CompressedImage& image, size_t offset);
+    // binds the texture to the given texture unit
+    void Bind(unsigned int unit = 0) const;
+private:
+    // true once the storage was allocated with glTexStorage2D
+    bool immutable;
+
+    void generate(unsigned int width, unsigned int height, const void* pixels, bool upload);
+    void generateCompressed(const CompressedImage& image, const unsigned char* data, size_t offset);
+    // binds the texture, replacing its name first if the storage can't be respecified
+    void prepareStorage();
+    void setParameters();
+    bool usesMipmaps() const;
 };
 
 #endif
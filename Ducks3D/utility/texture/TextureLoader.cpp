@@ -0,0 +1,192 @@
+#include "TextureLoader.h"
+
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+
+#include <stb_image.h>
+
+#include "../rendering/GLExtensions.h"
+
+TextureLoader::TextureLoader()
+    : stopping(false), nextPbo(0) {
+    for (unsigned int& pbo : pbos)
+        pbo = 0;
+}
+
+TextureLoader::~TextureLoader() {
+    // no GL calls here, the context is usually gone by the time statics are destroyed
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    requestReady.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+    for (DecodedImage& image : decoded)
+        stbi_image_free(image.pixels);
+}
+
+void TextureLoader::Request(Handle handle, const std::string& file, int channels) {
+    if (workers.empty())
+        start();
+    pending.push_back(handle);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        requests.push_back({ handle, file, channels });
+    }
+    requestReady.notify_one();
+}
+
+size_t TextureLoader::Upload(SlotArray<Texture2D>& textures, size_t byteBudget) {
+    size_t count = 0;
+    size_t bytes = 0;
+    while (true) {
+        DecodedImage image;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (decoded.empty())
+                break;
+            size_t size = byteSize(decoded.front());
+            if (count > 0 && bytes + size > byteBudget)
+                break;
+            image = decoded.front();
+            decoded.pop_front();
+            bytes += size;
+        }
+        upload(textures, image);
+        count++;
+    }
+    return count;
+}
+
+void TextureLoader::Finish(SlotArray<Texture2D>& textures) {
+    while (!pending.empty()) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            decodedReady.wait(lock, [this]() { return !decoded.empty(); });
+        }
+        Upload(textures, ~size_t(0));
+    }
+}
+
+bool TextureLoader::IsPending(Handle handle) const {
+    return std::find(pending.begin(), pending.end(), handle) != pending.end();
+}
+
+void TextureLoader::Release() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    requestReady.notify_all();
+    for (std::thread& worker : workers)
+        worker.join();
+    workers.clear();
+    stopping = false;
+    requests.clear();
+    for (DecodedImage& image : decoded)
+        stbi_image_free(image.pixels);
+    decoded.clear();
+    pending.clear();
+    if (pbos[0] != 0)
+        glDeleteBuffers(PBO_COUNT, pbos);
+    for (unsigned int& pbo : pbos)
+        pbo = 0;
+    nextPbo = 0;
+}
+
+void TextureLoader::start() {
+    // leave a core to the GL thread, hardware_concurrency may report 0
+    unsigned int count = std::max(2u, std::thread::hardware_concurrency()) - 1;
+    for (unsigned int i = 0; i < count; i++)
+        workers.emplace_back(&TextureLoader::workerLoop, this);
+}
+
+void TextureLoader::workerLoop() {
+    while (true) {
+        DecodeJob job;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            requestReady.wait(lock, [this]() { return stopping || !requests.empty(); });
+            if (stopping)
+                return;
+            job = requests.front();
+            requests.pop_front();
+        }
+        DecodedImage image;
+        image.handle = job.handle;
+        image.file = job.file;
+        image.channels = job.channels;
+        image.pixels = nullptr;
+        image.isCompressed = CompressedImage::IsContainer(job.file);
+        if (image.isCompressed) {
+            // the blocks are uploaded as they are, there is nothing to decode
+            if (!CompressedImage::Load(job.file, image.compressed))
+                image.compressed = CompressedImage();
+        }
+        else {
+            int fileChannels;
+            image.pixels = stbi_load(job.file.c_str(), &image.width, &image.height, &fileChannels, job.channels);
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            decoded.push_back(image);
+        }
+        decodedReady.notify_one();
+    }
+}
+
+void TextureLoader::upload(SlotArray<Texture2D>& textures, DecodedImage& image) {
+    auto found = std::find(pending.begin(), pending.end(), image.handle);
+    if (found != pending.end())
+        pending.erase(found);
+    Texture2D* texture = textures.Get(image.handle);
+    if (image.isCompressed ? image.compressed.levels.empty() : !image.pixels) {
+        // the texture keeps its placeholder
+        std::cout << "ERROR::TEXTURE: Failed to load " << image.file << std::endl;
+        return;
+    }
+    if (image.isCompressed && !GLExtensions::SupportsCompressedFormat(image.compressed.format)) {
+        std::cout << "ERROR::TEXTURE: " << image.file << " uses a compressed format the driver doesn't support" << std::endl;
+        return;
+    }
+    if (!texture) {
+        // released while it was being decoded
+        stbi_image_free(image.pixels);
+        return;
+    }
+
+    size_t size = byteSize(image);
+    const unsigned char* source = image.isCompressed ? image.compressed.data.data() : image.pixels;
+    if (pbos[0] == 0)
+        glGenBuffers(PBO_COUNT, pbos);
+    // orphaning the buffer lets the driver keep streaming the previous upload out of the old storage
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbos[nextPbo]);
+    nextPbo = (nextPbo + 1) % PBO_COUNT;
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, size, nullptr, GL_STREAM_DRAW);
+    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+    if (mapped) {
+        std::memcpy(mapped, source, size);
+        glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        if (image.isCompressed)
+            texture->GenerateCompressedFromBuffer(image.compressed, 0);
+        else
+            texture->GenerateFromBuffer(image.width, image.height, 0);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    else {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        if (image.isCompressed)
+            texture->GenerateCompressed(image.compressed);
+        else
+            texture->Generate(image.width, image.height, image.pixels);
+    }
+    stbi_image_free(image.pixels);
+}
+
+size_t TextureLoader::byteSize(const DecodedImage& image) {
+    if (image.isCompressed)
+        return image.compressed.data.size();
+    return image.pixels ? static_cast<size_t>(image.width) * image.height * image.channels : 0;
+}
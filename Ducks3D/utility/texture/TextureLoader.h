@@ -0,0 +1,80 @@
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "Texture2D.h"
+#include "CompressedImage.h"
+#include "../ResourceHandle.h"
+
+// Two stage texture loader. A pool of worker threads decodes image
+// files with stb_image, or reads DDS/KTX2 containers whose compressed
+// blocks are uploaded as they are. The GL thread then streams the data
+// into their textures through a small ring of pixel unpack buffers, up
+// to a byte budget per call so a burst of finished decodes can't stall
+// a frame. Requests are keyed by texture handle; results whose handle
+// went stale in the meantime are dropped at upload.
+class TextureLoader {
+public:
+    typedef ResourceHandle<Texture2D> Handle;
+
+    static const int PBO_COUNT = 3;
+
+    TextureLoader();
+    ~TextureLoader();
+
+    // queues file for decoding into channels (3 or 4) components, starts the workers on first use
+    void Request(Handle handle, const std::string& file, int channels);
+    // uploads decoded images into their textures until byteBudget is used up, always at least one
+    // if any is ready. Returns the number of images taken off the queue. GL thread only
+    size_t Upload(SlotArray<Texture2D>& textures, size_t byteBudget);
+    // uploads everything requested so far, waiting for the workers as needed. GL thread only
+    void Finish(SlotArray<Texture2D>& textures);
+    // true while handle has been requested and not uploaded (or failed) yet
+    bool IsPending(Handle handle) const;
+    size_t PendingCount() const { return pending.size(); }
+    // stops the workers, drops everything still queued and deletes the unpack buffers
+    void Release();
+private:
+    struct DecodeJob {
+        Handle handle;
+        std::string file;
+        int channels;
+    };
+    struct DecodedImage {
+        Handle handle;
+        std::string file;
+        int width, height, channels;
+        // null if decoding failed, freed with stbi_image_free
+        unsigned char* pixels;
+        // filled instead of pixels for containers
+        CompressedImage compressed;
+        bool isCompressed;
+    };
+
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    // signalled when a request is queued or the workers have to stop
+    std::condition_variable requestReady;
+    // signalled when a decoded image is queued
+    std::condition_variable decodedReady;
+    std::deque<DecodeJob> requests;
+    std::deque<DecodedImage> decoded;
+    bool stopping;
+    // requested handles that haven't reached the upload stage, only touched by the GL thread
+    std::vector<Handle> pending;
+    unsigned int pbos[PBO_COUNT];
+    int nextPbo;
+
+    void start();
+    void workerLoop();
+    void upload(SlotArray<Texture2D>& textures, DecodedImage& image);
+    static size_t byteSize(const DecodedImage& image);
+};
+
+#endif
@@ -0,0 +1,22 @@
+#include "FixedTimestep.h"
+
+#include <cmath>
+
+FixedTimestep::FixedTimestep(double step, int maxSteps)
+    : step(step), maxSteps(maxSteps), accumulator(0.0), steps(0) {
+}
+
+int FixedTimestep::Advance(double elapsed) {
+    if (elapsed > 0.0)
+        accumulator += elapsed;
+    int count = 0;
+    while (accumulator >= step && count < maxSteps) {
+        accumulator -= step;
+        count++;
+    }
+    // drop the whole steps that didn't fit, keep the phase
+    if (accumulator >= step)
+        accumulator = std::fmod(accumulator, step);
+    steps += count;
+    return count;
+}
@@ -0,0 +1,30 @@
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+// Simulation clock that advances in steps of a fixed length, whatever
+// the frame rate. Real time is accumulated every frame and consumed a
+// whole step at a time; what is left over is the fraction of a step the
+// rendered frame lies past the last simulated state, used to
+// interpolate between that state and the one before it.
+class FixedTimestep {
+public:
+    // step in seconds. A frame never runs more than maxSteps steps, the backlog
+    // beyond that is dropped so one long hitch doesn't make the next frames slower still
+    FixedTimestep(double step, int maxSteps);
+
+    // adds elapsed seconds of real time and returns the number of steps to simulate now
+    int Advance(double elapsed);
+    double Step() const { return step; }
+    // weight of the last simulated state against the one a step before it: rendering lags
+    // the simulation by up to a step, but never shows a state that wasn't simulated
+    float Alpha() const { return static_cast<float>(accumulator / step); }
+    // steps simulated since construction
+    unsigned long long Steps() const { return steps; }
+private:
+    double step;
+    int maxSteps;
+    double accumulator;
+    unsigned long long steps;
+};
+
+#endif
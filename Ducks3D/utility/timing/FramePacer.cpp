@@ -0,0 +1,121 @@
+#include "FramePacer.h"
+
+#include <cmath>
+#include <thread>
+#include <algorithm>
+
+#include <GLFW/glfw3.h>
+
+namespace {
+    // single sleep requested while far from the deadline
+    const std::chrono::milliseconds SLEEP_SLICE(1);
+    // weight of a new measurement in the moving estimates
+    const double ESTIMATE_WEIGHT = 0.1;
+}
+
+FramePacer::FramePacer()
+    : period(0.0), swapInterval(0), started(false), swapBlock(0.0), sleepGranularity(0.002),
+    lastWait(0.0), nextInterval(0) {
+    intervals.reserve(INTERVAL_WINDOW);
+}
+
+void FramePacer::SetTargetRate(double framesPerSecond) {
+    period = framesPerSecond > 0.0 ? 1.0 / framesPerSecond : 0.0;
+    started = false;
+}
+
+void FramePacer::SetVsync(bool enabled, int refreshRate) {
+    swapInterval = 0;
+    if (enabled) {
+        // 120 Hz at a 60 target swaps every second refresh, 144 Hz every second (72 Hz)
+        // and leaves the rest to the deadline
+        swapInterval = 1;
+        if (period > 0.0 && refreshRate > 0)
+            swapInterval = std::max(1, static_cast<int>(std::floor(refreshRate * period)));
+    }
+    glfwSwapInterval(swapInterval);
+}
+
+void FramePacer::Present(GLFWwindow* window) {
+    Clock::time_point waitStart = Clock::now();
+    if (!started) {
+        nextPresent = waitStart;
+        lastPresent = waitStart;
+        started = true;
+    }
+    if (period > 0.0) {
+        // the swap will block for about swapBlock by itself, only wait for the rest
+        waitUntil(nextPresent - std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(swapBlock)));
+    }
+    Clock::time_point swapStart = Clock::now();
+    lastWait = seconds(swapStart - waitStart);
+
+    glfwSwapBuffers(window);
+
+    Clock::time_point presented = Clock::now();
+    swapBlock += (seconds(presented - swapStart) - swapBlock) * ESTIMATE_WEIGHT;
+
+    double interval = seconds(presented - lastPresent);
+    if (static_cast<int>(intervals.size()) < INTERVAL_WINDOW)
+        intervals.push_back(interval);
+    else
+        intervals[nextInterval] = interval;
+    nextInterval = (nextInterval + 1) % INTERVAL_WINDOW;
+    lastPresent = presented;
+
+    if (period > 0.0) {
+        // deadlines stay on the ideal grid so the average rate doesn't drift with the
+        // waits' overshoot; a frame more than a period late starts a new grid
+        nextPresent += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(period));
+        if (nextPresent < presented)
+            nextPresent = presented + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(period));
+    }
+}
+
+double FramePacer::MeanInterval() const {
+    if (intervals.empty())
+        return 0.0;
+    double sum = 0.0;
+    for (double interval : intervals)
+        sum += interval;
+    return sum / intervals.size() * 1000.0;
+}
+
+double FramePacer::IntervalDeviation() const {
+    if (intervals.size() < 2)
+        return 0.0;
+    double mean = MeanInterval() / 1000.0;
+    double sum = 0.0;
+    for (double interval : intervals)
+        sum += (interval - mean) * (interval - mean);
+    return std::sqrt(sum / (intervals.size() - 1)) * 1000.0;
+}
+
+double FramePacer::MaxInterval() const {
+    double longest = 0.0;
+    for (double interval : intervals)
+        longest = std::max(longest, interval);
+    return longest * 1000.0;
+}
+
+void FramePacer::waitUntil(Clock::time_point deadline) {
+    while (true) {
+        Clock::time_point now = Clock::now();
+        double remaining = seconds(deadline - now);
+        if (remaining <= 0.0)
+            return;
+        if (remaining > sleepGranularity * 1.5) {
+            std::this_thread::sleep_for(SLEEP_SLICE);
+            double slept = seconds(Clock::now() - now);
+            // rises at once on a long sleep, decays slowly when the scheduler is precise
+            sleepGranularity = std::max(slept, sleepGranularity + (slept - sleepGranularity) * ESTIMATE_WEIGHT);
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+double FramePacer::seconds(Clock::duration duration) {
+    return std::chrono::duration<double>(duration).count();
+}
@@ -0,0 +1,57 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <chrono>
+#include <vector>
+
+struct GLFWwindow;
+
+// Presents frames at a target rate. Vsync does the pacing whenever the
+// display rate allows it; on top of that the pacer holds each present
+// back until its deadline, minus the time the swap itself is measured
+// to block, so it never waits for what vsync waits for anyway. The wait
+// sleeps while the deadline is further away than the scheduler's sleep
+// granularity (also measured) and spins for the rest, instead of
+// oversleeping by whole scheduler quanta. Intervals between presents are
+// kept over a window for jitter statistics.
+class FramePacer {
+public:
+    static const int INTERVAL_WINDOW = 120;
+
+    FramePacer();
+
+    // framesPerSecond <= 0 presents as fast as the swap allows
+    void SetTargetRate(double framesPerSecond);
+    // picks the swap interval for a display running at refreshRate Hz (glfwSwapInterval, needs
+    // a current context): the multiple of the refresh closest to the target rate, or 0 for no vsync
+    void SetVsync(bool enabled, int refreshRate);
+    // waits for the frame's deadline and swaps the window's buffers
+    void Present(GLFWwindow* window);
+
+    // statistics over the last INTERVAL_WINDOW presents, in milliseconds
+    double MeanInterval() const;
+    double IntervalDeviation() const;
+    double MaxInterval() const;
+    // how long the last swaps blocked and how much of the last frame was spent waiting, in milliseconds
+    double SwapBlock() const { return swapBlock * 1000.0; }
+    double LastWait() const { return lastWait * 1000.0; }
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    double period;
+    int swapInterval;
+    Clock::time_point nextPresent;
+    Clock::time_point lastPresent;
+    bool started;
+    // moving estimates in seconds
+    double swapBlock;
+    double sleepGranularity;
+    double lastWait;
+    std::vector<double> intervals;
+    int nextInterval;
+
+    void waitUntil(Clock::time_point deadline);
+    static double seconds(Clock::duration duration);
+};
+
+#endif
@@ -0,0 +1,292 @@
+#include "TransformStore.h"
+
+#include <cmath>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TRANSFORM_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC accepts intrinsics of any instruction set without a per-function target
+#define TRANSFORM_AVX2_TARGET
+#else
+#define TRANSFORM_AVX2_TARGET __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace {
+    // Cephes sinf/cosf: reduce by multiples of pi/4 (in three parts, so the
+    // reduction stays exact for the angles a simulation produces), then one
+    // of two minimax polynomials per octant
+    const float FOUR_OVER_PI = 1.27323954473516f;
+    const float DP1 = 0.78515625f;
+    const float DP2 = 2.4187564849853515625e-4f;
+    const float DP3 = 3.77489497744594108e-8f;
+    const float COS_C0 = 2.443315711809948e-5f;
+    const float COS_C1 = -1.388731625493765e-3f;
+    const float COS_C2 = 4.166664568298827e-2f;
+    const float SIN_C0 = -1.9515295891e-4f;
+    const float SIN_C1 = 8.3321608736e-3f;
+    const float SIN_C2 = -1.6666654611e-1f;
+
+    void sinCos(float x, float& s, float& c) {
+        float sinSign = x < 0.0f ? -1.0f : 1.0f;
+        float cosSign = 1.0f;
+        x = std::fabs(x);
+        int j = static_cast<int>(x * FOUR_OVER_PI);
+        j = (j + 1) & ~1;
+        float y = static_cast<float>(j);
+        if (j & 4)
+            sinSign = -sinSign;
+        if (((j - 2) & 4) == 0)
+            cosSign = -cosSign;
+        x = ((x - y * DP1) - y * DP2) - y * DP3;
+        float z = x * x;
+        float cosPoly = ((COS_C0 * z + COS_C1) * z + COS_C2) * z * z - 0.5f * z + 1.0f;
+        float sinPoly = ((SIN_C0 * z + SIN_C1) * z + SIN_C2) * z * x + x;
+        bool swap = (j & 2) != 0;
+        s = (swap ? cosPoly : sinPoly) * sinSign;
+        c = (swap ? sinPoly : cosPoly) * cosSign;
+    }
+
+    void composeScalar(const float* px, const float* py, const float* pz, const float* yaw, const float* scale,
+        size_t begin, size_t end, const glm::mat4& parent, unsigned char* out, size_t stride) {
+        for (size_t i = begin; i < end; i++) {
+            float s, c;
+            sinCos(yaw[i], s, c);
+            float kc = scale[i] * c;
+            float ks = scale[i] * s;
+            float* m = reinterpret_cast<float*>(out + i * stride);
+            for (int r = 0; r < 4; r++) {
+                m[r] = kc * parent[0][r] - ks * parent[2][r];
+                m[4 + r] = scale[i] * parent[1][r];
+                m[8 + r] = ks * parent[0][r] + kc * parent[2][r];
+                // grouped like the vector kernels, so every kernel gives the same bits
+                m[12 + r] = (px[i] * parent[0][r] + py[i] * parent[1][r]) + (pz[i] * parent[2][r] + parent[3][r]);
+            }
+        }
+    }
+
+#ifdef TRANSFORM_X86
+    void sinCos4(__m128 x, __m128& s, __m128& c) {
+        const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x80000000));
+        __m128 sinSign = _mm_and_ps(x, signMask);
+        x = _mm_andnot_ps(signMask, x);
+        __m128i j = _mm_cvttps_epi32(_mm_mul_ps(x, _mm_set1_ps(FOUR_OVER_PI)));
+        j = _mm_and_si128(_mm_add_epi32(j, _mm_set1_epi32(1)), _mm_set1_epi32(~1));
+        __m128 y = _mm_cvtepi32_ps(j);
+        sinSign = _mm_xor_ps(sinSign, _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(j, _mm_set1_epi32(4)), 29)));
+        __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_andnot_si128(_mm_sub_epi32(j, _mm_set1_epi32(2)), _mm_set1_epi32(4)), 29));
+        __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, _mm_set1_epi32(2)), _mm_set1_epi32(2)));
+        x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(DP1)));
+        x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(DP2)));
+        x = _mm_sub_ps(x, _mm_mul_ps(y, _mm_set1_ps(DP3)));
+        __m128 z = _mm_mul_ps(x, x);
+        __m128 cosPoly = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(COS_C0), z), _mm_set1_ps(COS_C1));
+        cosPoly = _mm_add_ps(_mm_mul_ps(cosPoly, z), _mm_set1_ps(COS_C2));
+        cosPoly = _mm_mul_ps(_mm_mul_ps(cosPoly, z), z);
+        cosPoly = _mm_add_ps(_mm_sub_ps(cosPoly, _mm_mul_ps(_mm_set1_ps(0.5f), z)), _mm_set1_ps(1.0f));
+        __m128 sinPoly = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(SIN_C0), z), _mm_set1_ps(SIN_C1));
+        sinPoly = _mm_add_ps(_mm_mul_ps(sinPoly, z), _mm_set1_ps(SIN_C2));
+        sinPoly = _mm_add_ps(_mm_mul_ps(_mm_mul_ps(sinPoly, z), x), x);
+        s = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, cosPoly), _mm_andnot_ps(swap, sinPoly)), sinSign);
+        c = _mm_xor_ps(_mm_or_ps(_mm_and_ps(swap, sinPoly), _mm_andnot_ps(swap, cosPoly)), cosSign);
+    }
+
+    // rows[0..3] hold rows 0-3 of one matrix column for four entities, written out per entity
+    void storeColumn4(__m128 rows[4], unsigned char* out, size_t stride, int column) {
+        _MM_TRANSPOSE4_PS(rows[0], rows[1], rows[2], rows[3]);
+        for (int e = 0; e < 4; e++)
+            _mm_storeu_ps(reinterpret_cast<float*>(out + e * stride) + column * 4, rows[e]);
+    }
+
+    void composeSse2(const float* px, const float* py, const float* pz, const float* yaw, const float* scale,
+        size_t begin, size_t end, const glm::mat4& parent, unsigned char* out, size_t stride) {
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            __m128 s, c;
+            sinCos4(_mm_loadu_ps(yaw + i), s, c);
+            __m128 k = _mm_loadu_ps(scale + i);
+            __m128 kc = _mm_mul_ps(k, c);
+            __m128 ks = _mm_mul_ps(k, s);
+            __m128 x = _mm_loadu_ps(px + i), y = _mm_loadu_ps(py + i), z = _mm_loadu_ps(pz + i);
+            unsigned char* base = out + i * stride;
+            __m128 rows[4];
+            for (int r = 0; r < 4; r++)
+                rows[r] = _mm_sub_ps(_mm_mul_ps(kc, _mm_set1_ps(parent[0][r])), _mm_mul_ps(ks, _mm_set1_ps(parent[2][r])));
+            storeColumn4(rows, base, stride, 0);
+            for (int r = 0; r < 4; r++)
+                rows[r] = _mm_mul_ps(k, _mm_set1_ps(parent[1][r]));
+            storeColumn4(rows, base, stride, 1);
+            for (int r = 0; r < 4; r++)
+                rows[r] = _mm_add_ps(_mm_mul_ps(ks, _mm_set1_ps(parent[0][r])), _mm_mul_ps(kc, _mm_set1_ps(parent[2][r])));
+            storeColumn4(rows, base, stride, 2);
+            for (int r = 0; r < 4; r++) {
+                rows[r] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(parent[0][r])), _mm_mul_ps(y, _mm_set1_ps(parent[1][r]))),
+                    _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(parent[2][r])), _mm_set1_ps(parent[3][r])));
+            }
+            storeColumn4(rows, base, stride, 3);
+        }
+        composeScalar(px, py, pz, yaw, scale, i, end, parent, out, stride);
+    }
+
+    TRANSFORM_AVX2_TARGET
+    void sinCos8(__m256 x, __m256& s, __m256& c) {
+        const __m256 signMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x80000000));
+        __m256 sinSign = _mm256_and_ps(x, signMask);
+        x = _mm256_andnot_ps(signMask, x);
+        __m256i j = _mm256_cvttps_epi32(_mm256_mul_ps(x, _mm256_set1_ps(FOUR_OVER_PI)));
+        j = _mm256_and_si256(_mm256_add_epi32(j, _mm256_set1_epi32(1)), _mm256_set1_epi32(~1));
+        __m256 y = _mm256_cvtepi32_ps(j);
+        sinSign = _mm256_xor_ps(sinSign, _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_and_si256(j, _mm256_set1_epi32(4)), 29)));
+        __m256 cosSign = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_andnot_si256(_mm256_sub_epi32(j, _mm256_set1_epi32(2)), _mm256_set1_epi32(4)), 29));
+        __m256 swap = _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, _mm256_set1_epi32(2)), _mm256_set1_epi32(2)));
+        x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(DP1)));
+        x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(DP2)));
+        x = _mm256_sub_ps(x, _mm256_mul_ps(y, _mm256_set1_ps(DP3)));
+        __m256 z = _mm256_mul_ps(x, x);
+        __m256 cosPoly = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(COS_C0), z), _mm256_set1_ps(COS_C1));
+        cosPoly = _mm256_add_ps(_mm256_mul_ps(cosPoly, z), _mm256_set1_ps(COS_C2));
+        cosPoly = _mm256_mul_ps(_mm256_mul_ps(cosPoly, z), z);
+        cosPoly = _mm256_add_ps(_mm256_sub_ps(cosPoly, _mm256_mul_ps(_mm256_set1_ps(0.5f), z)), _mm256_set1_ps(1.0f));
+        __m256 sinPoly = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(SIN_C0), z), _mm256_set1_ps(SIN_C1));
+        sinPoly = _mm256_add_ps(_mm256_mul_ps(sinPoly, z), _mm256_set1_ps(SIN_C2));
+        sinPoly = _mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(sinPoly, z), x), x);
+        s = _mm256_xor_ps(_mm256_blendv_ps(sinPoly, cosPoly, swap), sinSign);
+        c = _mm256_xor_ps(_mm256_blendv_ps(cosPoly, sinPoly, swap), cosSign);
+    }
+
+    // as storeColumn4 for eight entities, the transpose works within each 128-bit half
+    TRANSFORM_AVX2_TARGET
+    void storeColumn8(__m256 rows[4], unsigned char* out, size_t stride, int column) {
+        __m256 t0 = _mm256_unpacklo_ps(rows[0], rows[1]);
+        __m256 t1 = _mm256_unpacklo_ps(rows[2], rows[3]);
+        __m256 t2 = _mm256_unpackhi_ps(rows[0], rows[1]);
+        __m256 t3 = _mm256_unpackhi_ps(rows[2], rows[3]);
+        __m256 entity[4] = {
+            _mm256_shuffle_ps(t0, t1, 0x44),
+            _mm256_shuffle_ps(t0, t1, 0xEE),
+            _mm256_shuffle_ps(t2, t3, 0x44),
+            _mm256_shuffle_ps(t2, t3, 0xEE)
+        };
+        for (int e = 0; e < 4; e++) {
+            _mm_storeu_ps(reinterpret_cast<float*>(out + e * stride) + column * 4, _mm256_castps256_ps128(entity[e]));
+            _mm_storeu_ps(reinterpret_cast<float*>(out + (e + 4) * stride) + column * 4, _mm256_extractf128_ps(entity[e], 1));
+        }
+    }
+
+    TRANSFORM_AVX2_TARGET
+    void composeAvx2(const float* px, const float* py, const float* pz, const float* yaw, const float* scale,
+        size_t begin, size_t end, const glm::mat4& parent, unsigned char* out, size_t stride) {
+        size_t i = begin;
+        for (; i + 8 <= end; i += 8) {
+            __m256 s, c;
+            sinCos8(_mm256_loadu_ps(yaw + i), s, c);
+            __m256 k = _mm256_loadu_ps(scale + i);
+            __m256 kc = _mm256_mul_ps(k, c);
+            __m256 ks = _mm256_mul_ps(k, s);
+            __m256 x = _mm256_loadu_ps(px + i), y = _mm256_loadu_ps(py + i), z = _mm256_loadu_ps(pz + i);
+            unsigned char* base = out + i * stride;
+            __m256 rows[4];
+            for (int r = 0; r < 4; r++)
+                rows[r] = _mm256_sub_ps(_mm256_mul_ps(kc, _mm256_set1_ps(parent[0][r])), _mm256_mul_ps(ks, _mm256_set1_ps(parent[2][r])));
+            storeColumn8(rows, base, stride, 0);
+            for (int r = 0; r < 4; r++)
+                rows[r] = _mm256_mul_ps(k, _mm256_set1_ps(parent[1][r]));
+            storeColumn8(rows, base, stride, 1);
+            for (int r = 0; r < 4; r++)
+                rows[r] = _mm256_add_ps(_mm256_mul_ps(ks, _mm256_set1_ps(parent[0][r])), _mm256_mul_ps(kc, _mm256_set1_ps(parent[2][r])));
+            storeColumn8(rows, base, stride, 2);
+            for (int r = 0; r < 4; r++) {
+                rows[r] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, _mm256_set1_ps(parent[0][r])), _mm256_mul_ps(y, _mm256_set1_ps(parent[1][r]))),
+                    _mm256_add_ps(_mm256_mul_ps(z, _mm256_set1_ps(parent[2][r])), _mm256_set1_ps(parent[3][r])));
+            }
+            storeColumn8(rows, base, stride, 3);
+        }
+        // the tail goes through the four wide kernel, then the scalar one
+        composeSse2(px, py, pz, yaw, scale, i, end, parent, out, stride);
+    }
+
+    bool cpuHasAvx2() {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 1);
+        // AVX registers must be enabled by the OS (OSXSAVE and XCR0 bits 1-2)
+        bool osAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 6) == 6;
+        if (!osAvx)
+            return false;
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+#endif
+}
+
+size_t TransformStore::Add(const glm::vec3& position, float yaw, float scale) {
+    positionX.push_back(position.x);
+    positionY.push_back(position.y);
+    positionZ.push_back(position.z);
+    this->yaw.push_back(yaw);
+    this->scale.push_back(scale);
+    return this->yaw.size() - 1;
+}
+
+void TransformStore::Set(size_t index, const glm::vec3& position, float yaw, float scale) {
+    positionX[index] = position.x;
+    positionY[index] = position.y;
+    positionZ[index] = position.z;
+    this->yaw[index] = yaw;
+    this->scale[index] = scale;
+}
+
+void TransformStore::Clear() {
+    positionX.clear();
+    positionY.clear();
+    positionZ.clear();
+    yaw.clear();
+    scale.clear();
+}
+
+void TransformStore::Compose(size_t begin, size_t end, const glm::mat4& parent, glm::mat4* out, size_t stride) const {
+    static const Isa isa = BestIsa();
+    ComposeWith(isa, begin, end, parent, out, stride);
+}
+
+void TransformStore::ComposeWith(Isa isa, size_t begin, size_t end, const glm::mat4& parent, glm::mat4* out, size_t stride) const {
+    unsigned char* bytes = reinterpret_cast<unsigned char*>(out);
+    switch (isa) {
+#ifdef TRANSFORM_X86
+    case ISA_AVX2:
+        composeAvx2(positionX.data(), positionY.data(), positionZ.data(), yaw.data(), scale.data(), begin, end, parent, bytes, stride);
+        break;
+    case ISA_SSE2:
+        composeSse2(positionX.data(), positionY.data(), positionZ.data(), yaw.data(), scale.data(), begin, end, parent, bytes, stride);
+        break;
+#endif
+    default:
+        composeScalar(positionX.data(), positionY.data(), positionZ.data(), yaw.data(), scale.data(), begin, end, parent, bytes, stride);
+        break;
+    }
+}
+
+TransformStore::Isa TransformStore::BestIsa() {
+#ifdef TRANSFORM_X86
+    static const Isa best = cpuHasAvx2() ? ISA_AVX2 : ISA_SSE2;
+    return best;
+#else
+    return ISA_SCALAR;
+#endif
+}
+
+const char* TransformStore::IsaName(Isa isa) {
+    switch (isa) {
+    case ISA_AVX2:
+        return "avx2";
+    case ISA_SSE2:
+        return "sse2";
+    default:
+        return "scalar";
+    }
+}
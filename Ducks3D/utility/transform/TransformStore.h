@@ -0,0 +1,48 @@
+#ifndef TRANSFORM_STORE_H
+#define TRANSFORM_STORE_H
+
+#include <vector>
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+// Transforms of many entities as structure of arrays: position, rotation
+// about the y axis and uniform scale. Compose turns a range of them into
+// model matrices
+//
+//   parent * translate(position) * rotateY(yaw) * scale(scale)
+//
+// several entities at a time, written straight into an interleaved
+// destination such as an instance array. The widest kernel the CPU
+// supports is picked at runtime (AVX2, SSE2, scalar), all of them use
+// the same sine/cosine approximation so the result doesn't depend on it.
+class TransformStore {
+public:
+    enum Isa {
+        ISA_SCALAR,
+        ISA_SSE2,
+        ISA_AVX2
+    };
+
+    // returns the index of the new entity
+    size_t Add(const glm::vec3& position, float yaw, float scale);
+    void Set(size_t index, const glm::vec3& position, float yaw, float scale);
+    void Clear();
+    size_t Size() const { return yaw.size(); }
+
+    // writes the matrices of entities [begin, end) to out, the matrix of entity i lands at
+    // (char*)out + i * stride, so out addresses entity 0 even when begin isn't 0
+    void Compose(size_t begin, size_t end, const glm::mat4& parent, glm::mat4* out, size_t stride) const;
+    // as Compose with a given kernel, isa must be supported
+    void ComposeWith(Isa isa, size_t begin, size_t end, const glm::mat4& parent, glm::mat4* out, size_t stride) const;
+
+    // widest kernel the CPU and OS support, detected once
+    static Isa BestIsa();
+    static const char* IsaName(Isa isa);
+private:
+    std::vector<float> positionX, positionY, positionZ;
+    std::vector<float> yaw;
+    std::vector<float> scale;
+};
+
+#endif